@@ -19,6 +19,15 @@ typedef uint16_t _Py_CODEUNIT;
 
 typedef struct _PyOpcache _PyOpcache;
 
+#if PYSTON_SPEEDUPS
+// Element type of co_opcache_map, wide enough to give every site of large functions a cache.
+typedef unsigned short _PyOpcacheIdx;
+#define _PyOpcacheIdx_MAX USHRT_MAX
+#else
+typedef unsigned char _PyOpcacheIdx;
+#define _PyOpcacheIdx_MAX 255
+#endif
+
 /* Bytecode object */
 typedef struct {
     PyObject_HEAD
@@ -31,7 +40,9 @@ typedef struct {
     int co_firstlineno;         /* first source line number */
 #if PYSTON_SPEEDUPS
     // move this somewhere it packs better:
-    unsigned char co_opcache_size;  // length of co_opcache.
+    _PyOpcacheIdx co_opcache_size;  // length of co_opcache.
+    unsigned char co_jit_num_recompiles;  // how often the JIT code got thrown away because the ICs kept missing
+    unsigned char co_jit_queued;  // waiting in the JIT_ASYNC compile queue
 #endif
     PyObject *co_code;          /* instruction opcodes */
     PyObject *co_consts;        /* list (constants used) */
@@ -66,7 +77,7 @@ typedef struct {
     // co_opcache_map is indexed by (next_instr - first_instr).
     //  * 0 means there is no cache for this opcode.
     //  * n > 0 means there is cache in co_opcache[n-1].
-    unsigned char *co_opcache_map;
+    _PyOpcacheIdx *co_opcache_map;
     _PyOpcache *co_opcache;
 #if PYSTON_SPEEDUPS
     long co_opcache_flag;  // used to determine when create a cache.
@@ -82,6 +93,8 @@ typedef struct {
     PyObject* co_builtins_cache_obj; // borrowed reference
 
     void* co_jit_code; // if we jit compile this func this point to the entry of machine code
+    void* co_jit_code_retired; // list of replaced machine code which frames may still execute
+    int co_jit_num_active; // number of frames currently executing machine code of this func
 #endif
 } PyCodeObject;
 
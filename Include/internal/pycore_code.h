@@ -18,8 +18,14 @@ enum _PyOpcache_LoadGlobal_Types {
     // the globals hashtable.
     LG_GLOBAL_OFFSET = 2,
 
-    // TODO: we could add a dk_version-based cache as well, which would be faster than the offset cache,
-    // as well as allow caching results from the builtins dict
+    // Value came from the globals dictionary.
+    // We guard on the dk_version_tag of the globals keys object, which only changes if the set of keys
+    // changes, and load the value from the cached offset into the keys object.
+    LG_GLOBAL_KEYS_VERSION = 3,
+
+    // Same as LG_GLOBAL_KEYS_VERSION but comes from the builtins dictionary, so we additionally
+    // guard on the keys version of the globals dict to make sure the name did not get shadowed.
+    LG_BUILTIN_KEYS_VERSION = 4,
 };
 
 typedef struct {
@@ -37,6 +43,11 @@ typedef struct {
             Py_ssize_t dk_size;
             int64_t offset;
         } global_offset_cache;
+        struct {
+            uint64_t globals_keys_ver; /* dk_version_tag of the globals keys */
+            uint64_t builtins_keys_ver; /* dk_version_tag of the builtins keys, only used by LG_BUILTIN_KEYS_VERSION */
+            int64_t offset; /* offset in bytes from ma_keys to me_value of the entry */
+        } keys_version_cache;
     } u;
 
     char cache_type;
@@ -105,6 +116,10 @@ enum _PyOpcache_LoadAttr_Types {
 
     // Used for polymorphic sites where we store an array of _PyOpcaches
     LA_CACHE_POLYMORPHIC = 8,
+
+    // Used for sites which saw more types than fit into a polymorphic cache.
+    // The entries are stored in a process-wide table indexed by (tp_version_tag, name).
+    LA_CACHE_MEGAMORPHIC = 9,
 };
 typedef struct {
     union {
@@ -173,6 +188,7 @@ typedef struct {
     char meth_found; // used by LOAD_METHOD: can we do the method descriptor optimization or not
     char guard_tp_descr_get; // do we have to guard on Py_TYPE(u.value_cache.obj)->tp_descr_get == NULL
     uint8_t type_hash; // used as heuristic to decide if cache entry should be rewritten or switched to polymorphic
+    uint16_t poly_hits; // only used by the entries of a polymorphic cache: number of hits, used to sort the entries
 } _PyOpcache_LoadAttr;
 
 enum _PyOpcache_StoreAttr_Types {
@@ -221,6 +237,32 @@ typedef struct {
     unsigned char refcnt1_right;/* how many times had the right operand a refcnt of 1 */
 } _PyOpcache_TypeRefcnt;
 
+// The CALL_FUNCTION, CALL_FUNCTION_KW and CALL_METHOD caches are only implemented for these versions,
+// other versions don't allocate opcache entries for these opcodes.
+#define USE_CALL_CACHE (PY_MAJOR_VERSION == 3 && (PY_MINOR_VERSION == 8 || PY_MINOR_VERSION == 9))
+
+enum _PyOpcache_Call_Types {
+    // python function called with exactly co_argcount positional arguments, guarded by the code object
+    CALL_CACHE_PY_FUNC = 0,
+
+    // builtin function with METH_NOARGS, METH_O or METH_FASTCALL(|METH_KEYWORDS) calling convention,
+    // guarded by the PyMethodDef
+    CALL_CACHE_CFUNC = 1,
+
+    // type constructors are not cached: without inlining tp_new and tp_init
+    // the cache would only skip the type check of the generic tp_call
+};
+
+typedef struct {
+    union {
+        PyCodeObject *code;  /* borrowed, only compared against */
+        PyMethodDef *ml;
+    } u;
+    int ml_flags;  /* ml_flags of the PyMethodDef, only used by CALL_CACHE_CFUNC */
+    short nargs;  /* number of positional arguments (including a LOAD_METHOD self) */
+    char cache_type;
+} _PyOpcache_Call;
+
 #endif
 
 struct _PyOpcache {
@@ -232,6 +274,7 @@ struct _PyOpcache {
         _PyOpcache_StoreAttr sa;
         _PyOpcache_Type t;
         _PyOpcache_TypeRefcnt t_refcnt;
+        _PyOpcache_Call call;
 #endif
     } u;
     char optimized;
@@ -272,11 +315,19 @@ int _PyCode_InitOpcache(PyCodeObject *co);
 #define co_opcache_flag DONTUSE
 #define co_opcache_size DONTUSE
 
+// Our own version of the one in code.h which is not available in pyston-lite
+typedef unsigned short _PyOpcacheIdx;
+#define _PyOpcacheIdx_MAX USHRT_MAX
+
 typedef struct {
-    unsigned char *oc_opcache_map;
+    _PyOpcacheIdx *oc_opcache_map;
     _PyOpcache *oc_opcache;
     long oc_opcache_flag;
-    unsigned char oc_opcache_size;
+    _PyOpcacheIdx oc_opcache_size;
+    unsigned char oc_jit_num_recompiles;
+    unsigned char oc_jit_queued;
+    int oc_jit_num_active;
+    void* oc_jit_code_retired;
 } OpCache;
 
 OpCache* _PyCode_GetOpcache(PyCodeObject *co);
@@ -292,6 +343,10 @@ int _PyCode_InitOpcache_Pyston(PyCodeObject *co, OpCache *opcache);
 #define oc_opcache co_opcache
 #define oc_opcache_flag co_opcache_flag
 #define oc_opcache_size co_opcache_size
+#define oc_jit_num_recompiles co_jit_num_recompiles
+#define oc_jit_queued co_jit_queued
+#define oc_jit_num_active co_jit_num_active
+#define oc_jit_code_retired co_jit_code_retired
 #endif
 
 
@@ -99,6 +99,8 @@ struct gc_generation {
     int threshold; /* collection threshold */
     int count; /* count of allocations or collections of younger
                   generations */
+    int base_threshold; /* threshold set by gc.set_threshold(), which the
+                           adaptive policy starts from */
 };
 
 /* Running stats per generation */
@@ -109,6 +111,11 @@ struct gc_generation_stats {
     Py_ssize_t collected;
     /* total number of uncollectable objects (put into gc.garbage) */
     Py_ssize_t uncollectable;
+    /* total time spent in collections, in seconds */
+    double time;
+    /* number of times the adaptive policy raised or lowered the threshold */
+    Py_ssize_t threshold_increases;
+    Py_ssize_t threshold_decreases;
 };
 
 struct _gc_runtime_state {
@@ -133,16 +140,40 @@ struct _gc_runtime_state {
     /* a list of callbacks to be invoked when collection is performed */
     PyObject *callbacks;
     /* This is the number of objects that survived the last full
-       collection. It approximates the number of long lived objects
-       tracked by the GC.
+       collection (or incremental pass). It approximates the number of
+       long lived objects tracked by the GC.
 
        (by "full collection", we mean a collection of the oldest
        generation). */
     Py_ssize_t long_lived_total;
     /* This is the number of objects that survived all "non-full"
-       collections, and are awaiting to undergo a full collection for
-       the first time. */
+       collections, and are awaiting to undergo a full collection (or
+       an incremental pass) for the first time. */
     Py_ssize_t long_lived_pending;
+    /* The maximum number of objects of the oldest generation which
+       an incremental collection step examines, 0 if the oldest generation
+       is always collected as a whole. */
+    Py_ssize_t incremental_budget;
+    /* The number of objects of the oldest generation which the running
+       incremental pass still has to examine, 0 if no pass is running. */
+    Py_ssize_t incremental_remaining;
+    /* The number of objects which survived the steps of the running
+       incremental pass.  Becomes long_lived_total when the pass is done. */
+    Py_ssize_t incremental_survivors;
+    /* long_lived_total as of the last full collection. */
+    Py_ssize_t long_lived_full_total;
+    /* true if the thresholds of the young generations adapt to how much
+       garbage their collections find, see gc.set_adaptive() */
+    int adaptive;
+    /* the fraction of time the adaptive policy lets automatic collections
+       take before it raises thresholds regardless of the garbage found */
+    double adaptive_max_time;
+    /* moving average of the fraction of time taken by automatic
+       collections, and the time the last of them finished */
+    double adaptive_time_fraction;
+    _PyTime_t adaptive_last_end;
+    /* the number of threads full collections use, see gc.set_parallel() */
+    int parallel_threads;
 };
 
 PyAPI_FUNC(void) _PyGC_Initialize(struct _gc_runtime_state *);
@@ -455,8 +455,43 @@ static inline void _Py_ForgetReference(PyObject *op)
 
 PyAPI_FUNC(void) _Py_Dealloc(PyObject *);
 
+#ifdef PYSTON_SPEEDUPS
+#define Py_INCREF_IMMORTAL(obj) ((void)obj)
+#define Py_XINCREF_IMMORTAL(obj) ((void)obj)
+#define Py_DECREF_IMMORTAL(obj) ((void)obj)
+#define Py_XDECREF_IMMORTAL(obj) ((void)obj)
+// This number needs to be a positive signed number when shifted left by two bits,
+// as is done by the gc module
+#define IMMORTAL_REFCOUNT (1L<<60)
+#define MAKE_IMMORTAL(obj) (((PyObject*)obj)->ob_refcnt = IMMORTAL_REFCOUNT)
+#define IS_IMMORTAL(obj) (((PyObject*)obj)->ob_refcnt > IMMORTAL_REFCOUNT / 2)
+
+// Immortalize an object, and use tp_traverse to recursively immortalize
+// objects it references.
+PyAPI_FUNC(void) _Py_Immortalize(PyObject*);
+#else
+#define Py_INCREF_IMMORTAL(obj) Py_INCREF(obj)
+#define Py_XINCREF_IMMORTAL(obj) Py_XINCREF(obj)
+#define Py_DECREF_IMMORTAL(obj) Py_DECREF(obj)
+#define Py_XDECREF_IMMORTAL(obj) Py_XDECREF(obj)
+#define MAKE_IMMORTAL(obj) ((void)obj)
+#define IS_IMMORTAL(obj) (0)
+
+#define _Py_Immortalize(obj) ((void)obj)
+#endif
+
+/* With Py_SKIP_IMMORTAL_REFCNT, reference counting never writes to immortal
+   objects, so that pages holding them (e.g. after gc.seal()) stay shared with
+   a forked parent.  It costs a branch on every incref and decref. */
+#if defined(PYSTON_SPEEDUPS) && defined(Py_SKIP_IMMORTAL_REFCNT)
+#define _Py_RETURN_IF_IMMORTAL(op) do { if (IS_IMMORTAL(op)) return; } while (0)
+#else
+#define _Py_RETURN_IF_IMMORTAL(op) ((void)0)
+#endif
+
 static inline void _Py_INCREF(PyObject *op)
 {
+    _Py_RETURN_IF_IMMORTAL(op);
     _Py_INC_REFTOTAL;
     op->ob_refcnt++;
 }
@@ -468,6 +503,7 @@ static inline void _Py_DECREF(const char *filename, int lineno,
 {
     (void)filename; /* may be unused, shut up -Wunused-parameter */
     (void)lineno; /* may be unused, shut up -Wunused-parameter */
+    _Py_RETURN_IF_IMMORTAL(op);
     _Py_DEC_REFTOTAL;
     if (--op->ob_refcnt != 0) {
 #ifdef Py_REF_DEBUG
@@ -562,31 +598,6 @@ Don't forget to apply Py_INCREF() when returning this value!!!
 PyAPI_DATA(PyObject) _Py_NoneStruct; /* Don't use this directly */
 #define Py_None (&_Py_NoneStruct)
 
-#ifdef PYSTON_SPEEDUPS
-#define Py_INCREF_IMMORTAL(obj) ((void)obj)
-#define Py_XINCREF_IMMORTAL(obj) ((void)obj)
-#define Py_DECREF_IMMORTAL(obj) ((void)obj)
-#define Py_XDECREF_IMMORTAL(obj) ((void)obj)
-// This number needs to be a positive signed number when shifted left by two bits,
-// as is done by the gc module
-#define IMMORTAL_REFCOUNT (1L<<60)
-#define MAKE_IMMORTAL(obj) (((PyObject*)obj)->ob_refcnt = IMMORTAL_REFCOUNT)
-#define IS_IMMORTAL(obj) (((PyObject*)obj)->ob_refcnt > IMMORTAL_REFCOUNT / 2)
-
-// Immortalize an object, and use tp_traverse to recursively immortalize
-// objects it references.
-PyAPI_FUNC(void) _Py_Immortalize(PyObject*);
-#else
-#define Py_INCREF_IMMORTAL(obj) Py_INCREF(obj)
-#define Py_XINCREF_IMMORTAL(obj) Py_XINCREF(obj)
-#define Py_DECREF_IMMORTAL(obj) Py_DECREF(obj)
-#define Py_XDECREF_IMMORTAL(obj) Py_XDECREF(obj)
-#define MAKE_IMMORTAL(obj) ((void)obj)
-#define IS_IMMORTAL(obj) (0)
-
-#define _Py_Immortalize(obj) ((void)obj)
-#endif
-
 /* Macro for returning Py_None from a function */
 #define Py_RETURN_NONE return Py_INCREF_IMMORTAL(Py_None), Py_None
 
@@ -212,6 +212,214 @@ gc_get_threshold(PyObject *module, PyObject *Py_UNUSED(ignored))
     return gc_get_threshold_impl(module);
 }
 
+PyDoc_STRVAR(gc_set_parallel__doc__,
+"set_parallel($module, nthreads, /)\n"
+"--\n"
+"\n"
+"Use up to nthreads threads for full collections of large heaps.\n"
+"\n"
+"The threads find the reachable objects together, while the calling thread\n"
+"holds the GIL.  0 or 1 makes collections single-threaded.");
+
+#define GC_SET_PARALLEL_METHODDEF    \
+    {"set_parallel", (PyCFunction)gc_set_parallel, METH_O, gc_set_parallel__doc__},
+
+static PyObject *
+gc_set_parallel_impl(PyObject *module, int nthreads);
+
+static PyObject *
+gc_set_parallel(PyObject *module, PyObject *arg)
+{
+    PyObject *return_value = NULL;
+    int nthreads;
+
+    if (!PyLong_CheckExact(arg) && PyFloat_Check(arg)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "integer argument expected, got float" );
+        goto exit;
+    }
+    nthreads = _PyLong_AsInt(arg);
+    if (nthreads == -1 && PyErr_Occurred()) {
+        goto exit;
+    }
+    return_value = gc_set_parallel_impl(module, nthreads);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(gc_get_parallel__doc__,
+"get_parallel($module, /)\n"
+"--\n"
+"\n"
+"Return the number of threads set with set_parallel().");
+
+#define GC_GET_PARALLEL_METHODDEF    \
+    {"get_parallel", (PyCFunction)gc_get_parallel, METH_NOARGS, gc_get_parallel__doc__},
+
+static int
+gc_get_parallel_impl(PyObject *module);
+
+static PyObject *
+gc_get_parallel(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *return_value = NULL;
+    int _return_value;
+
+    _return_value = gc_get_parallel_impl(module);
+    if ((_return_value == -1) && PyErr_Occurred()) {
+        goto exit;
+    }
+    return_value = PyLong_FromLong((long)_return_value);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(gc_set_adaptive__doc__,
+"set_adaptive($module, enable, max_time=0.05, /)\n"
+"--\n"
+"\n"
+"Adapt the thresholds of the young generations to the garbage they find.\n"
+"\n"
+"Collections which find little garbage raise the threshold of their\n"
+"generation, and ones which find much garbage lower it again, but never below\n"
+"the threshold set by set_threshold().  While automatic collections take more\n"
+"than max_time (a fraction) of the time, thresholds only get raised.");
+
+#define GC_SET_ADAPTIVE_METHODDEF    \
+    {"set_adaptive", (PyCFunction)(void(*)(void))gc_set_adaptive, METH_FASTCALL, gc_set_adaptive__doc__},
+
+static PyObject *
+gc_set_adaptive_impl(PyObject *module, int enable, double max_time);
+
+static PyObject *
+gc_set_adaptive(PyObject *module, PyObject *const *args, Py_ssize_t nargs)
+{
+    PyObject *return_value = NULL;
+    int enable;
+    double max_time = 0.05;
+
+    if (!_PyArg_CheckPositional("set_adaptive", nargs, 1, 2)) {
+        goto exit;
+    }
+    enable = PyObject_IsTrue(args[0]);
+    if (enable < 0) {
+        goto exit;
+    }
+    if (nargs < 2) {
+        goto skip_optional;
+    }
+    if (PyFloat_CheckExact(args[1])) {
+        max_time = PyFloat_AS_DOUBLE(args[1]);
+    }
+    else
+    {
+        max_time = PyFloat_AsDouble(args[1]);
+        if (max_time == -1.0 && PyErr_Occurred()) {
+            goto exit;
+        }
+    }
+skip_optional:
+    return_value = gc_set_adaptive_impl(module, enable, max_time);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(gc_get_adaptive__doc__,
+"get_adaptive($module, /)\n"
+"--\n"
+"\n"
+"Return whether thresholds are adaptive, and the max_time of set_adaptive().");
+
+#define GC_GET_ADAPTIVE_METHODDEF    \
+    {"get_adaptive", (PyCFunction)gc_get_adaptive, METH_NOARGS, gc_get_adaptive__doc__},
+
+static PyObject *
+gc_get_adaptive_impl(PyObject *module);
+
+static PyObject *
+gc_get_adaptive(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    return gc_get_adaptive_impl(module);
+}
+
+PyDoc_STRVAR(gc_set_incremental__doc__,
+"set_incremental($module, budget, /)\n"
+"--\n"
+"\n"
+"Collect the oldest generation incrementally.\n"
+"\n"
+"Instead of examining the whole oldest generation at once, every collection\n"
+"of generation 1 also examines the next budget objects of it.  The oldest\n"
+"generation only gets collected as a whole once it doubled in size since the\n"
+"last full collection, or by collect().  A budget of 0 disables incremental\n"
+"collection.");
+
+#define GC_SET_INCREMENTAL_METHODDEF    \
+    {"set_incremental", (PyCFunction)gc_set_incremental, METH_O, gc_set_incremental__doc__},
+
+static PyObject *
+gc_set_incremental_impl(PyObject *module, Py_ssize_t budget);
+
+static PyObject *
+gc_set_incremental(PyObject *module, PyObject *arg)
+{
+    PyObject *return_value = NULL;
+    Py_ssize_t budget;
+
+    if (!PyLong_CheckExact(arg) && PyFloat_Check(arg)) {
+        PyErr_SetString(PyExc_TypeError,
+                        "integer argument expected, got float" );
+        goto exit;
+    }
+    {
+        Py_ssize_t ival = -1;
+        PyObject *iobj = PyNumber_Index(arg);
+        if (iobj != NULL) {
+            ival = PyLong_AsSsize_t(iobj);
+            Py_DECREF(iobj);
+        }
+        if (ival == -1 && PyErr_Occurred()) {
+            goto exit;
+        }
+        budget = ival;
+    }
+    return_value = gc_set_incremental_impl(module, budget);
+
+exit:
+    return return_value;
+}
+
+PyDoc_STRVAR(gc_get_incremental__doc__,
+"get_incremental($module, /)\n"
+"--\n"
+"\n"
+"Return the budget of incremental collection steps, 0 if disabled.");
+
+#define GC_GET_INCREMENTAL_METHODDEF    \
+    {"get_incremental", (PyCFunction)gc_get_incremental, METH_NOARGS, gc_get_incremental__doc__},
+
+static Py_ssize_t
+gc_get_incremental_impl(PyObject *module);
+
+static PyObject *
+gc_get_incremental(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *return_value = NULL;
+    Py_ssize_t _return_value;
+
+    _return_value = gc_get_incremental_impl(module);
+    if ((_return_value == -1) && PyErr_Occurred()) {
+        goto exit;
+    }
+    return_value = PyLong_FromSsize_t(_return_value);
+
+exit:
+    return return_value;
+}
+
 PyDoc_STRVAR(gc_get_count__doc__,
 "get_count($module, /)\n"
 "--\n"
@@ -373,4 +581,38 @@ gc_get_freeze_count(PyObject *module, PyObject *Py_UNUSED(ignored))
 exit:
     return return_value;
 }
-/*[clinic end generated code: output=17efd9d19429395d input=a9049054013a1b77]*/
+
+PyDoc_STRVAR(gc_seal__doc__,
+"seal($module, /)\n"
+"--\n"
+"\n"
+"Make all tracked objects immortal and stop tracking them.\n"
+"\n"
+"Everything the objects reference is made immortal as well.  Unlike freeze(),\n"
+"this cannot be undone: sealed objects are never freed and the collector never\n"
+"looks at them again.  This is meant to be called before a POSIX fork() call,\n"
+"so that the children keep sharing the memory of the parent\'s objects.\n"
+"Returns the number of objects which were untracked.");
+
+#define GC_SEAL_METHODDEF    \
+    {"seal", (PyCFunction)gc_seal, METH_NOARGS, gc_seal__doc__},
+
+static Py_ssize_t
+gc_seal_impl(PyObject *module);
+
+static PyObject *
+gc_seal(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *return_value = NULL;
+    Py_ssize_t _return_value;
+
+    _return_value = gc_seal_impl(module);
+    if ((_return_value == -1) && PyErr_Occurred()) {
+        goto exit;
+    }
+    return_value = PyLong_FromSsize_t(_return_value);
+
+exit:
+    return return_value;
+}
+/*[clinic end generated code: output=113b25650ae06284 input=a9049054013a1b77]*/
@@ -32,6 +32,15 @@
 #include "pydtrace.h"
 #include "pytime.h"             /* for _PyTime_GetMonotonicClock() */
 
+#if defined(HAVE_PTHREAD_H) && defined(HAVE_BUILTIN_ATOMIC)
+#  define GC_PARALLEL 1
+#  include <pthread.h>
+#  include <signal.h>
+#  include <unistd.h>
+#else
+#  define GC_PARALLEL 0
+#endif
+
 /*[clinic input]
 module gc
 [clinic start generated code]*/
@@ -132,10 +141,10 @@ _PyGC_Initialize(struct _gc_runtime_state *state)
 
 #define _GEN_HEAD(n) GEN_HEAD(state, n)
     struct gc_generation generations[NUM_GENERATIONS] = {
-        /* PyGC_Head,                                    threshold,    count */
-        {{(uintptr_t)_GEN_HEAD(0), (uintptr_t)_GEN_HEAD(0)},   700,        0},
-        {{(uintptr_t)_GEN_HEAD(1), (uintptr_t)_GEN_HEAD(1)},   10,         0},
-        {{(uintptr_t)_GEN_HEAD(2), (uintptr_t)_GEN_HEAD(2)},   10,         0},
+        /* PyGC_Head,                                    threshold,    count,   base */
+        {{(uintptr_t)_GEN_HEAD(0), (uintptr_t)_GEN_HEAD(0)},   700,        0,       700},
+        {{(uintptr_t)_GEN_HEAD(1), (uintptr_t)_GEN_HEAD(1)},   10,         0,       10},
+        {{(uintptr_t)_GEN_HEAD(2), (uintptr_t)_GEN_HEAD(2)},   10,         0,       10},
     };
     for (int i = 0; i < NUM_GENERATIONS; i++) {
         state->generations[i] = generations[i];
@@ -146,6 +155,7 @@ _PyGC_Initialize(struct _gc_runtime_state *state)
            (uintptr_t)&state->permanent_generation.head}, 0, 0
     };
     state->permanent_generation = permanent_generation;
+    state->adaptive_max_time = 0.05;
 }
 
 /*
@@ -585,6 +595,316 @@ move_unreachable(PyGC_Head *young, PyGC_Head *unreachable)
     young->_gc_prev = (uintptr_t)prev;
 }
 
+#if GC_PARALLEL
+/* With gc.set_parallel(), full collections of large heaps compute gc_refs
+ * and find the reachable objects with a pool of helper threads:
+ *
+ * 1. The objects get split into one chunk per thread, and every thread sets
+ *    gc_refs of its chunk like update_refs() does.
+ * 2. Every thread subtracts the references its chunk holds like
+ *    subtract_refs() does, with atomic decrements.
+ * 3. Every thread traverses the objects of its chunk which have gc_refs > 0,
+ *    and everything reachable from them.  An object gets marked reachable
+ *    by atomically setting its gc_refs from 0 to 1, and the thread which
+ *    does that traverses it.
+ *
+ * The collecting thread then splits young into reachable and unreachable
+ * objects without traversing anything.  The helpers only run while the
+ * collecting thread waits for them with the GIL held, so no Python code
+ * runs concurrently; tp_traverse implementations only have to tolerate
+ * running on another thread.
+ */
+
+/* Chunks smaller than this are not worth a thread. */
+#define PARALLEL_MIN_CHUNK (16 * 1024)
+
+enum { PHASE_UPDATE_REFS, PHASE_SUBTRACT_REFS, PHASE_MARK };
+
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    pid_t pid;              /* the process which started the helpers */
+    int nhelpers;           /* number of started helper threads */
+    unsigned long epoch;    /* incremented for every phase */
+    unsigned long helpers_epoch; /* the epoch when helpers were last started */
+    int phase;
+    int nactive;            /* number of threads taking part, the collecting
+                               thread included */
+    int pending;            /* helpers which didn't finish the phase yet */
+    PyGC_Head **objs;
+    Py_ssize_t nobjs;
+    int overflow;           /* true if a mark stack couldn't grow */
+} gc_pool;
+
+typedef struct {
+    PyGC_Head **items;
+    Py_ssize_t size;
+    Py_ssize_t allocated;
+} mark_stack;
+
+static int
+visit_decref_atomic(PyObject *op, void *parent)
+{
+    if (PyObject_IS_GC(op)) {
+        PyGC_Head *gc = AS_GC(op);
+        uintptr_t prev = __atomic_load_n(&gc->_gc_prev, __ATOMIC_RELAXED);
+        if (prev & PREV_MASK_COLLECTING) {
+            __atomic_fetch_sub(&gc->_gc_prev, (uintptr_t)1 << _PyGC_PREV_SHIFT,
+                               __ATOMIC_RELAXED);
+        }
+    }
+    return 0;
+}
+
+static int
+visit_mark(PyObject *op, mark_stack *stack)
+{
+    if (!PyObject_IS_GC(op)) {
+        return 0;
+    }
+    PyGC_Head *gc = AS_GC(op);
+    uintptr_t prev = __atomic_load_n(&gc->_gc_prev, __ATOMIC_RELAXED);
+    if (!(prev & PREV_MASK_COLLECTING) || (prev >> _PyGC_PREV_SHIFT) != 0) {
+        /* not in young, or already marked or known to be reachable */
+        return 0;
+    }
+    if (!__atomic_compare_exchange_n(&gc->_gc_prev, &prev,
+                                     prev + ((uintptr_t)1 << _PyGC_PREV_SHIFT),
+                                     0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return 0;  /* another thread marked it */
+    }
+    if (stack->size == stack->allocated) {
+        Py_ssize_t allocated = stack->allocated ? stack->allocated * 2 : 1024;
+        PyGC_Head **items = PyMem_RawRealloc(stack->items,
+                                             allocated * sizeof(PyGC_Head *));
+        if (items == NULL) {
+            /* gc stays marked without getting traversed; the caller
+               falls back to move_unreachable() which gets it right */
+            __atomic_store_n(&gc_pool.overflow, 1, __ATOMIC_RELAXED);
+            return 0;
+        }
+        stack->items = items;
+        stack->allocated = allocated;
+    }
+    stack->items[stack->size++] = gc;
+    return 0;
+}
+
+static void
+traverse_parallel(PyObject *op, visitproc visit, void *arg)
+{
+#if PYSTON_SPEEDUPS
+    inlined_tp_traverse(op, visit, arg);
+#else
+    (void) Py_TYPE(op)->tp_traverse(op, visit, arg);
+#endif
+}
+
+static void
+run_phase(int phase, int thread)
+{
+    Py_ssize_t start = gc_pool.nobjs * thread / gc_pool.nactive;
+    Py_ssize_t end = gc_pool.nobjs * (thread + 1) / gc_pool.nactive;
+    PyGC_Head **objs = gc_pool.objs;
+
+    if (phase == PHASE_UPDATE_REFS) {
+        for (Py_ssize_t i = start; i < end; i++) {
+            gc_reset_refs(objs[i], Py_REFCNT(FROM_GC(objs[i])));
+            _PyObject_ASSERT(FROM_GC(objs[i]), gc_get_refs(objs[i]) != 0);
+        }
+    }
+    else if (phase == PHASE_SUBTRACT_REFS) {
+        for (Py_ssize_t i = start; i < end; i++) {
+            PyObject *op = FROM_GC(objs[i]);
+            traverse_parallel(op, (visitproc)visit_decref_atomic, op);
+        }
+    }
+    else {
+        mark_stack stack = {NULL, 0, 0};
+        for (Py_ssize_t i = start; i < end; i++) {
+            uintptr_t prev = __atomic_load_n(&objs[i]->_gc_prev,
+                                             __ATOMIC_RELAXED);
+            if ((prev >> _PyGC_PREV_SHIFT) == 0) {
+                continue;
+            }
+            traverse_parallel(FROM_GC(objs[i]), (visitproc)visit_mark, &stack);
+            while (stack.size > 0) {
+                PyGC_Head *gc = stack.items[--stack.size];
+                traverse_parallel(FROM_GC(gc), (visitproc)visit_mark, &stack);
+            }
+        }
+        PyMem_RawFree(stack.items);
+    }
+}
+
+static void *
+helper_main(void *arg)
+{
+    int thread = (int)(uintptr_t)arg;
+
+    pthread_mutex_lock(&gc_pool.mutex);
+    /* The collecting thread may have started the first phase already. */
+    unsigned long seen = gc_pool.helpers_epoch;
+    for (;;) {
+        while (gc_pool.epoch == seen) {
+            pthread_cond_wait(&gc_pool.start, &gc_pool.mutex);
+        }
+        seen = gc_pool.epoch;
+        int phase = gc_pool.phase;
+        int active = thread < gc_pool.nactive;
+        pthread_mutex_unlock(&gc_pool.mutex);
+
+        if (active) {
+            run_phase(phase, thread);
+        }
+
+        pthread_mutex_lock(&gc_pool.mutex);
+        if (--gc_pool.pending == 0) {
+            pthread_cond_signal(&gc_pool.done);
+        }
+    }
+    return NULL;
+}
+
+/* Start helpers until there are nthreads threads including the collecting
+   one.  Returns the number of threads there are. */
+static int
+start_helpers(int nthreads)
+{
+    if (gc_pool.pid != getpid()) {
+        /* first use, or the helpers didn't survive a fork() */
+        pthread_mutex_init(&gc_pool.mutex, NULL);
+        pthread_cond_init(&gc_pool.start, NULL);
+        pthread_cond_init(&gc_pool.done, NULL);
+        gc_pool.pid = getpid();
+        gc_pool.nhelpers = 0;
+    }
+    gc_pool.helpers_epoch = gc_pool.epoch;
+    while (gc_pool.nhelpers + 1 < nthreads) {
+        /* Signals must be handled by the Python threads. */
+        sigset_t all, old;
+        pthread_t thread;
+        pthread_attr_t attr;
+        int err;
+
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, &old);
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_mutex_lock(&gc_pool.mutex);
+        err = pthread_create(&thread, &attr, helper_main,
+                             (void *)(uintptr_t)(gc_pool.nhelpers + 1));
+        if (err == 0) {
+            gc_pool.nhelpers++;
+        }
+        pthread_mutex_unlock(&gc_pool.mutex);
+        pthread_attr_destroy(&attr);
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        if (err != 0) {
+            break;
+        }
+    }
+    return gc_pool.nhelpers + 1;
+}
+
+static void
+run_parallel(int phase)
+{
+    pthread_mutex_lock(&gc_pool.mutex);
+    gc_pool.phase = phase;
+    gc_pool.pending = gc_pool.nhelpers;
+    gc_pool.epoch++;
+    pthread_cond_broadcast(&gc_pool.start);
+    pthread_mutex_unlock(&gc_pool.mutex);
+
+    run_phase(phase, 0);
+
+    pthread_mutex_lock(&gc_pool.mutex);
+    while (gc_pool.pending > 0) {
+        pthread_cond_wait(&gc_pool.done, &gc_pool.mutex);
+    }
+    pthread_mutex_unlock(&gc_pool.mutex);
+}
+
+/* Does what update_refs(), subtract_refs() and move_unreachable() do, with
+   the helper threads.  Returns -1 without having changed anything if it
+   can't. */
+static int
+move_unreachable_parallel(struct _gc_runtime_state *state,
+                          PyGC_Head *young, PyGC_Head *unreachable)
+{
+    if (state->parallel_threads < 2) {
+        return -1;
+    }
+    Py_ssize_t n = gc_list_size(young);
+    int nthreads = (int)Py_MIN(state->parallel_threads, n / PARALLEL_MIN_CHUNK);
+    if (nthreads < 2) {
+        return -1;
+    }
+    PyGC_Head **objs = PyMem_RawMalloc(n * sizeof(PyGC_Head *));
+    if (objs == NULL) {
+        return -1;
+    }
+    nthreads = Py_MIN(nthreads, start_helpers(nthreads));
+    if (nthreads < 2) {
+        PyMem_RawFree(objs);
+        return -1;
+    }
+
+    Py_ssize_t i = 0;
+    for (PyGC_Head *gc = GC_NEXT(young); gc != young; gc = GC_NEXT(gc)) {
+        objs[i++] = gc;
+    }
+    gc_pool.objs = objs;
+    gc_pool.nobjs = n;
+    gc_pool.nactive = nthreads;
+    gc_pool.overflow = 0;
+
+    run_parallel(PHASE_UPDATE_REFS);
+    run_parallel(PHASE_SUBTRACT_REFS);
+    run_parallel(PHASE_MARK);
+
+    if (gc_pool.overflow) {
+        /* everything marked is reachable, just not everything reachable
+           got marked */
+        move_unreachable(young, unreachable);
+    }
+    else {
+        /* Same result as move_unreachable(), see there. */
+        PyGC_Head *prev = young;
+        for (i = 0; i < n; i++) {
+            PyGC_Head *gc = objs[i];
+            if (gc_get_refs(gc)) {
+                prev->_gc_next = (uintptr_t)gc;
+                _PyGCHead_SET_PREV(gc, prev);
+                gc_clear_collecting(gc);
+                prev = gc;
+            }
+            else {
+                PyGC_Head *last = GC_PREV(unreachable);
+                last->_gc_next = (NEXT_MASK_UNREACHABLE | (uintptr_t)gc);
+                _PyGCHead_SET_PREV(gc, last);
+                gc->_gc_next = (NEXT_MASK_UNREACHABLE | (uintptr_t)unreachable);
+                unreachable->_gc_prev = (uintptr_t)gc;
+            }
+        }
+        prev->_gc_next = (uintptr_t)young;
+        young->_gc_prev = (uintptr_t)prev;
+    }
+    gc_pool.objs = NULL;
+    PyMem_RawFree(objs);
+    return 0;
+}
+#else
+static int
+move_unreachable_parallel(struct _gc_runtime_state *state,
+                          PyGC_Head *young, PyGC_Head *unreachable)
+{
+    return -1;
+}
+#endif
+
 static void
 untrack_tuples(PyGC_Head *head)
 {
@@ -1053,12 +1373,12 @@ collect(struct _gc_runtime_state *state, int generation,
     PyGC_Head unreachable; /* non-problematic unreachable trash */
     PyGC_Head finalizers;  /* objects with, & reachable from, __del__ */
     PyGC_Head *gc;
-    _PyTime_t t1 = 0;   /* initialize to prevent a compiler warning */
+    _PyTime_t t1 = _PyTime_GetMonotonicClock();
+    double d;
 
     if (state->debug & DEBUG_STATS) {
         PySys_WriteStderr("gc: collecting generation %d...\n", generation);
         show_stats_each_generations(state);
-        t1 = _PyTime_GetMonotonicClock();
     }
 
     if (PyDTrace_GC_START_ENABLED())
@@ -1089,17 +1409,20 @@ collect(struct _gc_runtime_state *state, int generation,
      * refcount greater than 0 when all the references within the
      * set are taken into account).
      */
-    update_refs(young);  // gc_prev is used for gc_refs
-    subtract_refs(young);
-
-    /* Leave everything reachable from outside young in young, and move
-     * everything else (in young) to unreachable.
-     * NOTE:  This used to move the reachable objects into a reachable
-     * set instead.  But most things usually turn out to be reachable,
-     * so it's more efficient to move the unreachable things.
-     */
     gc_list_init(&unreachable);
-    move_unreachable(young, &unreachable);  // gc_prev is pointer again
+    if (generation < NUM_GENERATIONS-1
+        || move_unreachable_parallel(state, young, &unreachable) < 0) {
+        update_refs(young);  // gc_prev is used for gc_refs
+        subtract_refs(young);
+
+        /* Leave everything reachable from outside young in young, and move
+         * everything else (in young) to unreachable.
+         * NOTE:  This used to move the reachable objects into a reachable
+         * set instead.  But most things usually turn out to be reachable,
+         * so it's more efficient to move the unreachable things.
+         */
+        move_unreachable(young, &unreachable);  // gc_prev is pointer again
+    }
     validate_list(young, 0);
 
     untrack_tuples(young);
@@ -1116,6 +1439,10 @@ collect(struct _gc_runtime_state *state, int generation,
         untrack_dicts(young);
         state->long_lived_pending = 0;
         state->long_lived_total = gc_list_size(young);
+        state->long_lived_full_total = state->long_lived_total;
+        /* everything got examined, a running incremental pass is done */
+        state->incremental_remaining = 0;
+        state->incremental_survivors = 0;
     }
 
     /* All objects in unreachable are trash, but objects reachable from
@@ -1169,8 +1496,8 @@ collect(struct _gc_runtime_state *state, int generation,
         if (state->debug & DEBUG_UNCOLLECTABLE)
             debug_cycle("uncollectable", FROM_GC(gc));
     }
+    d = _PyTime_AsSecondsDouble(_PyTime_GetMonotonicClock() - t1);
     if (state->debug & DEBUG_STATS) {
-        double d = _PyTime_AsSecondsDouble(_PyTime_GetMonotonicClock() - t1);
         PySys_WriteStderr(
             "gc: done, %" PY_FORMAT_SIZE_T "d unreachable, "
             "%" PY_FORMAT_SIZE_T "d uncollectable, %.4fs elapsed\n",
@@ -1214,6 +1541,7 @@ collect(struct _gc_runtime_state *state, int generation,
     stats->collections++;
     stats->collected += m;
     stats->uncollectable += n;
+    stats->time += d;
 
     if (PyDTrace_GC_DONE_ENABLED()) {
         PyDTrace_GC_DONE(n+m);
@@ -1282,6 +1610,120 @@ collect_with_callback(struct _gc_runtime_state *state, int generation)
     return result;
 }
 
+/* Perform one step of an incremental collection of the oldest generation:
+ * generation 1 gets collected as usual, then the next incremental_budget
+ * objects of the oldest generation.
+ *
+ * Collecting any subset of the objects is safe, the references from objects
+ * outside of it just count as external ones.  So no write barrier is needed,
+ * each step runs to completion like any other collection.  The survivors get
+ * appended to the oldest generation again, so the objects which the running
+ * pass didn't examine yet are always at its start.
+ *
+ * A cycle only gets collected if all of its objects end up in the same step.
+ * Objects created together are next to each other in the lists, and the step
+ * boundaries move from pass to pass, so that is usually the case.  Garbage
+ * which is too large for a step gets found by the full collection which
+ * collect_generations() still does once the oldest generation doubled.
+ */
+static Py_ssize_t
+collect_increment(struct _gc_runtime_state *state)
+{
+    PyGC_Head *old = GEN_HEAD(state, NUM_GENERATIONS-1);
+    PyGC_Head *young = GEN_HEAD(state, NUM_GENERATIONS-2);
+    Py_ssize_t pending, taken = 0;
+    Py_ssize_t result, collected, uncollectable, n, m;
+
+    assert(state->incremental_remaining > 0);
+    invoke_gc_callback(state, "start", NUM_GENERATIONS-2, 0, 0);
+    result = collect(state, NUM_GENERATIONS-2, &collected, &uncollectable, 0);
+
+    /* The younger generations are empty now, so the survivors of collecting
+       the increment as generation 1 are the ones of the increment. */
+    while (taken < state->incremental_budget && !gc_list_is_empty(old)) {
+        gc_list_move(GC_NEXT(old), young);
+        taken++;
+    }
+    pending = state->long_lived_pending;
+    result += collect(state, NUM_GENERATIONS-2, &m, &n, 0);
+    collected += m;
+    uncollectable += n;
+    /* it's part of the same step */
+    state->generation_stats[NUM_GENERATIONS-2].collections--;
+    state->generations[NUM_GENERATIONS-1].count--;
+    invoke_gc_callback(state, "stop", NUM_GENERATIONS-2, collected, uncollectable);
+
+    /* collect() counted the survivors as pending, but they just got
+       examined by the pass. */
+    state->incremental_survivors += state->long_lived_pending - pending;
+    state->long_lived_pending = pending;
+
+    state->incremental_remaining -= taken;
+    if (state->incremental_remaining <= 0 || taken < state->incremental_budget) {
+        /* The pass is done. */
+        state->incremental_remaining = 0;
+        state->long_lived_total = state->incremental_survivors;
+        state->incremental_survivors = 0;
+    }
+    return result;
+}
+
+/* With gc.set_adaptive(), a collection of a young generation which finds
+   less than 1% garbage doubles its threshold, up to ADAPTIVE_MAX_FACTOR
+   times the threshold set by gc.set_threshold().  One which finds more than
+   25% garbage halves it again, but not below the set threshold.  While
+   automatic collections take more than adaptive_max_time of the time,
+   thresholds only get raised. */
+#define ADAPTIVE_MAX_FACTOR 64
+
+static void
+adapt_threshold(struct _gc_runtime_state *state, int generation,
+                Py_ssize_t examined, Py_ssize_t found,
+                _PyTime_t start, _PyTime_t end)
+{
+    struct gc_generation *gen = &state->generations[generation];
+    struct gc_generation_stats *stats = &state->generation_stats[generation];
+
+    if (state->adaptive_last_end != 0 && end > state->adaptive_last_end) {
+        double fraction = _PyTime_AsSecondsDouble(end - start) /
+                          _PyTime_AsSecondsDouble(end - state->adaptive_last_end);
+        state->adaptive_time_fraction =
+            0.75 * state->adaptive_time_fraction + 0.25 * fraction;
+    }
+    state->adaptive_last_end = end;
+
+    int max_threshold = gen->base_threshold;
+    if (max_threshold <= INT_MAX / ADAPTIVE_MAX_FACTOR) {
+        max_threshold *= ADAPTIVE_MAX_FACTOR;
+    }
+    if (state->adaptive_time_fraction > state->adaptive_max_time
+        || found * 100 < examined) {
+        if (gen->threshold < max_threshold) {
+            gen->threshold = gen->threshold > max_threshold / 2 ?
+                             max_threshold : gen->threshold * 2;
+            stats->threshold_increases++;
+        }
+    }
+    else if (found * 4 > examined && gen->threshold > gen->base_threshold) {
+        gen->threshold = Py_MAX(gen->threshold / 2, gen->base_threshold);
+        stats->threshold_decreases++;
+    }
+}
+
+static Py_ssize_t
+collect_adaptive(struct _gc_runtime_state *state, int generation)
+{
+    Py_ssize_t examined = 0;
+    for (int i = 0; i <= generation; i++) {
+        examined += gc_list_size(GEN_HEAD(state, i));
+    }
+    _PyTime_t start = _PyTime_GetMonotonicClock();
+    Py_ssize_t n = collect_with_callback(state, generation);
+    adapt_threshold(state, generation, examined, n,
+                    start, _PyTime_GetMonotonicClock());
+    return n;
+}
+
 static Py_ssize_t
 collect_generations(struct _gc_runtime_state *state)
 {
@@ -1298,6 +1740,33 @@ collect_generations(struct _gc_runtime_state *state)
             if (i == NUM_GENERATIONS - 1
                 && state->long_lived_pending < state->long_lived_total / 4)
                 continue;
+            if (state->incremental_budget > 0 && i >= NUM_GENERATIONS - 2) {
+                if (i == NUM_GENERATIONS - 1
+                    && state->long_lived_total + state->long_lived_pending
+                       < 2 * state->long_lived_full_total) {
+                    /* Start an incremental pass over the oldest generation
+                       (or continue the running one) instead of collecting
+                       it as a whole.  The pass examines the objects which
+                       are in the oldest generation now. */
+                    state->generations[i].count = 0;
+                    if (state->incremental_remaining == 0) {
+                        /* Counting is much cheaper than collecting. */
+                        state->incremental_remaining =
+                            gc_list_size(GEN_HEAD(state, NUM_GENERATIONS-1));
+                        state->long_lived_pending = 0;
+                    }
+                }
+                if (state->incremental_remaining > 0) {
+                    /* Every collection of generation 1 examines the next
+                       part of the oldest generation. */
+                    n = collect_increment(state);
+                    break;
+                }
+            }
+            if (state->adaptive && i < NUM_GENERATIONS - 1) {
+                n = collect_adaptive(state, i);
+                break;
+            }
             n = collect_with_callback(state, i);
             break;
         }
@@ -1445,6 +1914,9 @@ gc_set_threshold(PyObject *self, PyObject *args)
         /* generations higher than 2 get the same threshold */
         state->generations[i].threshold = state->generations[2].threshold;
     }
+    for (int i = 0; i < NUM_GENERATIONS; i++) {
+        state->generations[i].base_threshold = state->generations[i].threshold;
+    }
     Py_RETURN_NONE;
 }
 
@@ -1460,9 +1932,153 @@ gc_get_threshold_impl(PyObject *module)
 {
     struct _gc_runtime_state *state = &_PyRuntime.gc;
     return Py_BuildValue("(iii)",
-                         state->generations[0].threshold,
-                         state->generations[1].threshold,
-                         state->generations[2].threshold);
+                         state->generations[0].base_threshold,
+                         state->generations[1].base_threshold,
+                         state->generations[2].base_threshold);
+}
+
+/*[clinic input]
+gc.set_parallel
+
+    nthreads: int
+    /
+
+Use up to nthreads threads for full collections of large heaps.
+
+The threads find the reachable objects together, while the calling thread
+holds the GIL.  0 or 1 makes collections single-threaded.
+[clinic start generated code]*/
+
+static PyObject *
+gc_set_parallel_impl(PyObject *module, int nthreads)
+/*[clinic end generated code: output=1bacc71f0882fbdf input=177b25f4c65ba01d]*/
+{
+    if (nthreads < 0) {
+        PyErr_SetString(PyExc_ValueError, "nthreads must not be negative");
+        return NULL;
+    }
+#if !GC_PARALLEL
+    if (nthreads > 1) {
+        PyErr_SetString(PyExc_NotImplementedError,
+                        "parallel collection is not supported on this platform");
+        return NULL;
+    }
+#endif
+    _PyRuntime.gc.parallel_threads = nthreads;
+    Py_RETURN_NONE;
+}
+
+/*[clinic input]
+gc.get_parallel -> int
+
+Return the number of threads set with set_parallel().
+[clinic start generated code]*/
+
+static int
+gc_get_parallel_impl(PyObject *module)
+/*[clinic end generated code: output=5b8b3265d5cdfb34 input=e18dbdc7e064533a]*/
+{
+    return _PyRuntime.gc.parallel_threads;
+}
+
+/*[clinic input]
+gc.set_adaptive
+
+    enable: bool
+    max_time: double = 0.05
+    /
+
+Adapt the thresholds of the young generations to the garbage they find.
+
+Collections which find little garbage raise the threshold of their
+generation, and ones which find much garbage lower it again, but never below
+the threshold set by set_threshold().  While automatic collections take more
+than max_time (a fraction) of the time, thresholds only get raised.
+[clinic start generated code]*/
+
+static PyObject *
+gc_set_adaptive_impl(PyObject *module, int enable, double max_time)
+/*[clinic end generated code: output=0337cf8ba2a49a72 input=478e1ccd9e622355]*/
+{
+    struct _gc_runtime_state *state = &_PyRuntime.gc;
+    if (!(max_time > 0.0 && max_time <= 1.0)) {
+        PyErr_SetString(PyExc_ValueError,
+                        "max_time must be in the range (0, 1]");
+        return NULL;
+    }
+    state->adaptive = enable;
+    state->adaptive_max_time = max_time;
+    state->adaptive_time_fraction = 0.0;
+    state->adaptive_last_end = 0;
+    if (!enable) {
+        for (int i = 0; i < NUM_GENERATIONS; i++) {
+            state->generations[i].threshold = state->generations[i].base_threshold;
+        }
+    }
+    Py_RETURN_NONE;
+}
+
+/*[clinic input]
+gc.get_adaptive
+
+Return whether thresholds are adaptive, and the max_time of set_adaptive().
+[clinic start generated code]*/
+
+static PyObject *
+gc_get_adaptive_impl(PyObject *module)
+/*[clinic end generated code: output=c43fd6d2fa87a460 input=11914e578e2a4874]*/
+{
+    struct _gc_runtime_state *state = &_PyRuntime.gc;
+    return Py_BuildValue("(Od)", state->adaptive ? Py_True : Py_False,
+                         state->adaptive_max_time);
+}
+
+/*[clinic input]
+gc.set_incremental
+
+    budget: Py_ssize_t
+    /
+
+Collect the oldest generation incrementally.
+
+Instead of examining the whole oldest generation at once, every collection
+of generation 1 also examines the next budget objects of it.  The oldest
+generation only gets collected as a whole once it doubled in size since the
+last full collection, or by collect().  A budget of 0 disables incremental
+collection.
+[clinic start generated code]*/
+
+static PyObject *
+gc_set_incremental_impl(PyObject *module, Py_ssize_t budget)
+/*[clinic end generated code: output=eb3596ce342d7b32 input=5636d513e516f88a]*/
+{
+    struct _gc_runtime_state *state = &_PyRuntime.gc;
+    if (budget < 0) {
+        PyErr_SetString(PyExc_ValueError, "budget must not be negative");
+        return NULL;
+    }
+    state->incremental_budget = budget;
+    if (budget == 0 && state->incremental_remaining > 0) {
+        /* Abort the running pass, the next full collection examines the
+           objects it didn't get to. */
+        state->long_lived_pending += state->incremental_remaining;
+        state->incremental_remaining = 0;
+        state->incremental_survivors = 0;
+    }
+    Py_RETURN_NONE;
+}
+
+/*[clinic input]
+gc.get_incremental -> Py_ssize_t
+
+Return the budget of incremental collection steps, 0 if disabled.
+[clinic start generated code]*/
+
+static Py_ssize_t
+gc_get_incremental_impl(PyObject *module)
+/*[clinic end generated code: output=5028249752fdc310 input=74d922a53c83cd70]*/
+{
+    return _PyRuntime.gc.incremental_budget;
 }
 
 /*[clinic input]
@@ -1652,12 +2268,14 @@ gc_get_stats_impl(PyObject *module)
 {
     int i;
     struct gc_generation_stats stats[NUM_GENERATIONS], *st;
+    int thresholds[NUM_GENERATIONS];
 
     /* To get consistent values despite allocations while constructing
        the result list, we use a snapshot of the running stats. */
     struct _gc_runtime_state *state = &_PyRuntime.gc;
     for (i = 0; i < NUM_GENERATIONS; i++) {
         stats[i] = state->generation_stats[i];
+        thresholds[i] = state->generations[i].threshold;
     }
 
     PyObject *result = PyList_New(0);
@@ -1667,10 +2285,14 @@ gc_get_stats_impl(PyObject *module)
     for (i = 0; i < NUM_GENERATIONS; i++) {
         PyObject *dict;
         st = &stats[i];
-        dict = Py_BuildValue("{snsnsn}",
+        dict = Py_BuildValue("{snsnsnsisdsnsn}",
                              "collections", st->collections,
                              "collected", st->collected,
-                             "uncollectable", st->uncollectable
+                             "uncollectable", st->uncollectable,
+                             "threshold", thresholds[i],
+                             "time", st->time,
+                             "threshold_increases", st->threshold_increases,
+                             "threshold_decreases", st->threshold_decreases
                             );
         if (dict == NULL)
             goto error;
@@ -1765,6 +2387,116 @@ gc_get_freeze_count_impl(PyObject *module)
     return gc_list_size(&_PyRuntime.gc.permanent_generation.head);
 }
 
+static int visit_seal(PyObject *op, void *unused);
+
+/* Immortalize an object which is not tracked, along with everything it
+   references.  Such objects are usually leaves or hold only leaves, so the
+   recursion stays shallow.  Code objects and static types are not tracked
+   and have no usable tp_traverse, so their fields get visited by hand. */
+static void
+seal_untracked(PyObject *op)
+{
+    MAKE_IMMORTAL(op);
+
+    if (PyCode_Check(op)) {
+        PyCodeObject *co = (PyCodeObject *)op;
+        visit_seal(co->co_code, NULL);
+        visit_seal(co->co_consts, NULL);
+        visit_seal(co->co_names, NULL);
+        visit_seal(co->co_varnames, NULL);
+        visit_seal(co->co_freevars, NULL);
+        visit_seal(co->co_cellvars, NULL);
+        visit_seal(co->co_filename, NULL);
+        visit_seal(co->co_name, NULL);
+        visit_seal(co->co_lnotab, NULL);
+    }
+    else if (PyType_Check(op) &&
+             !PyType_HasFeature((PyTypeObject *)op, Py_TPFLAGS_HEAPTYPE)) {
+        PyTypeObject *type = (PyTypeObject *)op;
+        visit_seal(type->tp_dict, NULL);
+        visit_seal(type->tp_mro, NULL);
+        visit_seal(type->tp_bases, NULL);
+    }
+    else if (Py_TYPE(op)->tp_traverse != NULL) {
+        Py_TYPE(op)->tp_traverse(op, visit_seal, NULL);
+    }
+}
+
+static int
+visit_seal(PyObject *op, void *unused)
+{
+    if (op == NULL || IS_IMMORTAL(op)) {
+        return 0;
+    }
+    if (PyObject_IS_GC(op) && _PyObject_GC_IS_TRACKED(op)) {
+        /* seal_list() traverses it when it gets to it */
+        MAKE_IMMORTAL(op);
+    }
+    else {
+        seal_untracked(op);
+    }
+    return 0;
+}
+
+/* Immortalize and untrack all objects of a generation list. */
+static Py_ssize_t
+seal_list(PyGC_Head *list)
+{
+    PyGC_Head *gc, *next;
+    Py_ssize_t n = 0;
+
+    for (gc = GC_NEXT(list); gc != list; gc = GC_NEXT(gc)) {
+        PyObject *op = FROM_GC(gc);
+        MAKE_IMMORTAL(op);
+        Py_TYPE(op)->tp_traverse(op, visit_seal, NULL);
+    }
+    for (gc = GC_NEXT(list); gc != list; gc = next) {
+        next = GC_NEXT(gc);
+        gc->_gc_next = 0;
+        gc->_gc_prev &= _PyGC_PREV_MASK_FINALIZED;
+        n++;
+    }
+    gc_list_init(list);
+    return n;
+}
+
+/*[clinic input]
+gc.seal -> Py_ssize_t
+
+Make all tracked objects immortal and stop tracking them.
+
+Everything the objects reference is made immortal as well.  Unlike freeze(),
+this cannot be undone: sealed objects are never freed and the collector never
+looks at them again.  This is meant to be called before a POSIX fork() call,
+so that the children keep sharing the memory of the parent's objects.
+Returns the number of objects which were untracked.
+[clinic start generated code]*/
+
+static Py_ssize_t
+gc_seal_impl(PyObject *module)
+/*[clinic end generated code: output=61178097b2faef9a input=602f586ba3c91b60]*/
+{
+    struct _gc_runtime_state *state = &_PyRuntime.gc;
+    Py_ssize_t n = 0;
+
+    if (state->collecting) {
+        PyErr_SetString(PyExc_RuntimeError,
+                        "cannot seal the heap during a collection");
+        return -1;
+    }
+    for (int i = 0; i < NUM_GENERATIONS; ++i) {
+        n += seal_list(GEN_HEAD(state, i));
+        state->generations[i].count = 0;
+    }
+    n += seal_list(&state->permanent_generation.head);
+    state->long_lived_total = 0;
+    state->long_lived_pending = 0;
+    state->long_lived_full_total = 0;
+    state->incremental_remaining = 0;
+    state->incremental_survivors = 0;
+    return n;
+}
+
 
 PyDoc_STRVAR(gc__doc__,
 "This module provides access to the garbage collector for reference cycles.\n"
@@ -1779,13 +2511,20 @@ PyDoc_STRVAR(gc__doc__,
 "get_debug() -- Get debugging flags.\n"
 "set_threshold() -- Set the collection thresholds.\n"
 "get_threshold() -- Return the current the collection thresholds.\n"
+"set_adaptive() -- Adapt the thresholds to the garbage collections find.\n"
+"get_adaptive() -- Return the settings of adaptive thresholds.\n"
+"set_parallel() -- Set the number of threads of full collections.\n"
+"get_parallel() -- Return the number of threads of full collections.\n"
+"set_incremental() -- Set the budget of incremental collection steps.\n"
+"get_incremental() -- Return the budget of incremental collection steps.\n"
 "get_objects() -- Return a list of all objects tracked by the collector.\n"
 "is_tracked() -- Returns true if a given object is tracked.\n"
 "get_referrers() -- Return the list of objects that refer to an object.\n"
 "get_referents() -- Return the list of objects that an object refers to.\n"
 "freeze() -- Freeze all tracked objects and ignore them for future collections.\n"
 "unfreeze() -- Unfreeze all objects in the permanent generation.\n"
-"get_freeze_count() -- Return the number of objects in the permanent generation.\n");
+"get_freeze_count() -- Return the number of objects in the permanent generation.\n"
+"seal() -- Make all tracked objects immortal and stop tracking them.\n");
 
 static PyMethodDef GcMethods[] = {
     GC_ENABLE_METHODDEF
@@ -1796,6 +2535,12 @@ static PyMethodDef GcMethods[] = {
     GC_GET_COUNT_METHODDEF
     {"set_threshold",  gc_set_threshold, METH_VARARGS, gc_set_thresh__doc__},
     GC_GET_THRESHOLD_METHODDEF
+    GC_SET_ADAPTIVE_METHODDEF
+    GC_GET_ADAPTIVE_METHODDEF
+    GC_SET_PARALLEL_METHODDEF
+    GC_GET_PARALLEL_METHODDEF
+    GC_SET_INCREMENTAL_METHODDEF
+    GC_GET_INCREMENTAL_METHODDEF
     GC_COLLECT_METHODDEF
     GC_GET_OBJECTS_METHODDEF
     GC_GET_STATS_METHODDEF
@@ -1807,6 +2552,7 @@ static PyMethodDef GcMethods[] = {
     GC_FREEZE_METHODDEF
     GC_UNFREEZE_METHODDEF
     GC_GET_FREEZE_COUNT_METHODDEF
+    GC_SEAL_METHODDEF
     {NULL,      NULL}           /* Sentinel */
 };
 
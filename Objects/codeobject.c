@@ -2,6 +2,7 @@
 
 #include "Python.h"
 #include "code.h"
+#include "frameobject.h"
 #include "opcode.h"
 #include "structmember.h"
 #include "pycore_code.h"
@@ -242,6 +243,10 @@ PyCode_NewWithPosOnlyArgs(int argcount, int posonlyargcount, int kwonlyargcount,
 #if PYSTON_SPEEDUPS
     co->co_builtins_cache_ver = 0;
     co->co_jit_code = 0;
+    co->co_jit_code_retired = NULL;
+    co->co_jit_num_active = 0;
+    co->co_jit_num_recompiles = 0;
+    co->co_jit_queued = 0;
 #endif
     return co;
 }
@@ -264,7 +269,7 @@ int
 _PyCode_InitOpcache(PyCodeObject *co)
 {
     Py_ssize_t co_size = PyBytes_Size(co->co_code) / sizeof(_Py_CODEUNIT);
-    co->co_opcache_map = (unsigned char *)PyMem_Calloc(co_size, 1);
+    co->co_opcache_map = (_PyOpcacheIdx *)PyMem_Calloc(co_size, sizeof(_PyOpcacheIdx));
     if (co->co_opcache_map == NULL) {
         return -1;
     }
@@ -284,11 +289,13 @@ _PyCode_InitOpcache(PyCodeObject *co)
                 || opcode == BINARY_MULTIPLY || opcode == INPLACE_MULTIPLY
                 || opcode == BINARY_SUBSCR || opcode == STORE_SUBSCR
                 || opcode == LOAD_NAME
+                || (USE_CALL_CACHE && (opcode == CALL_FUNCTION || opcode == CALL_FUNCTION_KW || opcode == CALL_METHOD))
+                || opcode == COMPARE_OP || opcode == FOR_ITER
 #endif
                 ) {
             opts++;
-            co->co_opcache_map[i] = (unsigned char)opts;
-            if (opts > 254) {
+            co->co_opcache_map[i] = (_PyOpcacheIdx)opts;
+            if (opts >= _PyOpcacheIdx_MAX) {
                 break;
             }
         }
@@ -307,7 +314,7 @@ _PyCode_InitOpcache(PyCodeObject *co)
         co->co_opcache = NULL;
     }
 
-    co->co_opcache_size = (unsigned char)opts;
+    co->co_opcache_size = (_PyOpcacheIdx)opts;
     return 0;
 }
 
@@ -535,9 +542,21 @@ code_new(PyTypeObject *type, PyObject *args, PyObject *kw)
     return co;
 }
 
+#if PYSTON_SPEEDUPS && defined(ENABLE_AOT)
+void jit_free_code(void* code);
+void jit_free_retired_code(void* retired);
+#endif
+
 static void
 code_dealloc(PyCodeObject *co)
 {
+#if PYSTON_SPEEDUPS && defined(ENABLE_AOT)
+    jit_free_code(co->co_jit_code);
+    co->co_jit_code = NULL;
+    // machine code which got replaced by a recompilation but was still in use
+    jit_free_retired_code(co->co_jit_code_retired);
+    co->co_jit_code_retired = NULL;
+#endif
     if (co->co_opcache != NULL) {
         PyMem_FREE(co->co_opcache);
     }
@@ -573,8 +592,11 @@ code_dealloc(PyCodeObject *co)
     Py_XDECREF(co->co_lnotab);
     if (co->co_cell2arg != NULL)
         PyMem_FREE(co->co_cell2arg);
-    if (co->co_zombieframe != NULL)
-        PyObject_GC_Del(co->co_zombieframe);
+    while (co->co_zombieframe != NULL) {
+        PyFrameObject *f = co->co_zombieframe;
+        co->co_zombieframe = f->f_back;
+        PyObject_GC_Del(f);
+    }
     if (co->co_weakreflist != NULL)
         PyObject_ClearWeakRefs((PyObject*)co);
     PyObject_DEL(co);
@@ -596,7 +618,7 @@ code_sizeof(PyCodeObject *co, PyObject *Py_UNUSED(args))
     if (co->co_opcache != NULL) {
         assert(co->co_opcache_map != NULL);
         // co_opcache_map
-        res += PyBytes_GET_SIZE(co->co_code) / sizeof(_Py_CODEUNIT);
+        res += PyBytes_GET_SIZE(co->co_code) / sizeof(_Py_CODEUNIT) * sizeof(_PyOpcacheIdx);
         // co_opcache
         res += co->co_opcache_size * sizeof(_PyOpcache);
     }
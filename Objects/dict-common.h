@@ -47,8 +47,9 @@ struct _dictkeysobject {
     Py_ssize_t dk_nentries;
 
 #if PYSTON_SPEEDUPS
-    /* Version of the key object. Only updated if it's a split dictionary!
-      Can be used to guard on the shape of the splitdict dictionary. */
+    /* Version of the key object. Updated whenever the set of keys changes
+      (and when the table gets split) but not when only a value gets modified.
+      Can be used to guard on the shape of the dictionary. */
     uint64_t dk_version_tag;
 #endif
 
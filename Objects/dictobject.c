@@ -1083,15 +1083,15 @@ insertdict(PyDictObject *mp, PyObject *key, Py_hash_t hash, PyObject *value)
         if (mp->ma_values) {
             assert (mp->ma_values[mp->ma_keys->dk_nentries] == NULL);
             mp->ma_values[mp->ma_keys->dk_nentries] = value;
-#if PYSTON_SPEEDUPS
-            // we need to increase dk_version_tag because some code could make assumption
-            // about the number of dict keys which we just changed by appending one
-            mp->ma_keys->dk_version_tag = DICTKEYS_NEXT_VERSION();
-#endif
         }
         else {
             ep->me_value = value;
         }
+#if PYSTON_SPEEDUPS
+        // we need to increase dk_version_tag because some code could make assumption
+        // about the set of dict keys which we just changed by appending one
+        mp->ma_keys->dk_version_tag = DICTKEYS_NEXT_VERSION();
+#endif
         mp->ma_used++;
         mp->ma_version_tag = DICT_NEXT_VERSION();
         mp->ma_keys->dk_usable--;
@@ -1324,6 +1324,10 @@ make_keys_shared(PyObject *op)
         }
         mp->ma_keys->dk_lookup = lookdict_split;
         mp->ma_values = values;
+#if PYSTON_SPEEDUPS
+        // the entries don't hold the values anymore
+        mp->ma_keys->dk_version_tag = DICTKEYS_NEXT_VERSION();
+#endif
     }
     dictkeys_incref(mp->ma_keys);
     return mp->ma_keys;
@@ -1566,6 +1570,33 @@ int64_t _PyDict_GetItemOffsetSplit(PyDictObject *mp, PyObject *key, Py_ssize_t *
     return ix;
 }
 
+// retrieves a borrowed object using the offset in bytes from ma_keys to the me_value of the entry.
+// The keys version guards that the entry still belongs to the key we looked up.
+// Returns NULL if the dict is a split dict because the entries don't hold any values.
+PyObject* _PyDict_GetItemByKeysVersion(PyDictObject *mp, uint64_t keys_ver, int64_t offset) {
+    assert(PyDict_CheckExact((PyObject*)mp));
+    assert(offset >= 0);
+
+    if (mp->ma_keys->dk_version_tag != keys_ver)
+        return NULL;
+
+    return *(PyObject**)((char*)mp->ma_keys + offset);
+}
+
+// returns the offset in bytes from ma_keys to the me_value of the entry of key
+// and stores the current keys version, or -1 if it can't be cached
+int64_t _PyDict_GetItemKeysVersionOffset(PyDictObject *mp, PyObject *key, uint64_t *keys_ver)
+{
+    Py_ssize_t dk_size;
+    int64_t offset = _PyDict_GetItemOffset(mp, key, &dk_size);
+    if (offset < 0)
+        return -1;
+
+    PyDictKeyEntry *ep = (PyDictKeyEntry*)(mp->ma_keys->dk_indices + offset);
+    *keys_ver = mp->ma_keys->dk_version_tag;
+    return (char*)&ep->me_value - (char*)mp->ma_keys;
+}
+
 PyObject *
 _PyDict_GetItemFromSplitDict(PyObject *op, Py_ssize_t index) {
     PyDictObject* mp = (PyDictObject *)op;
@@ -1771,8 +1802,10 @@ delitem_common(PyDictObject *mp, Py_hash_t hash, Py_ssize_t ix,
 
     mp->ma_used--;
     mp->ma_version_tag = DICT_NEXT_VERSION();
-    // we don't increase ma_keys->dk_version_tag
-    // because it can't be a splitdict
+#if PYSTON_SPEEDUPS
+    // the set of keys changed (this can't be a splitdict)
+    mp->ma_keys->dk_version_tag = DICTKEYS_NEXT_VERSION();
+#endif
     ep = &DK_ENTRIES(mp->ma_keys)[ix];
     dictkeys_set_index(mp->ma_keys, hashpos, DKIX_DUMMY);
     ENSURE_ALLOWS_DELETIONS(mp);
@@ -2044,8 +2077,10 @@ _PyDict_Pop_KnownHash(PyObject *dict, PyObject *key, Py_hash_t hash, PyObject *d
     assert(old_value != NULL);
     mp->ma_used--;
     mp->ma_version_tag = DICT_NEXT_VERSION();
-    // we don't increase ma_keys->dk_version_tag
-    // because it can't be a splitdict
+#if PYSTON_SPEEDUPS
+    // the set of keys changed (this can't be a splitdict)
+    mp->ma_keys->dk_version_tag = DICTKEYS_NEXT_VERSION();
+#endif
     dictkeys_set_index(mp->ma_keys, hashpos, DKIX_DUMMY);
     ep = &DK_ENTRIES(mp->ma_keys)[ix];
     ENSURE_ALLOWS_DELETIONS(mp);
@@ -3146,15 +3181,15 @@ PyDict_SetDefault(PyObject *d, PyObject *key, PyObject *defaultobj)
         if (_PyDict_HasSplitTable(mp)) {
             assert(mp->ma_values[mp->ma_keys->dk_nentries] == NULL);
             mp->ma_values[mp->ma_keys->dk_nentries] = value;
-#if PYSTON_SPEEDUPS
-            // we need to increase dk_version_tag because some code could make assumption
-            // about the number of dict keys which we just changed by appending one
-            mp->ma_keys->dk_version_tag = DICTKEYS_NEXT_VERSION();
-#endif
         }
         else {
             ep->me_value = value;
         }
+#if PYSTON_SPEEDUPS
+        // we need to increase dk_version_tag because some code could make assumption
+        // about the set of dict keys which we just changed by appending one
+        mp->ma_keys->dk_version_tag = DICTKEYS_NEXT_VERSION();
+#endif
         mp->ma_used++;
         mp->ma_version_tag = DICT_NEXT_VERSION();
         mp->ma_keys->dk_usable--;
@@ -3307,8 +3342,11 @@ dict_popitem_impl(PyDictObject *self)
     self->ma_keys->dk_nentries = i;
     self->ma_used--;
     self->ma_version_tag = DICT_NEXT_VERSION();
-    // we don't increase ma_keys->dk_version_tag
-    // because it can't be a splitdict
+#if PYSTON_SPEEDUPS
+    // the set of keys changed (this can't be a splitdict)
+    // and the next insertion will reuse the entry we just freed
+    self->ma_keys->dk_version_tag = DICTKEYS_NEXT_VERSION();
+#endif
     ASSERT_CONSISTENT(self);
     return res;
 }
@@ -372,12 +372,14 @@ frame_settrace(PyFrameObject *f, PyObject* v, void *closure)
 /* Stack frames are allocated and deallocated at a considerable rate.
    In an attempt to improve the speed of function calls, we:
 
-   1. Hold a single "zombie" frame on each code object. This retains
-   the allocated and initialised frame object from an invocation of
-   the code object. The zombie is reanimated the next time we need a
-   frame object for that code object. Doing this saves the malloc/
+   1. Hold up to PyFrame_MAXZOMBIES "zombie" frames on each code object.
+   This retains the allocated and initialised frame objects from
+   invocations of the code object. A zombie is reanimated the next time we
+   need a frame object for that code object. Doing this saves the malloc/
    realloc required when using a free_list frame that isn't the
-   correct size. It also saves some field initialisation.
+   correct size. It also saves some field initialisation.  Holding more
+   than one helps recursive functions and generators, which have several
+   frames of the same code alive at once.
 
    In zombie mode, no field of PyFrameObject holds a reference, but
    the following fields are still valid:
@@ -387,7 +389,10 @@ frame_settrace(PyFrameObject *f, PyObject* v, void *closure)
      * f_locals, f_trace are NULL;
 
      * f_localsplus does not require re-allocation and
-       the local variables in f_localsplus are NULL.
+       the local variables in f_localsplus are NULL;
+
+     * f_back is the next zombie of the code object, or NULL, and
+       f_iblock is the number of zombies from this one on.
 
    2. We also maintain a separate free list of stack frames (just like
    floats are allocated in a special way -- see floatobject.c).  When
@@ -418,6 +423,28 @@ frame_settrace(PyFrameObject *f, PyObject* v, void *closure)
 /* static */ int numfree = 0;         /* number of frames currently in free_list */
 /* max value for numfree */
 #define PyFrame_MAXFREELIST 200
+/* max number of zombie frames per code object */
+#define PyFrame_MAXZOMBIES 8
+
+/* Keep f, whose references are cleared already, as a zombie of co or
+   on the free list if there is room, else free it. */
+static inline void
+frame_release(PyFrameObject *f, PyCodeObject *co)
+{
+    PyFrameObject *zombie = co->co_zombieframe;
+    if (zombie == NULL || zombie->f_iblock < PyFrame_MAXZOMBIES) {
+        f->f_back = zombie;
+        f->f_iblock = zombie == NULL ? 1 : zombie->f_iblock + 1;
+        co->co_zombieframe = f;
+    }
+    else if (numfree < PyFrame_MAXFREELIST) {
+        ++numfree;
+        f->f_back = free_list;
+        free_list = f;
+    }
+    else
+        PyObject_GC_Del(f);
+}
 
 /* static */ void _Py_HOT_FUNCTION
 frame_dealloc_notrashcan(PyFrameObject *f)
@@ -448,15 +475,7 @@ frame_dealloc_notrashcan(PyFrameObject *f)
     Py_CLEAR(f->f_trace);
 
     co = f->f_code;
-    if (co->co_zombieframe == NULL)
-        co->co_zombieframe = f;
-    else if (numfree < PyFrame_MAXFREELIST) {
-        ++numfree;
-        f->f_back = free_list;
-        free_list = f;
-    }
-    else
-        PyObject_GC_Del(f);
+    frame_release(f, co);
 
     Py_DECREF(co);
     //Py_TRASHCAN_SAFE_END(f)
@@ -491,15 +510,7 @@ frame_dealloc(PyFrameObject *f)
     Py_CLEAR(f->f_trace);
 
     co = f->f_code;
-    if (co->co_zombieframe == NULL)
-        co->co_zombieframe = f;
-    else if (numfree < PyFrame_MAXFREELIST) {
-        ++numfree;
-        f->f_back = free_list;
-        free_list = f;
-    }
-    else
-        PyObject_GC_Del(f);
+    frame_release(f, co);
 
     Py_DECREF(co);
     Py_TRASHCAN_END;
@@ -719,7 +730,7 @@ _PyFrame_New_NoTrack(PyThreadState *tstate, PyCodeObject *code,
     }
     if (code->co_zombieframe != NULL) {
         f = code->co_zombieframe;
-        code->co_zombieframe = NULL;
+        code->co_zombieframe = f->f_back;
         _Py_NewReference((PyObject *)f);
         assert(f->f_code == code);
     }
@@ -5,6 +5,7 @@
 #include "pycore_pystate.h"
 #include "pycore_tupleobject.h"
 #include "pycore_accu.h"
+#include "pycore_list.h"
 
 #ifdef STDC_HEADERS
 #include <stddef.h>
@@ -3110,11 +3111,7 @@ PyTypeObject PyList_Type = {
 
 /*********************** List Iterator **************************/
 
-typedef struct {
-    PyObject_HEAD
-    Py_ssize_t it_index;
-    PyListObject *it_seq; /* Set to NULL when iterator is exhausted */
-} listiterobject;
+typedef _PyListIterObject listiterobject;
 
 /* static */ void listiter_dealloc(listiterobject *);
 /* static */ int listiter_traverse(listiterobject *, visitproc, void *);
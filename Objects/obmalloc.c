@@ -823,17 +823,17 @@ PyObject_Free(void *ptr)
 
 #ifdef WITH_PYMALLOC
 
-#ifdef WITH_VALGRIND
-#include <valgrind/valgrind.h>
-
 /* If we're using GCC, use __builtin_expect() to reduce overhead of
-   the valgrind checks */
+   the valgrind and nursery checks */
 #if defined(__GNUC__) && (__GNUC__ > 2) && defined(__OPTIMIZE__)
 #  define UNLIKELY(value) __builtin_expect((value), 0)
 #else
 #  define UNLIKELY(value) (value)
 #endif
 
+#ifdef WITH_VALGRIND
+#include <valgrind/valgrind.h>
+
 /* -1 indicates that we haven't checked that we're running on valgrind yet. */
 static int running_on_valgrind = -1;
 #endif
@@ -1081,6 +1081,15 @@ struct arena_object {
     /* Singly-linked list of available pools. */
     struct pool_header* freepools;
 
+    /* The number of pools on the freepools list. */
+    uint ncachedpools;
+
+    /* Bitmap of the available pools whose memory was given back to the OS
+     * by arena_trim(), indexed by the position of the pool in the arena.
+     * Their headers are gone, so they are not on the freepools list.
+     */
+    uint64_t trimmed_pools;
+
     /* Whenever this arena_object is not associated with an allocated
      * arena, the nextarena member is used to link all unassociated
      * arena_objects in the singly-linked `unused_arena_objects` list.
@@ -1319,6 +1328,54 @@ static size_t narenas_highwater = 0;
 
 static Py_ssize_t _Py_AllocatedBlocks = 0;
 
+/* If not 0, the memory of the free pools of an arena gets given back to the OS
+ * once that many free pools accumulated on its freepools list (set with
+ * PYTHONMALLOCTRIM).  _PyObject_TrimArenas() does it for all arenas on demand.
+ */
+static uint trim_threshold = 0;
+
+/* Total number of pools whose memory was given back to the OS. */
+static size_t npools_trimmed = 0;
+
+/*==========================================================================*/
+
+/*
+ * Nursery mode (enabled by setting PYTHONMALLOCNURSERY to a non-empty string).
+
+By default the most recently freed block of a size class is the next one to be
+handed out, so short-lived temporaries (bound methods, argument tuples, boxed
+floats, ...) get scattered over the same pools as long-lived objects.  A pool
+can only be given back to its arena once all of its blocks are free, which
+rarely happens when every pool holds a few survivors.
+
+In nursery mode each size class has a nursery pool which new blocks get bump
+allocated from whenever the used pools of the size class have no free blocks or
+only sparse ones (less than NURSERY_REUSE_MIN_BLOCKS allocated).  Sparse pools
+get moved to the back of the usedpools list, so that denser pools are filled
+first and the sparse ones get a chance to drain and be freed as a whole.  Blocks
+freed inside the nursery pool are not reused individually; once the last block
+of the nursery pool is freed its bump pointer gets reset, which reuses the whole
+pool at once.  When the bump pointer reaches the end of the pool it retires into
+a normal pool.  A new nursery pool only gets allocated once the used pools of
+its size class are full, so the heap doesn't grow while free blocks are left.
+
+Objects can't be moved, so this can't compact survivors:  it only keeps bursts
+of temporaries out of pools holding long-lived objects.
+*/
+static int nursery_enabled = 0;
+
+/* Pools with fewer allocated blocks are sparse:  they are only reused once
+   the nursery pool is full */
+#define NURSERY_REUSE_MIN_BLOCKS(I) (NUMBLOCKS(I) / 4)
+
+/* The current nursery pool of every size class, NULL if there is none. */
+static poolp nursery_pools[NB_SMALL_SIZE_CLASSES] = { NULL };
+
+/* Number of times a nursery pool got empty and was reused as a whole. */
+static size_t nursery_resets = 0;
+/* Number of nursery pools which got full and were turned into normal pools. */
+static size_t nursery_retired = 0;
+
 Py_ssize_t
 _Py_GetAllocatedBlocks(void)
 {
@@ -1342,6 +1399,14 @@ new_arena(void)
     if (debug_stats == -1) {
         const char *opt = Py_GETENV("PYTHONMALLOCSTATS");
         debug_stats = (opt != NULL && *opt != '\0');
+        /* This is the first arena, so there are no pools yet. */
+        opt = Py_GETENV("PYTHONMALLOCNURSERY");
+        nursery_enabled = (opt != NULL && *opt != '\0');
+        opt = Py_GETENV("PYTHONMALLOCTRIM");
+        if (opt != NULL && *opt != '\0') {
+            int n = atoi(opt);
+            trim_threshold = n > 1 ? (uint)n : 1;
+        }
     }
     if (debug_stats)
         _PyObject_DebugMallocStats(stderr);
@@ -1413,6 +1478,8 @@ new_arena(void)
     if (narenas_currently_allocated > narenas_highwater)
         narenas_highwater = narenas_currently_allocated;
     arenaobj->freepools = NULL;
+    arenaobj->ncachedpools = 0;
+    arenaobj->trimmed_pools = 0;
     /* pool_address <- first pool-aligned address in the arena
        nfreepools <- number of whole pools that fit after alignment */
     arenaobj->pool_address = (block*)arenaobj->address;
@@ -1522,93 +1589,27 @@ address_in_range(void *p, poolp pool)
 
 /*==========================================================================*/
 
-/* pymalloc allocator
-
-   The basic blocks are ordered by decreasing execution frequency,
-   which minimizes the number of jumps in the most common cases,
-   improves branching prediction and instruction scheduling (small
-   block allocations typically result in a couple of instructions).
-   Unless the optimizer reorders everything, being too smart...
-
-   Return a pointer to newly allocated memory if pymalloc allocated memory.
-
-   Return NULL if pymalloc failed to allocate the memory block: on bigger
-   requests, on error in the code below (as a last chance to serve the request)
-   or when the max memory limit has been reached. */
-static void*
-pymalloc_alloc(void *ctx, size_t nbytes)
+/* Take a free pool from usable_arenas, allocating a new arena if there is
+ * none.  The pool isn't linked into any list.  Its szidx is still the one of
+ * its last use (DUMMY_SIZE_IDX for a newly carved off pool), so the caller can
+ * skip initializing the free list if it is of the same size class.
+ * Return NULL if no arena could be allocated.
+ */
+static poolp
+allocate_pool(void)
 {
-    block *bp;
     poolp pool;
-    poolp next;
-    uint size;
-
-#ifdef WITH_VALGRIND
-    if (UNLIKELY(running_on_valgrind == -1)) {
-        running_on_valgrind = RUNNING_ON_VALGRIND;
-    }
-    if (UNLIKELY(running_on_valgrind)) {
-        return NULL;
-    }
-#endif
-
-    if (nbytes == 0) {
-        return NULL;
-    }
-    if (nbytes > SMALL_REQUEST_THRESHOLD) {
-        return NULL;
-    }
-
-    /*
-     * Most frequent paths first
-     */
-    size = (uint)(nbytes - 1) >> ALIGNMENT_SHIFT;
-    pool = usedpools[size + size];
-    if (pool != pool->nextpool) {
-        /*
-         * There is a used pool for this size class.
-         * Pick up the head block of its free list.
-         */
-        ++pool->ref.count;
-        bp = pool->freeblock;
-        assert(bp != NULL);
-        if ((pool->freeblock = *(block **)bp) != NULL) {
-            goto success;
-        }
-
-        /*
-         * Reached the end of the free list, try to extend it.
-         */
-        if (pool->nextoffset <= pool->maxnextoffset) {
-            /* There is room for another block. */
-            pool->freeblock = (block*)pool +
-                              pool->nextoffset;
-            pool->nextoffset += INDEX2SIZE(size);
-            *(block **)(pool->freeblock) = NULL;
-            goto success;
-        }
-
-        /* Pool is full, unlink from used pools. */
-        next = pool->nextpool;
-        pool = pool->prevpool;
-        next->prevpool = pool;
-        pool->nextpool = next;
-        goto success;
-    }
 
-    /* There isn't a pool of the right size class immediately
-     * available:  use a free pool.
-     */
     if (usable_arenas == NULL) {
         /* No arena has a free pool:  allocate a new arena. */
 #ifdef WITH_MEMORY_LIMITS
         if (narenas_currently_allocated >= MAX_ARENAS) {
-            goto failed;
+            return NULL;
         }
 #endif
         usable_arenas = new_arena();
         if (usable_arenas == NULL) {
-            goto failed;
+            return NULL;
         }
         usable_arenas->nextarena =
             usable_arenas->prevarena = NULL;
@@ -1638,6 +1639,7 @@ pymalloc_alloc(void *ctx, size_t nbytes)
     if (pool != NULL) {
         /* Unlink from cached pools. */
         usable_arenas->freepools = pool->nextpool;
+        --usable_arenas->ncachedpools;
         --usable_arenas->nfreepools;
         if (usable_arenas->nfreepools == 0) {
             /* Wholly allocated:  remove. */
@@ -1653,59 +1655,43 @@ pymalloc_alloc(void *ctx, size_t nbytes)
         }
         else {
             /* nfreepools > 0:  it must be that freepools
-             * isn't NULL, or that we haven't yet carved
-             * off all the arena's pools for the first
-             * time.
+             * isn't NULL, that there are trimmed pools, or
+             * that we haven't yet carved off all the arena's
+             * pools for the first time.
              */
             assert(usable_arenas->freepools != NULL ||
+                   usable_arenas->trimmed_pools != 0 ||
                    usable_arenas->pool_address <=
                    (block*)usable_arenas->address +
                        ARENA_SIZE - POOL_SIZE);
         }
-
-    init_pool:
-        /* Frontlink to used pools. */
-        next = usedpools[size + size]; /* == prev */
-        pool->nextpool = next;
-        pool->prevpool = next;
-        next->nextpool = pool;
-        next->prevpool = pool;
-        pool->ref.count = 1;
-        if (pool->szidx == size) {
-            /* Luckily, this pool last contained blocks
-             * of the same size class, so its header
-             * and free list are already initialized.
-             */
-            bp = pool->freeblock;
-            assert(bp != NULL);
-            pool->freeblock = *(block **)bp;
-            goto success;
-        }
-        /*
-         * Initialize the pool header, set up the free list to
-         * contain just the second block, and return the first
-         * block.
-         */
-        pool->szidx = size;
-        size = INDEX2SIZE(size);
-        bp = (block *)pool + POOL_OVERHEAD;
-        pool->nextoffset = POOL_OVERHEAD + (size << 1);
-        pool->maxnextoffset = POOL_SIZE - size;
-        pool->freeblock = bp + size;
-        *(block **)(pool->freeblock) = NULL;
-        goto success;
+        return pool;
     }
 
-    /* Carve off a new pool. */
     assert(usable_arenas->nfreepools > 0);
     assert(usable_arenas->freepools == NULL);
-    pool = (poolp)usable_arenas->pool_address;
-    assert((block*)pool <= (block*)usable_arenas->address +
-                             ARENA_SIZE - POOL_SIZE);
+    if (usable_arenas->trimmed_pools != 0) {
+        /* Reuse the first trimmed pool before carving off new ones, which
+         * keeps the arena compact.  Its header needs to be rebuilt.
+         */
+        uint i = 0;
+        while (!((usable_arenas->trimmed_pools >> i) & 1)) {
+            ++i;
+        }
+        usable_arenas->trimmed_pools &= ~((uint64_t)1 << i);
+        pool = (poolp)((block*)_Py_ALIGN_UP(usable_arenas->address,
+                                            POOL_SIZE) + i * POOL_SIZE);
+    }
+    else {
+        /* Carve off a new pool. */
+        pool = (poolp)usable_arenas->pool_address;
+        assert((block*)pool <= (block*)usable_arenas->address +
+                                 ARENA_SIZE - POOL_SIZE);
+        usable_arenas->pool_address += POOL_SIZE;
+    }
     pool->arenaindex = (uint)(usable_arenas - arenas);
     assert(&arenas[pool->arenaindex] == usable_arenas);
     pool->szidx = DUMMY_SIZE_IDX;
-    usable_arenas->pool_address += POOL_SIZE;
     --usable_arenas->nfreepools;
 
     if (usable_arenas->nfreepools == 0) {
@@ -1720,7 +1706,297 @@ pymalloc_alloc(void *ctx, size_t nbytes)
         }
     }
 
-    goto init_pool;
+    return pool;
+}
+
+
+/* Give the memory of the pools on the freepools list of arena `ao` back to
+ * the OS, which keeps the address range mapped.  Return the number of bytes
+ * released.
+ */
+static size_t
+arena_trim(struct arena_object *ao)
+{
+#if defined(ARENAS_USE_MMAP) && defined(MADV_DONTNEED)
+    uintptr_t base = (uintptr_t)_Py_ALIGN_UP(ao->address, POOL_SIZE);
+    uint64_t trimmed = 0;
+    size_t released = 0;
+    poolp pool;
+    uint i, start;
+
+    Py_BUILD_ASSERT(MAX_POOLS_IN_ARENA <= 64);
+#if PY_DEBUGGING_FEATURES
+    if (_PyObject_Arena.alloc != _PyObject_ArenaMmap) {
+        /* The arena may not be backed by anonymous memory. */
+        return 0;
+    }
+#endif
+    for (pool = ao->freepools; pool != NULL; pool = pool->nextpool) {
+        trimmed |= (uint64_t)1 << (((uintptr_t)pool - base) / POOL_SIZE);
+    }
+    ao->freepools = NULL;
+    ao->ncachedpools = 0;
+    ao->trimmed_pools |= trimmed;
+
+    /* One madvise() call per run of adjacent pools. */
+    i = 0;
+    while (i < MAX_POOLS_IN_ARENA) {
+        if (!((trimmed >> i) & 1)) {
+            ++i;
+            continue;
+        }
+        start = i;
+        while (i < MAX_POOLS_IN_ARENA && ((trimmed >> i) & 1)) {
+            ++i;
+        }
+        if (madvise((void *)(base + start * POOL_SIZE),
+                    (i - start) * POOL_SIZE, MADV_DONTNEED) == 0) {
+            released += (i - start) * POOL_SIZE;
+        }
+    }
+    npools_trimmed += released / POOL_SIZE;
+    return released;
+#else
+    return 0;
+#endif
+}
+
+/* Give the memory of all free pools in partially used arenas back to the OS.
+ * Return the number of bytes released.
+ */
+size_t
+_PyObject_TrimArenas(void)
+{
+    struct arena_object *ao;
+    size_t released = 0;
+
+    /* Only arenas with available pools can have free pools. */
+    for (ao = usable_arenas; ao != NULL; ao = ao->nextarena) {
+        released += arena_trim(ao);
+    }
+    return released;
+}
+
+
+/* The nursery pool of size class `size` is full:  turn it into a normal pool.
+ * Blocks which got freed in the meantime are on its free list, so it is
+ * linked into usedpools just like a full pool which got a block freed.
+ */
+static void
+nursery_retire(uint size)
+{
+    poolp pool = nursery_pools[size];
+    poolp next, prev;
+
+    assert(pool->szidx == size);
+    assert(pool->nextoffset > pool->maxnextoffset);
+    nursery_pools[size] = NULL;
+    ++nursery_retired;
+    if (pool->freeblock == NULL) {
+        /* Still full:  pymalloc_free() will link it once a block gets freed. */
+        return;
+    }
+    next = usedpools[size + size];
+    prev = next->prevpool;
+    pool->nextpool = next;
+    pool->prevpool = prev;
+    next->prevpool = pool;
+    prev->nextpool = pool;
+}
+
+/* All blocks of a nursery pool were freed:  start over at its first block. */
+static void
+nursery_reset(poolp pool)
+{
+    assert(pool->ref.count == 0);
+    pool->freeblock = NULL;
+    pool->nextoffset = POOL_OVERHEAD;
+    ++nursery_resets;
+}
+
+/* Bump allocate a block of size class `size` from its nursery pool.
+ * Return NULL if the nursery pool is full and the used pools of the size
+ * class still have free blocks, or if no new pool could be allocated.
+ */
+static block *
+nursery_alloc(uint size)
+{
+    poolp pool = nursery_pools[size];
+    block *bp;
+
+    if (pool == NULL || pool->nextoffset > pool->maxnextoffset) {
+        poolp used;
+
+        if (pool != NULL) {
+            nursery_retire(size);
+        }
+        used = usedpools[size + size];
+        if (used != used->nextpool) {
+            /* Don't take a new pool while there are free blocks left. */
+            return NULL;
+        }
+        pool = allocate_pool();
+        if (pool == NULL) {
+            return NULL;
+        }
+        /* The nursery pool isn't linked into usedpools, allocations only
+         * come from the bump pointer.
+         */
+        pool->nextpool = pool->prevpool = NULL;
+        pool->szidx = size;
+        pool->ref.count = 0;
+        pool->freeblock = NULL;
+        pool->nextoffset = POOL_OVERHEAD;
+        pool->maxnextoffset = POOL_SIZE - INDEX2SIZE(size);
+        nursery_pools[size] = pool;
+    }
+    bp = (block *)pool + pool->nextoffset;
+    pool->nextoffset += INDEX2SIZE(size);
+    ++pool->ref.count;
+    return bp;
+}
+
+
+/* pymalloc allocator
+
+   The basic blocks are ordered by decreasing execution frequency,
+   which minimizes the number of jumps in the most common cases,
+   improves branching prediction and instruction scheduling (small
+   block allocations typically result in a couple of instructions).
+   Unless the optimizer reorders everything, being too smart...
+
+   Return a pointer to newly allocated memory if pymalloc allocated memory.
+
+   Return NULL if pymalloc failed to allocate the memory block: on bigger
+   requests, on error in the code below (as a last chance to serve the request)
+   or when the max memory limit has been reached. */
+static void*
+pymalloc_alloc(void *ctx, size_t nbytes)
+{
+    block *bp;
+    poolp pool;
+    poolp next;
+    uint size;
+
+#ifdef WITH_VALGRIND
+    if (UNLIKELY(running_on_valgrind == -1)) {
+        running_on_valgrind = RUNNING_ON_VALGRIND;
+    }
+    if (UNLIKELY(running_on_valgrind)) {
+        return NULL;
+    }
+#endif
+
+    if (nbytes == 0) {
+        return NULL;
+    }
+    if (nbytes > SMALL_REQUEST_THRESHOLD) {
+        return NULL;
+    }
+
+    /*
+     * Most frequent paths first
+     */
+    size = (uint)(nbytes - 1) >> ALIGNMENT_SHIFT;
+    pool = usedpools[size + size];
+    if (UNLIKELY(nursery_enabled)) {
+        if (pool != pool->nextpool &&
+            pool->ref.count < NURSERY_REUSE_MIN_BLOCKS(size) &&
+            pool->nextpool != pool->prevpool) {
+            /* More than one used pool:  move the sparse one to the back
+             * so that the denser ones get filled up first.
+             */
+            poolp head = pool->prevpool;
+            poolp tail = head->prevpool;
+            next = pool->nextpool;
+            head->nextpool = next;
+            next->prevpool = head;
+            pool->prevpool = tail;
+            pool->nextpool = head;
+            tail->nextpool = pool;
+            head->prevpool = pool;
+            pool = next;
+        }
+        if (pool == pool->nextpool ||
+            pool->ref.count < NURSERY_REUSE_MIN_BLOCKS(size)) {
+            bp = nursery_alloc(size);
+            if (bp != NULL) {
+                goto success;
+            }
+            /* Fill up the used pools before starting a new nursery pool. */
+            pool = usedpools[size + size];
+        }
+    }
+    if (pool != pool->nextpool) {
+        /*
+         * There is a used pool for this size class.
+         * Pick up the head block of its free list.
+         */
+        ++pool->ref.count;
+        bp = pool->freeblock;
+        assert(bp != NULL);
+        if ((pool->freeblock = *(block **)bp) != NULL) {
+            goto success;
+        }
+
+        /*
+         * Reached the end of the free list, try to extend it.
+         */
+        if (pool->nextoffset <= pool->maxnextoffset) {
+            /* There is room for another block. */
+            pool->freeblock = (block*)pool +
+                              pool->nextoffset;
+            pool->nextoffset += INDEX2SIZE(size);
+            *(block **)(pool->freeblock) = NULL;
+            goto success;
+        }
+
+        /* Pool is full, unlink from used pools. */
+        next = pool->nextpool;
+        pool = pool->prevpool;
+        next->prevpool = pool;
+        pool->nextpool = next;
+        goto success;
+    }
+
+    /* There isn't a pool of the right size class immediately
+     * available:  use a free pool.
+     */
+    pool = allocate_pool();
+    if (pool == NULL) {
+        goto failed;
+    }
+
+    /* Frontlink to used pools. */
+    next = usedpools[size + size]; /* == prev */
+    pool->nextpool = next;
+    pool->prevpool = next;
+    next->nextpool = pool;
+    next->prevpool = pool;
+    pool->ref.count = 1;
+    if (pool->szidx == size) {
+        /* Luckily, this pool last contained blocks
+         * of the same size class, so its header
+         * and free list are already initialized.
+         */
+        bp = pool->freeblock;
+        assert(bp != NULL);
+        pool->freeblock = *(block **)bp;
+        goto success;
+    }
+    /*
+     * Initialize the pool header, set up the free list to
+     * contain just the second block, and return the first
+     * block.
+     */
+    pool->szidx = size;
+    size = INDEX2SIZE(size);
+    bp = (block *)pool + POOL_OVERHEAD;
+    pool->nextoffset = POOL_OVERHEAD + (size << 1);
+    pool->maxnextoffset = POOL_SIZE - size;
+    pool->freeblock = bp + size;
+    *(block **)(pool->freeblock) = NULL;
+    goto success;
 
 success:
     assert(bp != NULL);
@@ -1811,8 +2087,15 @@ pymalloc_free(void *ctx, void *p)
          * blocks of the same size class.
          */
         --pool->ref.count;
-        assert(pool->ref.count > 0);            /* else the pool is empty */
         size = pool->szidx;
+        if (UNLIKELY(nursery_pools[size] == pool)) {
+            /* The nursery pool isn't in any list. */
+            if (pool->ref.count == 0) {
+                nursery_reset(pool);
+            }
+            goto success;
+        }
+        assert(pool->ref.count > 0);            /* else the pool is empty */
         next = usedpools[size + size];
         prev = next->prevpool;
 
@@ -1834,6 +2117,10 @@ pymalloc_free(void *ctx, void *p)
         /* pool isn't empty:  leave it in usedpools */
         goto success;
     }
+    if (UNLIKELY(nursery_pools[pool->szidx] == pool)) {
+        nursery_reset(pool);
+        goto success;
+    }
     /* Pool is now empty:  unlink from usedpools, and
      * link to the front of freepools.  This ensures that
      * previously freed pools will be allocated later
@@ -1850,6 +2137,7 @@ pymalloc_free(void *ctx, void *p)
     ao = &arenas[pool->arenaindex];
     pool->nextpool = ao->freepools;
     ao->freepools = pool;
+    ++ao->ncachedpools;
     nf = ao->nfreepools;
     /* If this is the rightmost arena with this number of free pools,
      * nfp2lasta[nf] needs to change.  Caution:  if nf is 0, there
@@ -1868,6 +2156,12 @@ pymalloc_free(void *ctx, void *p)
     }
     ao->nfreepools = ++nf;
 
+    if (UNLIKELY(trim_threshold != 0) && nf != ao->ntotalpools &&
+        ao->ncachedpools >= trim_threshold) {
+        /* The arena stays allocated, but its free pools don't need memory. */
+        arena_trim(ao);
+    }
+
     /* All the rest is arena management.  We just freed
      * a pool, and there are 4 cases for arena mgmt:
      * 1. If all the pools are free, return the arena to
@@ -2727,6 +3021,16 @@ _PyObject_DebugMallocStats(FILE *out)
      * full pools.
      */
     size_t quantization = 0;
+    /* # of used pools which are less than a quarter full, and the # of
+     * available bytes in them.  These are the pools keeping arenas alive
+     * with only a few blocks.
+     */
+    size_t numsparsepools = 0;
+    size_t sparse_available_bytes = 0;
+    /* # of nursery pools */
+    uint numnurserypools = 0;
+    /* # of free pools whose memory was given back to the OS */
+    uint numtrimmedpools = 0;
     /* # of arenas actually allocated. */
     size_t narenas = 0;
     /* running total -- should equal narenas * ARENA_SIZE */
@@ -2766,10 +3070,22 @@ _PyObject_DebugMallocStats(FILE *out)
         for (j = 0; base < (uintptr_t) arenas[i].pool_address;
              ++j, base += POOL_SIZE) {
             poolp p = (poolp)base;
-            const uint sz = p->szidx;
+            uint sz;
             uint freeblocks;
+            int is_nursery;
 
-            if (p->ref.count == 0) {
+            if ((arenas[i].trimmed_pools >> j) & 1) {
+                /* don't touch its memory */
+                ++numtrimmedpools;
+                continue;
+            }
+            sz = p->szidx;
+            is_nursery = sz < numclasses && nursery_pools[sz] == p;
+
+            if (is_nursery) {
+                ++numnurserypools;
+            }
+            else if (p->ref.count == 0) {
                 /* currently unused */
 #ifdef Py_DEBUG
                 assert(pool_is_in_list(p, arenas[i].freepools));
@@ -2780,8 +3096,12 @@ _PyObject_DebugMallocStats(FILE *out)
             numblocks[sz] += p->ref.count;
             freeblocks = NUMBLOCKS(sz) - p->ref.count;
             numfreeblocks[sz] += freeblocks;
+            if (!is_nursery && p->ref.count < NURSERY_REUSE_MIN_BLOCKS(sz)) {
+                ++numsparsepools;
+                sparse_available_bytes += freeblocks * INDEX2SIZE(sz);
+            }
 #ifdef Py_DEBUG
-            if (freeblocks > 0)
+            if (freeblocks > 0 && !is_nursery)
                 assert(pool_is_in_list(p, usedpools[sz + sz]));
 #endif
         }
@@ -2841,6 +3161,19 @@ _PyObject_DebugMallocStats(FILE *out)
     total += printone(out, "# bytes lost to quantization", quantization);
     total += printone(out, "# bytes lost to arena alignment", arena_alignment);
     (void)printone(out, "Total", total);
+
+    fputc('\n', out);
+    (void)printone(out, "# sparse pools (< 1/4 full)", numsparsepools);
+    (void)printone(out, "# bytes in available blocks of sparse pools",
+                   sparse_available_bytes);
+    (void)printone(out, "# bytes in trimmed pools",
+                   (size_t)numtrimmedpools * POOL_SIZE);
+    (void)printone(out, "# pools trimmed total", npools_trimmed);
+    if (nursery_enabled) {
+        (void)printone(out, "# nursery pools", numnurserypools);
+        (void)printone(out, "# nursery pool resets", nursery_resets);
+        (void)printone(out, "# nursery pools retired", nursery_retired);
+    }
     return 1;
 }
 
@@ -2,6 +2,7 @@
 
 #include "Python.h"
 #include "structmember.h"
+#include "pycore_range.h"
 #include "pycore_tupleobject.h"
 
 PyObject* avoid_clang_bug_rangeobject() { return NULL; }
@@ -743,13 +744,7 @@ PyTypeObject PyRange_Type = {
    in the normal case, but possible for any numeric value.
 */
 
-typedef struct {
-        PyObject_HEAD
-        long    index;
-        long    start;
-        long    step;
-        long    len;
-} rangeiterobject;
+typedef _PyRangeIterObject rangeiterobject;
 
 /* static */ PyObject *
 rangeiter_next(rangeiterobject *r)
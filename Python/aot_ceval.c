@@ -175,12 +175,16 @@ static long dxp[256];
 #define OPCACHE_INC_FUNC_ENTRY 10
 #define OPCACHE_MIN_RUNS (100*OPCACHE_INC_FUNC_ENTRY)  /* create opcache when code executed this time */
 #define JIT_MIN_RUNS (OPCACHE_MIN_RUNS*2)
+#define JIT_HOTNESS_HINT_RUNS 10 /* num of calls before we JIT a function which got JIT compiled in a previous run */
 //#endif
+#define OPCACHE_POLY_INITIAL_ENTRIES 4 /* polymorphic LOAD_ATTR/LOAD_METHOD caches start with this many entries */
+#define OPCACHE_POLY_MAX_ENTRIES 16 /* and grow up to this many before the site switches to the megamorphic cache */
 #define OPCACHE_STATS 0  /* Enable stats */
 
 #define USE_LOAD_METHOD_CACHE 1
 #define USE_LOAD_ATTR_CACHE 1
 #define USE_STORE_ATTR_CACHE 1
+// USE_CALL_CACHE is defined in pycore_code.h because the opcache allocation depends on it
 
 #if OPCACHE_STATS
 static size_t opcache_code_objects = 0;
@@ -1804,6 +1808,218 @@ common_cached:
     return 0;
 }
 
+#if USE_CALL_CACHE
+// Calls 'func' via the call-site cache of a CALL_FUNCTION, CALL_FUNCTION_KW or CALL_METHOD.
+// Returns 0 if the cache guards passed and stores the result of the call (NULL on error) in 'res',
+// returns -1 on a cache miss. The references on the value stack are not consumed.
+int __attribute__((always_inline)) __attribute__((visibility("hidden")))
+callCache(PyThreadState *tstate, PyObject *func, PyObject **args, Py_ssize_t nargs, PyObject *kwnames, _PyOpcache *co_opcache, PyObject **res) {
+    _PyOpcache_Call *cc = &co_opcache->u.call;
+
+    if (unlikely(cc->nargs != nargs || tstate->use_tracing))
+        return -1;
+
+    if (cc->cache_type == CALL_CACHE_PY_FUNC) {
+        if (unlikely(Py_TYPE(func) != &PyFunction_Type || PyFunction_GET_CODE(func) != (PyObject*)cc->u.code || kwnames))
+            return -1;
+        *res = _PyFunction_Vectorcall(func, args, nargs | PY_VECTORCALL_ARGUMENTS_OFFSET, NULL);
+        return 0;
+    } else if (cc->cache_type == CALL_CACHE_CFUNC) {
+        if (unlikely(Py_TYPE(func) != &PyCFunction_Type || ((PyCFunctionObject*)func)->m_ml != cc->u.ml))
+            return -1;
+        // the PyMethodDef may have been freed and its address reused for a different method
+        if (unlikely(cc->u.ml->ml_flags != cc->ml_flags))
+            return -1;
+        // Like the LOAD_METHOD inline cache in the JIT we skip the recursion check, since we did one when
+        // entering this python frame.
+        PyObject *self = ((PyCFunctionObject*)func)->m_self;
+        void *meth = cc->u.ml->ml_meth;
+        switch (cc->ml_flags) {
+        case METH_NOARGS:
+            if (kwnames)
+                return -1;
+            *res = ((PyCFunction)meth)(self, NULL);
+            return 0;
+        case METH_O:
+            if (kwnames)
+                return -1;
+            *res = ((PyCFunction)meth)(self, args[0]);
+            return 0;
+        case METH_FASTCALL:
+            if (kwnames)
+                return -1;
+            *res = ((_PyCFunctionFast)meth)(self, args, nargs);
+            return 0;
+        case METH_FASTCALL | METH_KEYWORDS:
+            *res = ((_PyCFunctionFastWithKeywords)meth)(self, args, nargs, kwnames);
+            return 0;
+        }
+        return -1;
+    }
+    return -1;
+}
+
+int __attribute__((always_inline)) __attribute__((visibility("hidden")))
+setupCallCache(PyObject *func, Py_ssize_t nargs, PyObject *kwnames, _PyOpcache *co_opcache) {
+    _PyOpcache_Call *cc = &co_opcache->u.call;
+    PyTypeObject *tp = Py_TYPE(func);
+
+    if (co_opcache->num_failed >= 3)
+        return -1;
+
+    if (nargs > SHRT_MAX)
+        return -1;
+
+    if (tp == &PyFunction_Type) {
+        PyCodeObject *co = (PyCodeObject*)PyFunction_GET_CODE(func);
+        // only cache calls which don't need any argument parsing
+        if (kwnames || co->co_argcount != nargs || co->co_kwonlyargcount != 0)
+            return -1;
+        cc->cache_type = CALL_CACHE_PY_FUNC;
+        cc->u.code = co;
+    } else if (tp == &PyCFunction_Type) {
+        PyMethodDef *ml = ((PyCFunctionObject*)func)->m_ml;
+        int flags = ml->ml_flags;
+        if (flags == METH_NOARGS || flags == METH_O) {
+            if (kwnames || nargs != (flags == METH_O ? 1 : 0))
+                return -1;
+        } else if (flags == METH_FASTCALL) {
+            if (kwnames)
+                return -1;
+        } else if (flags != (METH_FASTCALL | METH_KEYWORDS)) {
+            return -1;
+        }
+        cc->cache_type = CALL_CACHE_CFUNC;
+        cc->u.ml = ml;
+        cc->ml_flags = flags;
+    } else {
+        return -1;
+    }
+    cc->nargs = (short)nargs;
+    co_opcache->optimized = 1;
+    return 0;
+}
+
+// Same as CALL_FUNCTION_CEVAL but first tries the call-site cache and fills it if the call is cacheable.
+static inline PyObject* _Py_HOT_FUNCTION
+call_function_cached(PyThreadState *tstate, PyObject ***pp_stack, Py_ssize_t oparg, PyObject *kwnames, _PyOpcache *co_opcache) {
+    PyObject **pfunc = *pp_stack - oparg - 1;
+    PyObject *func = *pfunc;
+    Py_ssize_t nargs = oparg - (kwnames == NULL ? 0 : PyTuple_GET_SIZE(kwnames));
+    PyObject *res;
+
+    if (co_opcache == NULL)
+        return CALL_FUNCTION_CEVAL(tstate, pp_stack, oparg, kwnames);
+
+    if (co_opcache->optimized) {
+        if (likely(callCache(tstate, func, pfunc + 1, nargs, kwnames, co_opcache, &res) == 0)) {
+            assert((res != NULL) ^ (_PyErr_Occurred(tstate) != NULL));
+            for (int i = oparg; i >= 0; i--) {
+                Py_DECREF(pfunc[i]);
+            }
+            *pp_stack = pfunc;
+            return res;
+        }
+        if (++co_opcache->num_failed > 15) {
+            // stop even trying to use the cache
+            // the cache setup code will also not fill it anymore because it checks num_failed
+            co_opcache->optimized = 0;
+        }
+    }
+
+    setupCallCache(func, nargs, kwnames, co_opcache);
+    return CALL_FUNCTION_CEVAL(tstate, pp_stack, oparg, kwnames);
+}
+#endif
+
+// Records the operand type of a COMPARE_OP or the iterator type of a FOR_ITER in the opcache.
+// If the site sees more than one type it gets marked as polymorphic (type == NULL) for good.
+static inline void
+profileTypeCache(PyTypeObject *type, _PyOpcache *co_opcache) {
+    if (!co_opcache->optimized) {
+        co_opcache->u.t.type = type;
+        co_opcache->optimized = 1;
+    } else if (co_opcache->u.t.type != type) {
+        co_opcache->u.t.type = NULL;
+    }
+}
+
+static PyObject* compare_longs(long a, long b, int op) {
+    Py_RETURN_RICHCOMPARE(a, b, op);
+}
+
+static PyObject* compare_doubles(double a, double b, int op) {
+    Py_RETURN_RICHCOMPARE(a, b, op);
+}
+
+// Handles COMPARE_OP sites which only saw int, float or str operands of the same type.
+// Returns 0 and stores the result (NULL on error) in 'res' if it did the comparison, else -1.
+int __attribute__((always_inline)) __attribute__((visibility("hidden")))
+compareOpCache(PyObject *left, PyObject *right, int oparg, _PyOpcache *co_opcache, PyObject **res) {
+    PyTypeObject *type = Py_TYPE(left);
+
+    // before 3.9 COMPARE_OP also handles 'is', 'in' and exception matching
+    if (oparg > Py_GE)
+        return -1;
+
+    profileTypeCache(Py_TYPE(right) == type ? type : NULL, co_opcache);
+    if (co_opcache->u.t.type != type)
+        return -1;
+
+    if (type == &PyLong_Type) {
+        // only handle ints with ob_size of -1, 0 or 1 like the JIT does
+        Py_ssize_t size_left = Py_SIZE(left), size_right = Py_SIZE(right);
+        if (size_left < -1 || size_left > 1 || size_right < -1 || size_right > 1)
+            return -1;
+        long a = size_left * (long)((PyLongObject*)left)->ob_digit[0];
+        long b = size_right * (long)((PyLongObject*)right)->ob_digit[0];
+        *res = compare_longs(a, b, oparg);
+        return 0;
+    } else if (type == &PyFloat_Type) {
+        *res = compare_doubles(PyFloat_AS_DOUBLE(left), PyFloat_AS_DOUBLE(right), oparg);
+        return 0;
+    } else if (type == &PyUnicode_Type) {
+        if (oparg == Py_EQ || oparg == Py_NE) {
+            int eq = _PyUnicode_EQ(left, right);
+            *res = (eq ^ (oparg == Py_NE)) ? Py_True : Py_False;
+            Py_INCREF(*res);
+        } else {
+            *res = PyUnicode_RichCompare(left, right, oparg);
+        }
+        return 0;
+    }
+    return -1;
+}
+
+// Same as calling tp_iternext but records the iterator type of the FOR_ITER
+// and iterates lists and ranges without the indirect call.
+static inline PyObject*
+forIterCache(PyObject *iter, _PyOpcache *co_opcache) {
+    PyTypeObject *type = Py_TYPE(iter);
+
+    profileTypeCache(type, co_opcache);
+
+    if (type == &PyListIter_Type) {
+        _PyListIterObject *it = (_PyListIterObject*)iter;
+        PyListObject *seq = it->it_seq;
+        // the exhausted case gets handled by listiter_next which also clears it_seq
+        if (seq != NULL && it->it_index < PyList_GET_SIZE(seq)) {
+            PyObject *item = PyList_GET_ITEM(seq, it->it_index);
+            ++it->it_index;
+            Py_INCREF(item);
+            return item;
+        }
+    } else if (type == &PyRangeIter_Type) {
+        _PyRangeIterObject *r = (_PyRangeIterObject*)iter;
+        if (r->index < r->len)
+            /* cast to unsigned to avoid possible signed overflow
+               in intermediate calculations. */
+            return PyLong_FromLong((long)(r->start + (unsigned long)(r->index++) * r->step));
+        return NULL;
+    }
+    return (*type->tp_iternext)(iter);
+}
+
 PyObject* slot_tp_getattr_hook_simple(PyObject *self, PyObject *name);
 PyObject* slot_tp_getattr_hook_simple_not_found(PyObject *self, PyObject *name);
 #ifdef PYSTON_LITE
@@ -1840,6 +2056,96 @@ int64_t _PyDict_GetItemOffsetSplit(PyDictObject *mp, PyObject *key, Py_ssize_t *
 PyObject* _PyDict_GetItemByOffset(PyDictObject *mp, PyObject *key, Py_ssize_t dk_size, int64_t offset);
 PyObject* _PyDict_GetItemByOffsetSplit(PyDictObject *mp, PyObject *key, Py_ssize_t dk_size, int64_t ix);
 
+#ifndef NO_DKVERSION
+int64_t _PyDict_GetItemKeysVersionOffset(PyDictObject *mp, PyObject *key, uint64_t *keys_ver);
+PyObject* _PyDict_GetItemByKeysVersion(PyDictObject *mp, uint64_t keys_ver, int64_t offset);
+
+// returns a borrowed reference or NULL if the cache missed
+static inline PyObject* loadGlobalKeysVersionCache(PyDictObject* globals, PyDictObject* builtins, _PyOpcache_LoadGlobal *lg) {
+    if (lg->cache_type == LG_GLOBAL_KEYS_VERSION)
+        return _PyDict_GetItemByKeysVersion(globals, lg->u.keys_version_cache.globals_keys_ver, lg->u.keys_version_cache.offset);
+
+    assert(lg->cache_type == LG_BUILTIN_KEYS_VERSION);
+    // make sure the name did not get added to the globals
+    if (_PyDict_GetDictKeyVersionFromKeys((PyObject*)globals->ma_keys) != lg->u.keys_version_cache.globals_keys_ver)
+        return NULL;
+    return _PyDict_GetItemByKeysVersion(builtins, lg->u.keys_version_cache.builtins_keys_ver, lg->u.keys_version_cache.offset);
+}
+
+int __attribute__((always_inline)) __attribute__((visibility("hidden")))
+setupLoadGlobalKeysVersionCache(PyDictObject* globals, PyDictObject* builtins, PyObject* name, int wasglobal, _PyOpcache_LoadGlobal *lg) {
+    // a split dict could share the keys object with a dict which contains a different set of names
+    if (_PyDict_HasSplitTable(globals))
+        return -1;
+
+    uint64_t globals_keys_ver = _PyDict_GetDictKeyVersionFromKeys((PyObject*)globals->ma_keys);
+    uint64_t builtins_keys_ver = 0;
+    int64_t offset;
+    if (wasglobal)
+        offset = _PyDict_GetItemKeysVersionOffset(globals, name, &globals_keys_ver);
+    else
+        offset = _PyDict_GetItemKeysVersionOffset(builtins, name, &builtins_keys_ver);
+    if (offset < 0)
+        return -1;
+
+    lg->cache_type = wasglobal ? LG_GLOBAL_KEYS_VERSION : LG_BUILTIN_KEYS_VERSION;
+    lg->u.keys_version_cache.globals_keys_ver = globals_keys_ver;
+    lg->u.keys_version_cache.builtins_keys_ver = builtins_keys_ver;
+    lg->u.keys_version_cache.offset = offset;
+    return 0;
+}
+#endif
+
+static int opcache_poly_max_entries = OPCACHE_POLY_MAX_ENTRIES;
+
+// Process-wide cache used by LOAD_ATTR/LOAD_METHOD sites which saw too many types for a polymorphic cache.
+// It's indexed by (tp_version_tag, name) like the type attribute cache in typeobject.c but stores
+// a complete cache entry so it also covers instance attributes (e.g. the split dict index).
+#define MEGAMORPHIC_CACHE_SIZE_EXP 12
+#define MEGAMORPHIC_CACHE_HASH(version, name, is_load_method) \
+        ((((unsigned int)(version) << 1 | (is_load_method)) ^ ((unsigned int)((uintptr_t)(name) >> 3))) & \
+         ((1 << MEGAMORPHIC_CACHE_SIZE_EXP) - 1))
+
+typedef struct {
+    PyObject* name; // owned reference so that the address can't get reused by a different string
+    char is_load_method;
+    _PyOpcache cache;
+} MegamorphicCacheEntry;
+static MegamorphicCacheEntry megamorphic_cache[1 << MEGAMORPHIC_CACHE_SIZE_EXP];
+
+// returns the (cleared) entry which setupLoadAttrCache should fill for this type and name
+static _PyOpcache* getMegamorphicCacheEntry(PyTypeObject* tp, PyObject* name, int is_load_method) {
+    MegamorphicCacheEntry* entry = &megamorphic_cache[MEGAMORPHIC_CACHE_HASH(tp->tp_version_tag, name, is_load_method)];
+    if (entry->name != name) {
+        Py_INCREF(name);
+        Py_XSETREF(entry->name, name);
+    }
+    entry->is_load_method = is_load_method;
+    memset(&entry->cache, 0, sizeof(entry->cache));
+    // the entry is shared between all sites and instances so we prefer the less specific
+    // cache types like LA_CACHE_OFFSET_CACHE (same as for the entries of polymorphic caches)
+    entry->cache.num_failed = 2;
+    return &entry->cache;
+}
+
+// Keeps the entries of a polymorphic cache sorted by the number of hits so that the most
+// common types get checked first. The JIT emits the entries in this order too.
+static void polymorphicCacheRecordHit(_PyOpcache_LoadAttr *la, int idx) {
+    _PyOpcache* caches = la->u.poly_cache.caches;
+    if (caches[idx].u.la.poly_hits == UINT16_MAX) {
+        // age all counters so that the order adapts when the mix of types changes
+        for (int i=0, num=la->u.poly_cache.num_used; i<num; ++i)
+            caches[i].u.la.poly_hits /= 2;
+    }
+    ++caches[idx].u.la.poly_hits;
+
+    if (idx > 0 && caches[idx].u.la.poly_hits > caches[idx-1].u.la.poly_hits) {
+        _PyOpcache tmp = caches[idx-1];
+        caches[idx-1] = caches[idx];
+        caches[idx] = tmp;
+    }
+}
+
 int __attribute__((visibility("hidden")))
 loadAttrCache(PyObject* owner, PyObject* name, _PyOpcache *co_opcache, PyObject** res, int *meth_found) {
     _PyOpcache_LoadAttr *la = &co_opcache->u.la;
@@ -1848,15 +2154,33 @@ loadAttrCache(PyObject* owner, PyObject* name, _PyOpcache *co_opcache, PyObject*
     if (!co_opcache->optimized)
         return -1;
 
+    if (la->cache_type == LA_CACHE_MEGAMORPHIC) {
+        PyTypeObject* tp = Py_TYPE(owner);
+        int is_load_method = meth_found != NULL;
+        MegamorphicCacheEntry* entry = &megamorphic_cache[MEGAMORPHIC_CACHE_HASH(tp->tp_version_tag, name, is_load_method)];
+        if (entry->name != name || entry->is_load_method != is_load_method)
+            return -1;
+        // the entry guards on the type version
+        if (loadAttrCache(owner, name, &entry->cache, res, meth_found) != 0)
+            return -1;
+        co_opcache->num_failed = 0;
+        return 0;
+    }
+
     if (la->cache_type == LA_CACHE_POLYMORPHIC) {
         // give up if we have not had a single cache hit after that many tries
         if (co_opcache->num_failed >= 15) {
             return -1;
         }
-        for (int i=0, num=la->u.poly_cache.num_used; i<num; ++i) {
-            _PyOpcache* caches = la->u.poly_cache.caches;
-            if (loadAttrCache(owner, name, &caches[i], res, meth_found) == 0) {
+        for (int i=0; i<la->u.poly_cache.num_used; ++i) {
+            if (loadAttrCache(owner, name, &la->u.poly_cache.caches[i], res, meth_found) == 0) {
                 co_opcache->num_failed = 0;
+                // A getter may have re-entered this site and grown (realloc) the entries
+                // or switched the site to megamorphic (free), so revalidate before
+                // touching the entries again. The nested call already marked the
+                // entry as working so that the JIT will emit it.
+                if (la->cache_type == LA_CACHE_POLYMORPHIC && i < la->u.poly_cache.num_used)
+                    polymorphicCacheRecordHit(la, i);
                 return 0;
             }
         }
@@ -1959,20 +2283,28 @@ loadAttrCache(PyObject* owner, PyObject* name, _PyOpcache *co_opcache, PyObject*
         *res = _PyDict_GetItemFromSplitDict(*dictptr, la->u.split_dict_cache.splitdict_index);
 
         // can be null, call into tp_getattro specific handler
-        if (*res == NULL)
+        if (*res == NULL) {
+            // user code may free this entry (see below)
+            co_opcache->num_failed = 0;
             *res = loadAttrCacheAttrNotFound(owner, name);
-        else
-            Py_INCREF(*res);
+            goto hit;
+        }
+        Py_INCREF(*res);
     } else if (la->cache_type == LA_CACHE_DATA_DESCR) {
         PyObject* descr = la->u.descr_cache.descr;
         if (unlikely(!TYPE_VERSION_CHECK(Py_TYPE(descr), la->u.descr_cache.descr_type_ver)))
             return -1;
 
+        // Record the hit before calling into user code: if this is an entry of a
+        // polymorphic cache the getter may re-enter the site and reallocate or free
+        // the array the entry lives in.
+        co_opcache->num_failed = 0;
         *res = descr->ob_type->tp_descr_get(descr, owner, (PyObject *)owner->ob_type);
 
         // can be null, call into tp_getattro specific handler
         if (*res == NULL)
             *res = loadAttrCacheAttrNotFound(owner, name);
+        goto hit;
     } else {
         fprintf(stderr, "bad cache type %d\n", la->cache_type);
         abort();
@@ -1980,6 +2312,7 @@ loadAttrCache(PyObject* owner, PyObject* name, _PyOpcache *co_opcache, PyObject*
 
     co_opcache->num_failed = 0;
 
+hit:
 #if OPCACHE_STATS
     if (meth_found)
         loadmethod_hits++;
@@ -1990,7 +2323,9 @@ loadAttrCache(PyObject* owner, PyObject* name, _PyOpcache *co_opcache, PyObject*
 }
 
 static int createPolymorphicCache(_PyOpcache* co_opcache, _PyOpcache_LoadAttr *la) {
-    int num_entries = 5;
+    int num_entries = Py_MIN(OPCACHE_POLY_INITIAL_ENTRIES, opcache_poly_max_entries);
+    if (num_entries < 2)
+        return -1;
     _PyOpcache* caches = PyMem_Calloc(num_entries, sizeof(_PyOpcache));
     if (!caches)
         return -1;
@@ -2002,6 +2337,7 @@ static int createPolymorphicCache(_PyOpcache* co_opcache, _PyOpcache_LoadAttr *l
     }
     // copy over the old entry as first entry of the polymorphic cache
     memcpy(&caches[0], co_opcache, sizeof(_PyOpcache));
+    caches[0].u.la.poly_hits = 0;
     la->cache_type = LA_CACHE_POLYMORPHIC;
     la->u.poly_cache.caches = caches;
     la->u.poly_cache.num_entries = num_entries;
@@ -2009,6 +2345,25 @@ static int createPolymorphicCache(_PyOpcache* co_opcache, _PyOpcache_LoadAttr *l
     return 0;
 }
 
+// Doubles the number of entries of a polymorphic cache up to opcache_poly_max_entries.
+// The JIT only embeds the values of the entries in the generated code so it's fine to move them.
+static int growPolymorphicCache(_PyOpcache_LoadAttr *la) {
+    int num_entries = la->u.poly_cache.num_entries;
+    if (num_entries >= opcache_poly_max_entries)
+        return -1;
+    int new_num_entries = Py_MIN(num_entries * 2, opcache_poly_max_entries);
+    _PyOpcache* caches = PyMem_Realloc(la->u.poly_cache.caches, new_num_entries * sizeof(_PyOpcache));
+    if (!caches)
+        return -1;
+    memset(&caches[num_entries], 0, (new_num_entries - num_entries) * sizeof(_PyOpcache));
+    for (int i = num_entries; i<new_num_entries; ++i) {
+        caches[i].num_failed = 2;
+    }
+    la->u.poly_cache.caches = caches;
+    la->u.poly_cache.num_entries = new_num_entries;
+    return 0;
+}
+
 int __attribute__((visibility("hidden")))
 setupLoadAttrCache(PyObject* obj, PyObject* name, _PyOpcache *co_opcache, PyObject* res, int is_load_method, int inside_interpreter) {
     _PyOpcache_LoadAttr *la = &co_opcache->u.la;
@@ -2021,7 +2376,10 @@ setupLoadAttrCache(PyObject* obj, PyObject* name, _PyOpcache *co_opcache, PyObje
     if (!res)
         return -1;
 
-    if (co_opcache->num_failed >= 5)
+    int megamorphic = co_opcache->optimized && la->cache_type == LA_CACHE_MEGAMORPHIC;
+
+    // megamorphic sites always fill the process-wide cache
+    if (co_opcache->num_failed >= 5 && !megamorphic)
         return -1;
 
     if (!PyType_HasFeature(tp, Py_TPFLAGS_VALID_VERSION_TAG))
@@ -2057,7 +2415,7 @@ setupLoadAttrCache(PyObject* obj, PyObject* name, _PyOpcache *co_opcache, PyObje
     uint8_t tp_hash = (uint8_t)((uint64_t)(tp)>>4);
 
     // support for polymorphic caches
-    if (co_opcache->optimized &&
+    if (!megamorphic && co_opcache->optimized &&
         /* enter if we are already polymorphic */
         (la->cache_type == LA_CACHE_POLYMORPHIC ||
         /* or if the hash of the type is different we create a polymorphic IC */
@@ -2065,20 +2423,44 @@ setupLoadAttrCache(PyObject* obj, PyObject* name, _PyOpcache *co_opcache, PyObje
         int entry_idx = 0;
         // we already have a polymorphic IC
         if (la->cache_type == LA_CACHE_POLYMORPHIC) {
-            // check if the last slot should be overwritten:
-            // - this can happen when we create a new slow but filling it failed because
-            //   it was not possible to cache the attribute.
+            // check if an existing slot should be overwritten:
+            // - it's for the same type (e.g. the instance dict version changed or the type got modified)
             // - the type hash is the same
-            _PyOpcache *co_opcache_prev_entry = &la->u.poly_cache.caches[la->u.poly_cache.num_used-1];
-            if (!co_opcache_prev_entry->optimized || co_opcache_prev_entry->u.la.type_hash == tp_hash) {
-                entry_idx = la->u.poly_cache.num_used - 1;
-            } else {
+            // - we created a new slot but filling it failed because it was not possible to cache the attribute.
+            entry_idx = -1;
+            int unused_idx = -1;
+            for (int i=0, num=la->u.poly_cache.num_used; i<num; ++i) {
+                _PyOpcache *co_opcache_entry = &la->u.poly_cache.caches[i];
+                _PyOpcache_LoadAttr *la_entry = &co_opcache_entry->u.la;
+                if (!co_opcache_entry->optimized) {
+                    if (unused_idx == -1)
+                        unused_idx = i;
+                    continue;
+                }
+                int same_type = la_entry->cache_type == LA_CACHE_BUILTIN ? la_entry->type == tp : la_entry->type_ver == tp->tp_version_tag;
+                if (same_type) {
+                    entry_idx = i;
+                    break;
+                }
+                if (entry_idx == -1 && la_entry->type_hash == tp_hash)
+                    entry_idx = i;
+            }
+            if (entry_idx == -1)
+                entry_idx = unused_idx;
+            if (entry_idx == -1) {
                 // add a new entry
-                if (la->u.poly_cache.num_used >= la->u.poly_cache.num_entries) {
-                    co_opcache->num_failed = 10; // don't use the cache anymore we used all slots
-                    return -1;
+                if (la->u.poly_cache.num_used >= la->u.poly_cache.num_entries &&
+                    growPolymorphicCache(la) == -1) {
+                    // we used all slots: switch over to the process-wide cache
+                    PyMem_Free(la->u.poly_cache.caches);
+                    la->cache_type = LA_CACHE_MEGAMORPHIC;
+                    co_opcache->num_failed = 0;
+                    megamorphic = 1;
+                } else {
+                    entry_idx = la->u.poly_cache.num_used++;
+                    // the miss came from a type we have not seen before, that's no reason to give up on the site
+                    co_opcache->num_failed = 0;
                 }
-                entry_idx = la->u.poly_cache.num_used++;
             }
         } else {
             // don't create new poly caches from the JIT helper funcs
@@ -2088,8 +2470,16 @@ setupLoadAttrCache(PyObject* obj, PyObject* name, _PyOpcache *co_opcache, PyObje
             if (createPolymorphicCache(co_opcache, la) == -1)
                 return -1;
             entry_idx = la->u.poly_cache.num_used++;
+            co_opcache->num_failed = 0;
+        }
+        if (!megamorphic) {
+            co_opcache = &la->u.poly_cache.caches[entry_idx];
+            la = &co_opcache->u.la;
+            la->poly_hits = 0;
         }
-        co_opcache = &la->u.poly_cache.caches[entry_idx];
+    }
+    if (megamorphic) {
+        co_opcache = getMegamorphicCacheEntry(tp, name, is_load_method);
         la = &co_opcache->u.la;
     }
 
@@ -2317,6 +2707,106 @@ static void update_opcode_profile(PyObject* func_entry, const char* opcode) {
 }
 #endif
 
+// AOT type profile:
+// Counts how often the interpreter executes each (opcode, left type, right type)
+// combination of the binary operations which have AOT specializations.
+// Gets enabled by setting AOT_TYPE_PROFILE=<file>, the counts get appended to that
+// file at exit and 'aot_gen.py --profile <file>' uses them to generate additional traces.
+// The JIT gets disabled while profiling because only the interpreter records the types.
+#define TYPE_PROFILE_SIZE_EXP 12
+#define TYPE_PROFILE_SIZE (1 << TYPE_PROFILE_SIZE_EXP)
+typedef struct {
+    long count;
+    int opcode;
+    PyTypeObject* left; // owned
+    PyTypeObject* right; // owned
+} TypeProfileEntry;
+static TypeProfileEntry* type_profile;
+static char* type_profile_filename;
+static long type_profile_dropped;
+
+static const char* const type_profile_opnames[256] = {
+    [BINARY_MULTIPLY] = "BINARY_MULTIPLY",
+    [BINARY_TRUE_DIVIDE] = "BINARY_TRUE_DIVIDE",
+    [BINARY_FLOOR_DIVIDE] = "BINARY_FLOOR_DIVIDE",
+    [BINARY_MODULO] = "BINARY_MODULO",
+    [BINARY_ADD] = "BINARY_ADD",
+    [BINARY_SUBTRACT] = "BINARY_SUBTRACT",
+    [BINARY_SUBSCR] = "BINARY_SUBSCR",
+    [INPLACE_MULTIPLY] = "INPLACE_MULTIPLY",
+    [INPLACE_TRUE_DIVIDE] = "INPLACE_TRUE_DIVIDE",
+    [INPLACE_FLOOR_DIVIDE] = "INPLACE_FLOOR_DIVIDE",
+    [INPLACE_MODULO] = "INPLACE_MODULO",
+    [INPLACE_ADD] = "INPLACE_ADD",
+    [INPLACE_SUBTRACT] = "INPLACE_SUBTRACT",
+};
+
+static void typeProfileRecord(int opcode, PyObject* left, PyObject* right) {
+    if (!type_profile) {
+        type_profile = PyMem_RawCalloc(TYPE_PROFILE_SIZE, sizeof(TypeProfileEntry));
+        if (!type_profile)
+            return;
+    }
+    PyTypeObject* left_type = Py_TYPE(left);
+    PyTypeObject* right_type = Py_TYPE(right);
+    // only builtin types can get specialized on and the profile identifies them by tp_name,
+    // which would otherwise not tell a builtin apart from a user class with the same name
+    if ((left_type->tp_flags | right_type->tp_flags) & Py_TPFLAGS_HEAPTYPE)
+        return;
+    size_t hash = ((size_t)left_type >> 4) ^ ((size_t)right_type >> 7) ^ ((size_t)opcode * 0x9E3779B1u);
+    for (int i = 0; i < TYPE_PROFILE_SIZE; ++i) {
+        TypeProfileEntry* entry = &type_profile[(hash + i) & (TYPE_PROFILE_SIZE - 1)];
+        if (entry->opcode == opcode && entry->left == left_type && entry->right == right_type) {
+            ++entry->count;
+            return;
+        }
+        if (entry->count == 0) {
+            // keep the types alive so that their names are still valid when we write the profile
+            Py_INCREF(left_type);
+            Py_INCREF(right_type);
+            entry->opcode = opcode;
+            entry->left = left_type;
+            entry->right = right_type;
+            entry->count = 1;
+            return;
+        }
+    }
+    ++type_profile_dropped;
+}
+
+static int typeProfileCompare(const void* a, const void* b) {
+    long count_a = ((const TypeProfileEntry*)a)->count;
+    long count_b = ((const TypeProfileEntry*)b)->count;
+    return (count_a < count_b) - (count_a > count_b);
+}
+
+static void typeProfileWrite() {
+    if (!type_profile)
+        return;
+
+    // append so that the profiles of multiple processes and runs get combined
+    FILE* f = fopen(type_profile_filename, "a");
+    if (!f) {
+        fprintf(stderr, "could not open AOT type profile file '%s'\n", type_profile_filename);
+        return;
+    }
+    qsort(type_profile, TYPE_PROFILE_SIZE, sizeof(TypeProfileEntry), typeProfileCompare);
+    for (int i = 0; i < TYPE_PROFILE_SIZE && type_profile[i].count; ++i) {
+        TypeProfileEntry* entry = &type_profile[i];
+        fprintf(f, "%ld %s %s %s\n", entry->count, type_profile_opnames[entry->opcode],
+                entry->left->tp_name, entry->right->tp_name);
+    }
+    if (type_profile_dropped)
+        fprintf(f, "# dropped %ld samples because the profile table was full\n", type_profile_dropped);
+    fclose(f);
+
+    // the entries are not in hash order anymore, stop recording
+    PyMem_RawFree(type_profile);
+    type_profile = NULL;
+    free(type_profile_filename);
+    type_profile_filename = NULL;
+}
+
 typedef struct {
     unsigned long ret_val;
     PyObject** stack_pointer;
@@ -2333,17 +2823,78 @@ typedef JitRetVal (*JitFunc)(PyFrameObject* frame, PyThreadState * const tstate,
 #ifdef PYSTON_LITE
 JitFunc jit_func_lite(PyCodeObject* co, PyThreadState* tstate);
 #define jit_func jit_func_lite
+JitFunc jit_func_release_gil_lite(PyCodeObject* co, PyThreadState* tstate);
+#define jit_func_release_gil jit_func_release_gil_lite
 void jit_start_lite();
 #define jit_start jit_start_lite
 void jit_finish_lite();
 #define jit_finish jit_finish_lite
+int jit_stats_are_enabled_lite();
+#define jit_stats_are_enabled jit_stats_are_enabled_lite
+int jit_hotness_is_hot_lite(PyCodeObject* co);
+#define jit_hotness_is_hot jit_hotness_is_hot_lite
+void jit_free_code_lite(void* code);
+#define jit_free_code jit_free_code_lite
+void* jit_retire_code_lite(void* retired, void* code);
+#define jit_retire_code jit_retire_code_lite
+void jit_free_retired_code_lite(void* retired);
+#define jit_free_retired_code jit_free_retired_code_lite
+int jit_mem_usage_percent_lite();
+#define jit_mem_usage_percent jit_mem_usage_percent_lite
+void jit_count_deopt_lite(void* code);
+#define jit_count_deopt jit_count_deopt_lite
+PyObject* jit_get_stats_lite();
+#define jit_get_stats jit_get_stats_lite
+void jit_reset_stats_lite();
+#define jit_reset_stats jit_reset_stats_lite
+PyObject* jit_get_code_stats_lite(void* code, int reset);
+#define jit_get_code_stats jit_get_code_stats_lite
 #else
 JitFunc jit_func(PyCodeObject* co, PyThreadState* tstate);
+JitFunc jit_func_release_gil(PyCodeObject* co, PyThreadState* tstate);
 void jit_start();
 void jit_finish();
+int jit_stats_are_enabled();
+int jit_hotness_is_hot(PyCodeObject* co);
+void jit_free_code(void* code);
+void* jit_retire_code(void* retired, void* code);
+void jit_free_retired_code(void* retired);
+int jit_mem_usage_percent();
+void jit_count_deopt(void* code);
+PyObject* jit_get_stats();
+void jit_reset_stats();
+PyObject* jit_get_code_stats(void* code, int reset);
 #endif
 static long opcache_min_runs = OPCACHE_MIN_RUNS;
 static long jit_min_runs = JIT_MIN_RUNS;
+static int jit_adaptive_threshold = 1;
+
+// Returns how hot 'co' has to get before we JIT compile it.
+// The counter this gets compared against (oc_opcache_flag) gets increased by
+// OPCACHE_INC_FUNC_ENTRY on every call and by one on every loop back-edge
+// (HANDLE_JUMP_BACKWARD_OSR), so it approximates the time spent in the function.
+// Large functions cost more to compile and take up more of the JIT memory
+// which is why they need to be hotter.
+// Once JIT_MAX_MEM is getting used up we raise the threshold for all functions
+// so that the remaining space goes to the hottest code.
+// Never returns less than jit_min_runs which lets the callers keep the cheap check
+// against jit_min_runs in front of it.
+static long jit_threshold(PyCodeObject* co) {
+    if (!jit_adaptive_threshold)
+        return jit_min_runs;
+
+    long num_instrs = PyBytes_GET_SIZE(co->co_code) / sizeof(_Py_CODEUNIT);
+    // +25% for every 128 instructions
+    long threshold = jit_min_runs + jit_min_runs * (num_instrs / 128) / 4;
+
+    int mem_usage = jit_mem_usage_percent();
+    if (mem_usage >= 50) {
+        // doubles for every 10% above 50% usage
+        int shift = (mem_usage - 50) / 10 + 1;
+        threshold <<= shift;
+    }
+    return threshold;
+}
 
 #define JIT_FUNC_FAILED ((JitFunc)0x1)
 
@@ -2397,6 +2948,161 @@ static inline void setJitCode(PyCodeObject* code, void* jit_code) {
 }
 #endif
 
+// Called by the JIT when the inline caches of a function used up their miss budget.
+// We throw away the machine code so that the next call of the function will compile it again
+// using the information the opcache collected in the meantime.
+// The calling frame (and maybe others) is still executing the old machine code so it only gets
+// freed by jit_frame_leave() once no frame of this code object is inside machine code anymore.
+void jit_ic_budget_exhausted(PyFrameObject* f) {
+    PyCodeObject* co = f->f_code;
+    void* code = getJitCode(co);
+    if (code == NULL || code == JIT_FUNC_FAILED)
+        return;
+    OpCache* opcache = _PyCode_GetOpcache(co);
+    ++opcache->oc_jit_num_recompiles;
+    opcache->oc_jit_code_retired = jit_retire_code(opcache->oc_jit_code_retired, code);
+    setJitCode(co, NULL);
+}
+
+// Has to get called when a frame stops executing the machine code of its code object
+// (return, yield, exception or deopt). Frees replaced machine code once it can't be in use anymore.
+static inline void jit_frame_leave(OpCache* opcache) {
+    if (--opcache->oc_jit_num_active == 0 && unlikely(opcache->oc_jit_code_retired != NULL)) {
+        jit_free_retired_code(opcache->oc_jit_code_retired);
+        opcache->oc_jit_code_retired = NULL;
+    }
+}
+
+// JIT_ASYNC=1 moves JIT compilation from the thread which made the function hot to a dedicated
+// compiler thread. The hot code object gets appended to the queue and the interpreter continues
+// executing it until the machine code gets published with setJitCode().
+// The compiler thread holds the GIL, which protects all the queue state below, except while
+// jit_func_release_gil() emits the machine code from its snapshot of the opcache.
+static int jit_async = 0;
+static PyCodeObject** jit_queue = NULL;
+static int jit_queue_head = 0, jit_queue_len = 0, jit_queue_capacity = 0;
+static PyCodeObject* jit_queue_in_flight = NULL; // popped from the queue and currently getting compiled
+static PyThread_type_lock jit_queue_wakeup = NULL;
+static int jit_queue_waiting = 0; // compiler thread is blocked on jit_queue_wakeup
+static int jit_queue_shutdown = 0;
+static pid_t jit_queue_pid = 0; // process which started the compiler thread (it's gone after a fork)
+static PyInterpreterState* jit_queue_interp = NULL;
+static long jit_queue_num_compiled = 0, jit_queue_num_skipped = 0;
+
+static void jit_compile_queued(PyCodeObject* co) {
+    OpCache* opcache = _PyCode_GetOpcache(co);
+    // skip code objects which are only referenced by the queue or got compiled in the meantime
+    if (Py_REFCNT(co) == 1 || getJitCode(co) != NULL) {
+        ++jit_queue_num_skipped;
+        return;
+    }
+    // JIT assumes opcache is always on
+    if (opcache->oc_opcache_map == NULL && INIT_OPCACHE(co, opcache) < 0) {
+        PyErr_Clear();
+        setJitCode(co, JIT_FUNC_FAILED);
+        return;
+    }
+    void* code = jit_func_release_gil(co, PyThreadState_GET());
+    // never try again to JIT compile this python function if it failed
+    setJitCode(co, code ? code : JIT_FUNC_FAILED);
+    ++jit_queue_num_compiled;
+}
+
+static void jit_compiler_thread(void* arg) {
+    PyThreadState* tstate = PyThreadState_New(jit_queue_interp);
+    if (tstate == NULL)
+        return;
+    PyEval_AcquireThread(tstate);
+    while (!jit_queue_shutdown) {
+        if (jit_queue_head == jit_queue_len) {
+            jit_queue_head = jit_queue_len = 0;
+            jit_queue_waiting = 1;
+            Py_BEGIN_ALLOW_THREADS
+            PyThread_acquire_lock(jit_queue_wakeup, WAIT_LOCK);
+            Py_END_ALLOW_THREADS
+            continue;
+        }
+        PyCodeObject* co = jit_queue_in_flight = jit_queue[jit_queue_head++];
+        jit_compile_queued(co);
+        jit_queue_in_flight = NULL;
+        _PyCode_GetOpcache(co)->oc_jit_queued = 0;
+        Py_DECREF(co);
+
+        // give the other threads the chance to run between two compilations
+        Py_BEGIN_ALLOW_THREADS
+        Py_END_ALLOW_THREADS
+    }
+    PyThreadState_Clear(tstate);
+    PyThreadState_DeleteCurrent();
+}
+
+// returns 0 if the compiler thread is running
+static int jit_queue_start_thread(PyThreadState* tstate) {
+    if (jit_queue_pid == getpid())
+        return 0;
+
+    // first call or we are in the child after a fork, in both cases there is no compiler thread
+    for (int i=jit_queue_head; i<jit_queue_len; ++i) {
+        _PyCode_GetOpcache(jit_queue[i])->oc_jit_queued = 0;
+        Py_DECREF(jit_queue[i]);
+    }
+    // the parent's compiler thread may have been in the middle of compiling a code object
+    // when we forked, nobody is going to finish it in this process
+    if (jit_queue_in_flight) {
+        _PyCode_GetOpcache(jit_queue_in_flight)->oc_jit_queued = 0;
+        Py_DECREF(jit_queue_in_flight);
+        jit_queue_in_flight = NULL;
+    }
+    jit_queue_head = jit_queue_len = 0;
+    jit_queue_waiting = 0;
+    jit_queue_wakeup = PyThread_allocate_lock(); // leaks the lock of the parent on fork but it's tiny
+    if (jit_queue_wakeup == NULL)
+        return -1;
+    PyThread_acquire_lock(jit_queue_wakeup, WAIT_LOCK);
+    jit_queue_interp = tstate->interp;
+    if (PyThread_start_new_thread(jit_compiler_thread, NULL) == PYTHREAD_INVALID_THREAD_ID)
+        return -1;
+    jit_queue_pid = getpid();
+    return 0;
+}
+
+// Appends 'co' to the compile queue.
+// Returns -1 if the asynchronous compilation is not available and the caller should compile it itself.
+static int jit_queue_add(PyCodeObject* co, PyThreadState* tstate) {
+    OpCache* opcache = _PyCode_GetOpcache(co);
+    if (opcache->oc_jit_queued)
+        return 0;
+    if (jit_queue_shutdown || _Py_IsFinalizing() || jit_queue_start_thread(tstate) < 0)
+        return -1;
+
+    if (jit_queue_len == jit_queue_capacity) {
+        int new_capacity = jit_queue_capacity ? jit_queue_capacity * 2 : 64;
+        PyCodeObject** new_queue = PyMem_RawRealloc(jit_queue, new_capacity * sizeof(PyCodeObject*));
+        if (new_queue == NULL)
+            return -1;
+        jit_queue = new_queue;
+        jit_queue_capacity = new_capacity;
+    }
+    Py_INCREF(co);
+    jit_queue[jit_queue_len++] = co;
+    opcache->oc_jit_queued = 1;
+
+    if (jit_queue_waiting) {
+        jit_queue_waiting = 0;
+        PyThread_release_lock(jit_queue_wakeup);
+    }
+    return 0;
+}
+
+// Called at exit: the compiler thread stays blocked like a daemon thread
+// and the code objects left in the queue are leaked because the interpreter is already gone.
+static void jit_queue_finish() {
+    jit_queue_shutdown = 1;
+    if (jit_async && jit_stats_are_enabled())
+        fprintf(stderr, "jit: %ld functions compiled in the background, %ld skipped\n",
+                jit_queue_num_compiled, jit_queue_num_skipped);
+}
+
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
 static PyObject* _Py_HOT_FUNCTION
 _PyEval_EvalFrame_AOT_JIT(PyFrameObject *f, PyThreadState * const tstate, PyObject** stack_pointer, JitFunc jit_code);
@@ -2816,7 +3522,7 @@ _PyEval_EvalFrame_AOT_Interpreter(PyFrameObject *f, int throwflag, PyThreadState
     /* macros for opcode cache */
 #define OPCACHE_FETCH() \
     do { \
-        unsigned char co_opt_offset = \
+        _PyOpcacheIdx co_opt_offset = \
             co->co_opcache_map[next_instr - first_instr]; \
         assert(co_opt_offset <= co->co_opcache_size); \
         co_opcache = &co->co_opcache[co_opt_offset - 1]; \
@@ -2827,7 +3533,7 @@ _PyEval_EvalFrame_AOT_Interpreter(PyFrameObject *f, int throwflag, PyThreadState
     do { \
         co_opcache = NULL; \
         if (opcache->oc_opcache != NULL) { \
-            unsigned char co_opt_offset = \
+            _PyOpcacheIdx co_opt_offset = \
                 opcache->oc_opcache_map[next_instr - first_instr]; \
             if (co_opt_offset > 0) { \
                 assert(co_opt_offset <= opcache->oc_opcache_size); \
@@ -2870,7 +3576,7 @@ _PyEval_EvalFrame_AOT_Interpreter(PyFrameObject *f, int throwflag, PyThreadState
                 return NULL; \
             } \
             opcache_code_objects_extra_mem += \
-                PyBytes_Size(co->co_code) / sizeof(_Py_CODEUNIT) + \
+                PyBytes_Size(co->co_code) / sizeof(_Py_CODEUNIT) * sizeof(_PyOpcacheIdx) + \
                 sizeof(_PyOpcache) * co->co_opcache_size; \
             opcache_code_objects++; \
         } \
@@ -2894,8 +3600,15 @@ _PyEval_EvalFrame_AOT_Interpreter(PyFrameObject *f, int throwflag, PyThreadState
 
 #endif
 
+#define TYPE_PROFILE_RECORD(left, right) \
+    do { \
+        if (unlikely(type_profile_filename != NULL)) \
+            typeProfileRecord(opcode, left, right); \
+    } while (0)
+
 #define BINARY_OP_OPCACHE_PROF() \
     do { \
+        TYPE_PROFILE_RECORD(left, right); \
         if (Py_TYPE(left) == Py_TYPE(right)) { \
             _PyOpcache *co_opcache; \
             OPCACHE_CHECK(); \
@@ -2919,21 +3632,25 @@ _PyEval_EvalFrame_AOT_Interpreter(PyFrameObject *f, int throwflag, PyThreadState
         if (opcache->oc_opcache_flag > jit_min_runs && can_use_jit \
             && !_Py_TracingPossible(ceval)) { /* don't OSR if tracing is enabled because we seem to skip a line */ \
             void* code = getJitCode(co); \
-            if (code == NULL) { \
+            if (code == NULL && opcache->oc_opcache_flag > jit_threshold(co)) { \
+                if (jit_async && jit_queue_add(co, tstate) == 0) \
+                    break; /* enter the machine code on a later back-edge once it got compiled */ \
                 code = jit_func(co, tstate);  \
-                if (code) {  \
-                    setJitCode(co, code); \
-                    /* JUMPTO() did not update f->f_lasti  \
-                    (it still points to the JUMP_ABSOLUTE - not the destination of the jump)  \
-                     update f->f_lasti manually like DISPATCH() would do because  \
-                     we can only enter the machine code at jump targets. */ \
-                    f->f_lasti = INSTR_OFFSET() - INST_IDX_TO_LASTI_FACTOR; /* -INST_IDX_TO_LASTI_FACTOR because our JIT entry is always adding a instruction */ \
-                    return EXECUTE_COMPILED_FUNC(); \
-                } else { \
+                if (code == NULL) {  \
                     /* never try again to JIT compile this python function */ \
                     setJitCode(co, JIT_FUNC_FAILED); \
                     can_use_jit = 0; \
+                    break; \
                 } \
+                setJitCode(co, code); \
+            } \
+            if (code != NULL && code != JIT_FUNC_FAILED) { \
+                /* JUMPTO() did not update f->f_lasti  \
+                (it still points to the JUMP_ABSOLUTE - not the destination of the jump)  \
+                 update f->f_lasti manually like DISPATCH() would do because  \
+                 we can only enter the machine code at jump targets. */ \
+                f->f_lasti = INSTR_OFFSET() - INST_IDX_TO_LASTI_FACTOR; /* -INST_IDX_TO_LASTI_FACTOR because our JIT entry is always adding a instruction */ \
+                return EXECUTE_COMPILED_FUNC(); \
             } \
         } \
     } while (0)
@@ -2949,7 +3666,8 @@ _PyEval_EvalFrame_AOT_Interpreter(PyFrameObject *f, int throwflag, PyThreadState
     if (can_use_jit && opcache->oc_opcache_flag >= jit_min_runs /* jit after that many calls or gen yields */) {
         void* code = getJitCode(co);
 
-        if (code == NULL) {
+        if (code == NULL && opcache->oc_opcache_flag >= jit_threshold(co)
+            && !(jit_async && jit_queue_add(co, tstate) == 0)) {
             // JIT assumes opcache is always on
             if (opcache->oc_opcache_map == NULL) {
                 INIT_OPCACHE(co, opcache);
@@ -3013,6 +3731,18 @@ _PyEval_EvalFrame_AOT_Interpreter(PyFrameObject *f, int throwflag, PyThreadState
         next_instr += f->f_lasti + 1;
 #endif
     } else { // function entry
+        if (unlikely(opcache->oc_opcache_flag == 0) && can_use_jit && jit_hotness_is_hot(co)) {
+            // this function got hot enough to get JIT compiled in a previous run (JIT_HOTNESS_FILE):
+            // create the opcache immediately and JIT compile after a few more calls
+            // which gives the opcache the chance to get populated.
+            // Start relative to jit_threshold() and not jit_min_runs because else large
+            // functions would still need most of their warmup calls with the adaptive threshold.
+            long hint_flag = jit_threshold(co) - JIT_HOTNESS_HINT_RUNS*OPCACHE_INC_FUNC_ENTRY;
+            opcache->oc_opcache_flag = hint_flag > opcache_min_runs ? hint_flag : opcache_min_runs;
+            if (opcache->oc_opcache_map == NULL && INIT_OPCACHE(co, opcache) < 0) {
+                return NULL;
+            }
+        }
         opcache->oc_opcache_flag += OPCACHE_INC_FUNC_ENTRY;
         OPCACHE_INIT_IF_HIT_THRESHOLD();
     }
@@ -3407,6 +4137,7 @@ main_loop:
         case TARGET(BINARY_TRUE_DIVIDE): {
             PyObject *divisor = POP();
             PyObject *dividend = TOP();
+            TYPE_PROFILE_RECORD(dividend, divisor);
             PyObject *quotient = PyNumber_TrueDivide(dividend, divisor);
             Py_DECREF(dividend);
             Py_DECREF(divisor);
@@ -3419,6 +4150,7 @@ main_loop:
         case TARGET(BINARY_FLOOR_DIVIDE): {
             PyObject *divisor = POP();
             PyObject *dividend = TOP();
+            TYPE_PROFILE_RECORD(dividend, divisor);
             PyObject *quotient = PyNumber_FloorDivide(dividend, divisor);
             Py_DECREF(dividend);
             Py_DECREF(divisor);
@@ -3432,6 +4164,7 @@ main_loop:
             PyObject *divisor = POP();
             PyObject *dividend = TOP();
             PyObject *res;
+            TYPE_PROFILE_RECORD(dividend, divisor);
             if (PyUnicode_CheckExact(dividend) && (
                   !PyUnicode_Check(divisor) || PyUnicode_CheckExact(divisor))) {
               // fast path; string formatting, but not if the RHS is a str subclass
@@ -3496,6 +4229,8 @@ main_loop:
             PyObject *sub = POP();
             PyObject *container = TOP();
 
+            TYPE_PROFILE_RECORD(container, sub);
+
             _PyOpcache *co_opcache;
             OPCACHE_CHECK();
             if (co_opcache) {
@@ -3638,6 +4373,7 @@ main_loop:
         case TARGET(INPLACE_TRUE_DIVIDE): {
             PyObject *divisor = POP();
             PyObject *dividend = TOP();
+            TYPE_PROFILE_RECORD(dividend, divisor);
             PyObject *quotient = PyNumber_InPlaceTrueDivide(dividend, divisor);
             Py_DECREF(dividend);
             Py_DECREF(divisor);
@@ -3650,6 +4386,7 @@ main_loop:
         case TARGET(INPLACE_FLOOR_DIVIDE): {
             PyObject *divisor = POP();
             PyObject *dividend = TOP();
+            TYPE_PROFILE_RECORD(dividend, divisor);
             PyObject *quotient = PyNumber_InPlaceFloorDivide(dividend, divisor);
             Py_DECREF(dividend);
             Py_DECREF(divisor);
@@ -3662,6 +4399,7 @@ main_loop:
         case TARGET(INPLACE_MODULO): {
             PyObject *right = POP();
             PyObject *left = TOP();
+            TYPE_PROFILE_RECORD(left, right);
             PyObject *mod = PyNumber_InPlaceRemainder(left, right);
             Py_DECREF(left);
             Py_DECREF(right);
@@ -4679,6 +5417,10 @@ sa_common:
                             ptr = lg->u.builtin_cache.ptr;
                     } else if (lg->cache_type == LG_GLOBAL_OFFSET) {
                         ptr = _PyDict_GetItemByOffset((PyDictObject*)f->f_globals, name, lg->u.global_offset_cache.dk_size, lg->u.global_offset_cache.offset);
+#ifndef NO_DKVERSION
+                    } else if (lg->cache_type == LG_GLOBAL_KEYS_VERSION || lg->cache_type == LG_BUILTIN_KEYS_VERSION) {
+                        ptr = loadGlobalKeysVersionCache((PyDictObject*)f->f_globals, (PyDictObject*)f->f_builtins, lg);
+#endif
                     } else {
                         abort();
                     }
@@ -4734,6 +5476,15 @@ sa_common:
                     }
 
                     co_opcache->optimized = 1;
+#ifndef NO_DKVERSION
+                    // The ma_version based caches keep failing because the globals get modified,
+                    // so switch to the keys version ones which only fail if the set of names changes.
+                    // If this happens too we fall back to the offset cache for globals.
+                    if (co_opcache->num_failed >= 2 && (!wasglobal || co_opcache->num_failed < 4) &&
+                            setupLoadGlobalKeysVersionCache((PyDictObject*)f->f_globals, (PyDictObject*)f->f_builtins, name, wasglobal, lg) == 0) {
+                        // successfully set up the cache
+                    } else
+#endif
                     if (wasglobal && co_opcache->num_failed >= 2 && !_PyDict_HasSplitTable((PyDictObject*)f->f_globals)) {
                         Py_ssize_t dk_size;
                         int64_t offset = _PyDict_GetItemOffset((PyDictObject*)f->f_globals, name, &dk_size);
@@ -5288,7 +6039,8 @@ sa_common:
             if (USE_LOAD_ATTR_CACHE && co_opcache && co_opcache->optimized) {
                 if (likely(loadAttrCache(owner, name, co_opcache, &res, NULL) == 0))
                     goto la_common;
-                if (++co_opcache->num_failed > 15) {
+                // megamorphic sites miss until the process-wide cache contains the type, don't give up on them
+                if (co_opcache->u.la.cache_type != LA_CACHE_MEGAMORPHIC && ++co_opcache->num_failed > 15) {
                     // stop even trying to use the cache
                     // the cache setup code will also not fill it anymore because it checks num_failed
                     co_opcache->optimized = 0;
@@ -5319,11 +6071,19 @@ la_common:
         case TARGET(COMPARE_OP): {
             PyObject *right = POP();
             PyObject *left = TOP();
+            PyObject *res;
+
+            _PyOpcache *co_opcache;
+            OPCACHE_CHECK();
+            if (co_opcache && compareOpCache(left, right, oparg, co_opcache, &res) == 0)
+                goto compare_op_common;
+
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 8
-            PyObject *res = cmp_outcome(tstate, oparg, left, right);
+            res = cmp_outcome(tstate, oparg, left, right);
 #else
-            PyObject *res = PyObject_RichCompare(left, right, oparg);
+            res = PyObject_RichCompare(left, right, oparg);
 #endif
+compare_op_common:
             Py_DECREF(left);
             Py_DECREF(right);
             SET_TOP(res);
@@ -5747,7 +6507,13 @@ la_common:
             PREDICTED(FOR_ITER);
             /* before: [iter]; after: [iter, iter()] *or* [] */
             PyObject *iter = TOP();
-            PyObject *next = (*iter->ob_type->tp_iternext)(iter);
+            PyObject *next;
+            _PyOpcache *co_opcache;
+            OPCACHE_CHECK();
+            if (co_opcache)
+                next = forIterCache(iter, co_opcache);
+            else
+                next = (*iter->ob_type->tp_iternext)(iter);
             if (next != NULL) {
                 PUSH(next);
                 PREDICT(STORE_FAST);
@@ -6153,7 +6919,8 @@ la_common:
                     }
                     goto lm_before_dispatch;
                 }
-                if (++co_opcache->num_failed > 15) {
+                // megamorphic sites miss until the process-wide cache contains the type, don't give up on them
+                if (co_opcache->u.la.cache_type != LA_CACHE_MEGAMORPHIC && ++co_opcache->num_failed > 15) {
                     // stop even trying to use the cache
                     // the cache setup code will also not fill it anymore because it checks num_failed
                     co_opcache->optimized = 0;
@@ -6208,6 +6975,10 @@ lm_before_dispatch:
             /* Designed to work in tamdem with LOAD_METHOD. */
             PyObject **sp, *res, *meth;
 
+            _PyOpcache *co_opcache;
+            OPCACHE_CHECK();
+            (void)co_opcache;
+
             sp = stack_pointer;
 
             meth = PEEK(oparg + 2);
@@ -6226,7 +6997,9 @@ lm_before_dispatch:
                    `callable` will be POPed by call_function.
                    NULL will will be POPed manually later.
                 */
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
+#if USE_CALL_CACHE
+                res = call_function_cached(tstate, &sp, oparg, NULL, co_opcache);
+#elif PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
                 res = CALL_FUNCTION_CEVAL(tstate, &sp, oparg, NULL);
 #else
                 res = CALL_FUNCTION_CEVAL(tstate, trace_info, &sp, oparg, NULL);
@@ -6247,7 +7020,9 @@ lm_before_dispatch:
                   We'll be passing `oparg + 1` to call_function, to
                   make it accept the `self` as a first argument.
                 */
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
+#if USE_CALL_CACHE
+                res = call_function_cached(tstate, &sp, oparg + 1, NULL, co_opcache);
+#elif PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
                 res = CALL_FUNCTION_CEVAL(tstate, &sp, oparg + 1, NULL);
 #else
                 res = CALL_FUNCTION_CEVAL(tstate, trace_info, &sp, oparg + 1, NULL);
@@ -6267,8 +7042,13 @@ lm_before_dispatch:
         case TARGET(CALL_FUNCTION): {
             PREDICTED(CALL_FUNCTION);
             PyObject **sp, *res;
+            _PyOpcache *co_opcache;
+            OPCACHE_CHECK();
+            (void)co_opcache;
             sp = stack_pointer;
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
+#if USE_CALL_CACHE
+            res = call_function_cached(tstate, &sp, oparg, NULL, co_opcache);
+#elif PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
             res = CALL_FUNCTION_CEVAL(tstate, &sp, oparg, NULL);
 #else
             res = CALL_FUNCTION_CEVAL(tstate, trace_info, &sp, oparg, NULL);
@@ -6289,8 +7069,13 @@ lm_before_dispatch:
 
             names = POP();
             assert(PyTuple_CheckExact(names) && PyTuple_GET_SIZE(names) <= oparg);
+            _PyOpcache *co_opcache;
+            OPCACHE_CHECK();
+            (void)co_opcache;
             sp = stack_pointer;
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
+#if USE_CALL_CACHE
+            res = call_function_cached(tstate, &sp, oparg, names, co_opcache);
+#elif PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
             res = CALL_FUNCTION_CEVAL(tstate, &sp, oparg, names);
 #else
             res = CALL_FUNCTION_CEVAL(tstate, trace_info, &sp, oparg, names);
@@ -6863,6 +7648,9 @@ _PyEval_EvalFrame_AOT_JIT(PyFrameObject *f, PyThreadState * const tstate, PyObje
 #endif
 {
     PyObject* retval = NULL;
+    // prevents jit_ic_budget_exhausted() from freeing the machine code while we execute it
+    OpCache* opcache = _PyCode_GetOpcache(f->f_code);
+    ++opcache->oc_jit_num_active;
 
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION == 7
     enum why_code why = WHY_NOT;
@@ -6923,6 +7711,7 @@ continue_jit:
 #endif
         } else { // lower_bits == 3
             // this is a deopt
+            jit_count_deopt(jit_code);
 
             // we have to adjust back the last bytecode because the interpreter
             // will start at the next bytecode after f_lasti (so would skip one)
@@ -6936,6 +7725,7 @@ continue_jit:
 #endif
 
             int jit_first_trace_for_line = (PyObject*)(ret.ret_val & ~3) ? 1 : 0;
+            jit_frame_leave(opcache);
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
             return _PyEval_EvalFrame_AOT_Interpreter(f, 0 /* throwflag */, tstate, stack_pointer, 0 /*= can't use jit */, jit_first_trace_for_line);
 #else
@@ -7252,6 +8042,7 @@ exiting:
     f->f_executing = 0;
 #endif
     tstate->frame = f->f_back;
+    jit_frame_leave(opcache);
 
 #ifndef PYSTON_LITE
     return _Py_CheckFunctionResult(NULL, retval, "PyEval_EvalFrameEx");
@@ -7408,7 +8199,8 @@ _PyEval_EvalFrameDefault
     // It looks like they are not changeable for a given frame, so we only have to check once
     // at the beginning, but they're not fixed for a code object so we can't just check at jit time.
     // Also don't enter the jit if the throwflag is set which skips the main code path and goes to error path.
-    int can_use_jit = jit_code != JIT_FUNC_FAILED && PyDict_CheckExact(f->f_globals) && PyDict_CheckExact(f->f_builtins) && !throwflag;
+    int can_use_jit = jit_code != JIT_FUNC_FAILED && PyDict_CheckExact(f->f_globals) && PyDict_CheckExact(f->f_builtins) && !throwflag
+                      && likely(type_profile_filename == NULL);
 
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 9
     if (jit_code != NULL && can_use_jit) {
@@ -8850,6 +9642,74 @@ call_function_ceval_kw(PyThreadState *tstate, PyTraceInfo* trace_info, PyObject
 #endif
 #endif
 
+#if !defined(PYSTON_LITE) && PY_MAJOR_VERSION == 3 && (PY_MINOR_VERSION == 8 || PY_MINOR_VERSION == 9)
+PyObject* call_function_ceval_no_kw(PyThreadState *tstate, PyObject **stack, Py_ssize_t oparg);
+/* static */ void _Py_HOT_FUNCTION frame_dealloc_notrashcan(PyFrameObject *f);
+
+// Used by the JIT for CALL_FUNCTION sites where the callable got loaded via a LOAD_GLOBAL
+// inline cache and is guarded to be a python function with a specific code object.
+// If the callee only takes positional arguments and got JIT compiled we skip the generic call
+// machinery (vectorcall dispatch, argument parsing, PyEval_EvalFrameEx) and directly enter its machine code.
+// The JIT guard is on the code object address only, so we have to verify the signature again here.
+PyObject* _Py_HOT_FUNCTION
+call_function_jit_direct(PyThreadState *tstate, PyObject **stack, Py_ssize_t oparg) {
+    PyObject **pfunc = stack - oparg - 1;
+    PyFunctionObject *func = (PyFunctionObject*)*pfunc;
+    PyCodeObject *co = (PyCodeObject*)func->func_code;
+    JitFunc jit_code = getJitCode(co);
+
+    if (jit_code == NULL || jit_code == JIT_FUNC_FAILED
+        || co->co_argcount != oparg || co->co_kwonlyargcount != 0
+        || (co->co_flags & ~(PyCF_MASK | CO_NESTED)) != (CO_OPTIMIZED | CO_NEWLOCALS | CO_NOFREE)
+        || tstate->use_tracing || tstate->interp->eval_frame != _PyEval_EvalFrameDefault
+        || !PyDict_CheckExact(func->func_globals) || PyDTrace_FUNCTION_ENTRY_ENABLED()) {
+        return call_function_ceval_no_kw(tstate, stack, oparg);
+    }
+
+    PyFrameObject *f = _PyFrame_New_NoTrack(tstate, co, func->func_globals, NULL);
+    if (f == NULL) {
+        for (int i = oparg; i >= 0; i--) {
+            Py_DECREF(pfunc[i]);
+        }
+        return NULL;
+    }
+
+    // move the references to the arguments from the value stack into the new frame
+    PyObject **fastlocals = f->f_localsplus;
+    for (Py_ssize_t i = 0; i < oparg; i++) {
+        fastlocals[i] = pfunc[i + 1];
+    }
+
+    PyObject *result;
+    if (!PyDict_CheckExact(f->f_builtins)) {
+        result = PyEval_EvalFrameEx(f, 0);
+    } else if (Py_EnterRecursiveCall("")) {
+        result = NULL;
+    } else {
+        // this is what _PyEval_EvalFrameDefault does when tracing is disabled
+        tstate->frame = f;
+        PyObject **stack_pointer = f->f_stacktop;
+        f->f_stacktop = NULL;
+        f->f_executing = 1;
+        result = _PyEval_EvalFrame_AOT_JIT(f, tstate, stack_pointer, jit_code);
+    }
+
+    // same as in function_code_fastcall()
+    if (Py_REFCNT(f) > 1) {
+        Py_DECREF(f);
+        _PyObject_GC_TRACK(f);
+    }
+    else {
+        Py_REFCNT(f) = 0;
+        assert(Py_TYPE(f) == &PyFrame_Type);
+        frame_dealloc_notrashcan(f);
+    }
+
+    Py_DECREF(func);
+    return result;
+}
+#endif
+
 /*static*/ PyObject *
 do_call_core(PyThreadState *tstate,
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION >= 10
@@ -9693,6 +10553,54 @@ aot_ceval_test(PyObject *self, PyObject *args)
 {
     Py_RETURN_NONE;
 }
+
+static PyObject *
+aot_ceval_jit_stats(PyObject *self, PyObject *args)
+{
+    return jit_get_stats();
+}
+
+static PyObject *
+aot_ceval_jit_reset_stats(PyObject *self, PyObject *args)
+{
+    jit_reset_stats();
+    Py_RETURN_NONE;
+}
+
+static PyObject *
+aot_ceval_jit_code_stats(PyObject *self, PyObject *args, PyObject *kwargs)
+{
+    static char *kwlist[] = {"code", "reset", NULL};
+    PyObject *obj;
+    int reset = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p:jit_code_stats", kwlist, &obj, &reset))
+        return NULL;
+    if (PyFunction_Check(obj))
+        obj = PyFunction_GET_CODE(obj);
+    if (!PyCode_Check(obj)) {
+        PyErr_SetString(PyExc_TypeError, "jit_code_stats() expects a function or code object");
+        return NULL;
+    }
+    PyCodeObject *co = (PyCodeObject *)obj;
+#ifdef PYSTON_LITE
+    // the extra slots only get allocated once the code got executed
+    _PyCodeObjectExtra *co_extra = (_PyCodeObjectExtra *)co->co_extra;
+    if (co_extra == NULL || co_extra->ce_size <= code_jitfunc_index)
+        Py_RETURN_NONE;
+#endif
+    void *code = getJitCode(co);
+    if (code == NULL || code == JIT_FUNC_FAILED)
+        Py_RETURN_NONE;
+    return jit_get_code_stats(code, reset);
+}
+
+#define JIT_STATS_METHODS \
+    {"jit_stats", aot_ceval_jit_stats, METH_NOARGS, \
+     "Return a dict with the JIT statistics of this process."}, \
+    {"jit_reset_stats", aot_ceval_jit_reset_stats, METH_NOARGS, \
+     "Reset the JIT statistic counters."}, \
+    {"jit_code_stats", (PyCFunction)(void(*)(void))aot_ceval_jit_code_stats, METH_VARARGS | METH_KEYWORDS, \
+     "Return the JIT statistics of a function or code object or None if it is not JIT compiled."},
 #if OPCACHE_STATS
 static void showStats(const char* name, long hits, long misses, long uncached, long warmup) {
     long total = hits + misses + uncached + warmup;
@@ -9754,6 +10662,9 @@ void aot_exit()
     }
 #endif
 
+    typeProfileWrite();
+
+    jit_queue_finish();
     jit_finish();
 }
 void aot_ceval_opcode_profile(){}
@@ -9767,7 +10678,7 @@ int
 _PyCode_InitOpcache_Pyston(PyCodeObject* co, OpCache* opcache)
 {
     Py_ssize_t co_size = PyBytes_Size(co->co_code) / sizeof(_Py_CODEUNIT);
-    opcache->oc_opcache_map = (unsigned char *)PyMem_Calloc(co_size, 1);
+    opcache->oc_opcache_map = (_PyOpcacheIdx *)PyMem_Calloc(co_size, sizeof(_PyOpcacheIdx));
     if (opcache->oc_opcache_map == NULL) {
         return -1;
     }
@@ -9784,10 +10695,12 @@ _PyCode_InitOpcache_Pyston(PyCodeObject* co, OpCache* opcache)
             || opcode == BINARY_SUBTRACT || opcode == INPLACE_SUBTRACT
             || opcode == BINARY_MULTIPLY || opcode == INPLACE_MULTIPLY
             || opcode == BINARY_SUBSCR || opcode == STORE_SUBSCR
-            || opcode == LOAD_NAME) {
+            || opcode == LOAD_NAME
+            || (USE_CALL_CACHE && (opcode == CALL_FUNCTION || opcode == CALL_FUNCTION_KW || opcode == CALL_METHOD))
+            || opcode == COMPARE_OP || opcode == FOR_ITER) {
             opts++;
-            opcache->oc_opcache_map[i] = (unsigned char)opts;
-            if (opts > 254) {
+            opcache->oc_opcache_map[i] = (_PyOpcacheIdx)opts;
+            if (opts >= _PyOpcacheIdx_MAX) {
                 break;
             }
         }
@@ -9806,7 +10719,7 @@ _PyCode_InitOpcache_Pyston(PyCodeObject* co, OpCache* opcache)
         opcache->oc_opcache = NULL;
     }
 
-    opcache->oc_opcache_size = (unsigned char)opts;
+    opcache->oc_opcache_size = (_PyOpcacheIdx)opts;
     return 0;
 }
 
@@ -9844,7 +10757,7 @@ PyObject* enable_pyston_lite(PyObject* _m) {
     jit_start();
 
     // Unfortunately we currently don't release the jitted memory:
-    code_jitfunc_index = _PyEval_RequestCodeExtraIndex(NULL);
+    code_jitfunc_index = _PyEval_RequestCodeExtraIndex(jit_free_code);
 
     // Speed hack: rather than storing a pointer to an OpCache object in co_extra,
     // we store the entire struct. This mostly looks like storing the individual fields,
@@ -9861,11 +10774,14 @@ PyObject* enable_pyston_lite(PyObject* _m) {
     int index2 = _PyEval_RequestCodeExtraIndex(PyMem_Free);
     if (index2 != code_opcache_index + 1) abort();
 
-    _Static_assert(sizeof(OpCache) == 4 * sizeof(void*),  "needs to be modified");
+    _Static_assert(sizeof(OpCache) == 5 * sizeof(void*),  "needs to be modified");
     int index3 = _PyEval_RequestCodeExtraIndex(NULL);
     if (index3 != index2 + 1) abort();
     int index4 = _PyEval_RequestCodeExtraIndex(NULL);
     if (index4 != index3 + 1) abort();
+    _Static_assert(offsetof(OpCache, oc_jit_code_retired) == 4 * sizeof(void*),  "needs to be modified");
+    int index5 = _PyEval_RequestCodeExtraIndex(jit_free_retired_code);
+    if (index5 != index4 + 1) abort();
 
     PyThreadState_Get()->interp->eval_frame = _PyEval_EvalFrame_AOT;
 
@@ -9884,6 +10800,23 @@ PyObject* enable_pyston_lite(PyObject* _m) {
     if (val) {
         opcache_min_runs = atoll(val);
     }
+    val = getenv("JIT_ADAPTIVE_THRESHOLD");
+    if (val) {
+        jit_adaptive_threshold = atoi(val);
+    }
+    val = getenv("JIT_ASYNC");
+    if (val) {
+        jit_async = atoi(val);
+    }
+    val = getenv("OPCACHE_POLY_MAX_ENTRIES");
+    if (val) {
+        // the entry counts are stored in a char
+        opcache_poly_max_entries = Py_MAX(0, Py_MIN(atoi(val), 127));
+    }
+    val = getenv("AOT_TYPE_PROFILE");
+    if (val && *val) {
+        type_profile_filename = strdup(val);
+    }
 
     Py_RETURN_NONE;
 }
@@ -9891,6 +10824,7 @@ PyObject* enable_pyston_lite(PyObject* _m) {
 static PyMethodDef PystonLiteMethods[] = {
     {"enable", (PyCFunction)enable_pyston_lite, METH_NOARGS,
      "Enable all the Pyston optimizations."},
+    JIT_STATS_METHODS
     {NULL, NULL, 0, NULL}        /* Sentinel */
 };
 
@@ -9944,12 +10878,13 @@ PyMODINIT_FUNC PyInit_pyston(void) {
 
 static PyMethodDef aot_cevalMethods[] = {
     {"test",  aot_ceval_test, METH_VARARGS, "Run test"},
+    JIT_STATS_METHODS
     {NULL, NULL, 0, NULL}        /* Sentinel */
 };
 
 static struct PyModuleDef aot_cevalmodule = {
     PyModuleDef_HEAD_INIT,
-    "aot_ceval",   /* name of module */
+    "pyston",   /* name of module, gets registered in sys.modules like pyston_lite */
     NULL, /* module documentation, may be NULL */
     -1,       /* size of per-interpreter state of the module,
                  or -1 if the module keeps state in global variables. */
@@ -9983,6 +10918,23 @@ PyInit_aot_ceval(void)
     if (val) {
         opcache_min_runs = atoll(val);
     }
+    val = getenv("JIT_ADAPTIVE_THRESHOLD");
+    if (val) {
+        jit_adaptive_threshold = atoi(val);
+    }
+    val = getenv("JIT_ASYNC");
+    if (val) {
+        jit_async = atoi(val);
+    }
+    val = getenv("OPCACHE_POLY_MAX_ENTRIES");
+    if (val) {
+        // the entry counts are stored in a char
+        opcache_poly_max_entries = Py_MAX(0, Py_MIN(atoi(val), 127));
+    }
+    val = getenv("AOT_TYPE_PROFILE");
+    if (val && *val) {
+        type_profile_filename = strdup(val);
+    }
 
     return m;
 }
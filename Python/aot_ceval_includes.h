@@ -52,6 +52,27 @@ extern "C" {
 #define INST_IDX_TO_LASTI_FACTOR 1
 #endif
 
+// The FOR_ITER fast paths access list and range iterators directly.
+#ifdef PYSTON_LITE
+// CPython does not expose these, they have to match Objects/listobject.c and Objects/rangeobject.c
+typedef struct {
+    PyObject_HEAD
+    Py_ssize_t it_index;
+    PyListObject *it_seq; /* Set to NULL when iterator is exhausted */
+} _PyListIterObject;
+
+typedef struct {
+    PyObject_HEAD
+    long index;
+    long start;
+    long step;
+    long len;
+} _PyRangeIterObject;
+#else
+#include "pycore_list.h"
+#include "pycore_range.h"
+#endif
+
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION >= 10
 typedef struct {
     PyCodeObject *code; // The code object for the bounds. May be NULL.
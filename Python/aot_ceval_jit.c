@@ -65,6 +65,7 @@
 #else
 #include "../Objects/dict-common.h"
 #endif
+#include "longintrepr.h"
 
 #ifdef PYSTON_LITE
 #define IS_IMMORTAL(x) (0)
@@ -166,12 +167,40 @@ typedef struct CallMethodHint {
     char is_self_const; // self set via LOAD_CONST
 } CallMethodHint;
 
+// Per function data which lives as long as the machine code and gets updated while it runs.
+// Exposed via jit_code_stats().
+typedef struct JitFuncData {
+    long ic_miss_budget; // see Jit.ic_miss_budget
+    long ic_miss_budget_initial; // value of ic_miss_budget when the code got emitted or the stats got reset
+    char ic_miss_budget_enabled; // set if the machine code counts inline cache misses
+    unsigned long num_deopts; // how often we had to continue executing the frame in the interpreter
+    long compile_time_in_us;
+    long code_size;
+    void* retired_next; // next entry in the per code object list of replaced machine code
+} JitFuncData;
+
+// Properties of the objects an opcache entry points to, see create_opcache_snapshot().
+typedef struct JitOpcacheFacts {
+    char obj_immortal; // IS_IMMORTAL() of the object cached by a LOAD_GLOBAL or LOAD_ATTR value cache
+
+    // LOAD_GLOBAL of a python function which can get called via call_function_jit_direct()
+    // when passing 'direct_call_argcount' positional arguments, see get_direct_call_target()
+    PyCodeObject* direct_call_code;
+    int direct_call_argcount;
+} JitOpcacheFacts;
+
 typedef struct Jit {
     struct dasm_State* d;
     char failed;
 
     PyCodeObject* co;
     OpCache* opcache;
+    PyInterpreterState* interp; // used instead of PyThreadState_GET() because we may not hold the GIL
+
+    // copy of the opcache, the emitter must not look at the live one, see create_opcache_snapshot()
+    _PyOpcache* opcache_snapshot; // need to be free()d
+    JitOpcacheFacts* opcache_facts; // need to be free()d, one entry per opcache_snapshot entry
+    int opcache_snapshot_size;
     PyObject* co_consts;
     PyObject* co_names;
 
@@ -201,6 +230,11 @@ typedef struct Jit {
     // currently we only track definedness inside a basic block and in addition the function args
     // TODO: could use a bitvector instead of a byte per local variable
     char* known_defined; // need to be free()d
+
+    // result of calculate_defined_at_jmp_targets(): for every jump target (index via jmp_target_state_idx)
+    // co_nlocals entries which are 1 if the local is known to be set when we reach the jump target
+    int* jmp_target_state_idx; // need to be free()d
+    char* defined_at_jmp_target; // need to be free()d
 #endif
 
     // used by emit_instr_start to keep state across calls
@@ -208,6 +242,12 @@ typedef struct Jit {
     int emitted_trace_check_for_line;
 
     CallMethodHint* call_method_hints; // linked list, each item needs to be freed
+
+    // gets owned by the machine code on success else needs to be free()d
+    JitFuncData* func_data;
+
+    // remaining number of IC misses before the function gets recompiled (points into func_data), NULL if disabled.
+    long* ic_miss_budget;
 } Jit;
 
 #define Dst_DECL Jit* Dst
@@ -273,6 +313,194 @@ struct PerfMapEntry {
 
 static int jit_use_aot = 1, jit_use_ics = 1;
 
+// used if JIT_HOTNESS_FILE is set:
+// This is only a hotness hint and not a code cache: we can't reuse the emitted machine
+// code in a different process because it embeds the addresses of constants, opcache
+// entries, types, dict keys etc.. and the JIT has no relocation support.
+// Instead we persist which functions got hot enough to get compiled and on the next run
+// start those functions with an already initialized opcache and a call counter just below
+// their JIT threshold. This removes the interpreter warmup calls but we still pay
+// for the compilation.
+// The file starts with a hash of the interpreter build so we never use a stale file.
+static char* jit_hotness_path = NULL;
+static uint64_t jit_hotness_build_id = 0;
+static uint64_t* jit_hotness_keys = NULL; // sorted, loaded from the file
+static long jit_hotness_num_keys = 0;
+static uint64_t* jit_hotness_new_keys = NULL; // functions compiled in this process
+static long jit_hotness_num_new_keys = 0;
+static unsigned long jit_stat_hotness_hinted;
+
+#define JIT_HOTNESS_MAGIC "pyston-jit-hotness-v1"
+
+static uint64_t jit_hotness_hash_bytes(uint64_t h, const void* data, Py_ssize_t size) {
+    // FNV-1a: unlike PyObject_Hash() it is not randomized per process
+    const unsigned char* p = (const unsigned char*)data;
+    for (Py_ssize_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t jit_hotness_hash_str(uint64_t h, PyObject* str) {
+    Py_ssize_t size;
+    const char* data = PyUnicode_AsUTF8AndSize(str, &size);
+    if (!data) {
+        PyErr_Clear();
+        return h;
+    }
+    return jit_hotness_hash_bytes(h, data, size);
+}
+
+static uint64_t jit_hotness_hash_obj(uint64_t h, PyObject* obj) {
+    const char* type_name = Py_TYPE(obj)->tp_name;
+    h = jit_hotness_hash_bytes(h, type_name, strlen(type_name));
+    if (PyUnicode_CheckExact(obj)) {
+        h = jit_hotness_hash_str(h, obj);
+    } else if (PyBytes_CheckExact(obj)) {
+        h = jit_hotness_hash_bytes(h, PyBytes_AS_STRING(obj), PyBytes_GET_SIZE(obj));
+    } else if (PyLong_CheckExact(obj)) {
+        int overflow;
+        long long val = PyLong_AsLongLongAndOverflow(obj, &overflow);
+        h = jit_hotness_hash_bytes(h, &val, sizeof(val));
+    } else if (PyFloat_CheckExact(obj)) {
+        double val = PyFloat_AS_DOUBLE(obj);
+        h = jit_hotness_hash_bytes(h, &val, sizeof(val));
+    } else if (PyTuple_CheckExact(obj) || PyFrozenSet_CheckExact(obj)) {
+        Py_ssize_t size = PyObject_Size(obj);
+        h = jit_hotness_hash_bytes(h, &size, sizeof(size));
+        if (PyTuple_CheckExact(obj)) {
+            for (Py_ssize_t i = 0; i < size; ++i)
+                h = jit_hotness_hash_obj(h, PyTuple_GET_ITEM(obj, i));
+        }
+    } else if (PyCode_Check(obj)) {
+        PyCodeObject* co = (PyCodeObject*)obj;
+        h = jit_hotness_hash_bytes(h, PyBytes_AS_STRING(co->co_code), PyBytes_GET_SIZE(co->co_code));
+        h = jit_hotness_hash_str(h, co->co_name);
+    }
+    return h;
+}
+
+// returns a key which is identical for the same function in different processes
+static uint64_t jit_hotness_key(PyCodeObject* co) {
+    uint64_t h = jit_hotness_build_id;
+    h = jit_hotness_hash_bytes(h, PyBytes_AS_STRING(co->co_code), PyBytes_GET_SIZE(co->co_code));
+    h = jit_hotness_hash_bytes(h, &co->co_firstlineno, sizeof(co->co_firstlineno));
+    h = jit_hotness_hash_str(h, co->co_filename);
+    h = jit_hotness_hash_str(h, co->co_name);
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(co->co_names); ++i)
+        h = jit_hotness_hash_str(h, PyTuple_GET_ITEM(co->co_names, i));
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(co->co_consts); ++i)
+        h = jit_hotness_hash_obj(h, PyTuple_GET_ITEM(co->co_consts, i));
+    return h;
+}
+
+static int jit_hotness_cmp_keys(const void* a, const void* b) {
+    uint64_t key_a = *(const uint64_t*)a, key_b = *(const uint64_t*)b;
+    return key_a < key_b ? -1 : key_a > key_b;
+}
+
+static void jit_hotness_load() {
+    const char* build_info[] = { Py_GetVersion(), Py_GetBuildInfo(), Py_GetCompiler() };
+    jit_hotness_build_id = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < (int)(sizeof(build_info)/sizeof(build_info[0])); ++i)
+        jit_hotness_build_id = jit_hotness_hash_bytes(jit_hotness_build_id, build_info[i], strlen(build_info[i]));
+
+    FILE* f = fopen(jit_hotness_path, "r");
+    if (!f)
+        return; // first run, file gets created in jit_finish()
+
+    char magic[64];
+    unsigned long long build_id, key;
+    if (fscanf(f, "%63s %llx", magic, &build_id) != 2 || strcmp(magic, JIT_HOTNESS_MAGIC) != 0
+        || build_id != jit_hotness_build_id) {
+        // created by a different interpreter build: ignore it, will get overwritten
+        fclose(f);
+        return;
+    }
+    long capacity = 0;
+    while (fscanf(f, "%llx", &key) == 1) {
+        if (jit_hotness_num_keys == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            uint64_t* new_keys = realloc(jit_hotness_keys, capacity * sizeof(uint64_t));
+            if (!new_keys)
+                break;
+            jit_hotness_keys = new_keys;
+        }
+        jit_hotness_keys[jit_hotness_num_keys++] = key;
+    }
+    fclose(f);
+    qsort(jit_hotness_keys, jit_hotness_num_keys, sizeof(uint64_t), jit_hotness_cmp_keys);
+}
+
+static void jit_hotness_add(PyCodeObject* co) {
+    if (jit_hotness_num_new_keys % 1024 == 0) {
+        uint64_t* new_keys = realloc(jit_hotness_new_keys, (jit_hotness_num_new_keys + 1024) * sizeof(uint64_t));
+        if (!new_keys)
+            return;
+        jit_hotness_new_keys = new_keys;
+    }
+    jit_hotness_new_keys[jit_hotness_num_new_keys++] = jit_hotness_key(co);
+}
+
+static void jit_hotness_write() {
+    // many processes may share the same file: write into a temporary file and rename it
+    // so readers will never see a partially written cache.
+    size_t tmp_path_size = strlen(jit_hotness_path) + 32;
+    char* tmp_path = malloc(tmp_path_size);
+    if (!tmp_path)
+        return;
+    snprintf(tmp_path, tmp_path_size, "%s.%d.tmp", jit_hotness_path, getpid());
+    FILE* f = fopen(tmp_path, "w");
+    if (!f) {
+        free(tmp_path);
+        return;
+    }
+
+    // merge the loaded keys with the new ones (both sorted) and remove duplicates
+    qsort(jit_hotness_new_keys, jit_hotness_num_new_keys, sizeof(uint64_t), jit_hotness_cmp_keys);
+    fprintf(f, "%s %llx\n", JIT_HOTNESS_MAGIC, (unsigned long long)jit_hotness_build_id);
+    long i = 0, j = 0, num_written = 0;
+    uint64_t last_key = 0;
+    while (i < jit_hotness_num_keys || j < jit_hotness_num_new_keys) {
+        uint64_t key;
+        if (j >= jit_hotness_num_new_keys || (i < jit_hotness_num_keys && jit_hotness_keys[i] < jit_hotness_new_keys[j]))
+            key = jit_hotness_keys[i++];
+        else
+            key = jit_hotness_new_keys[j++];
+        if (num_written && key == last_key)
+            continue;
+        fprintf(f, "%llx\n", (unsigned long long)key);
+        last_key = key;
+        ++num_written;
+    }
+
+    if (fclose(f) != 0 || rename(tmp_path, jit_hotness_path) != 0)
+        unlink(tmp_path);
+    free(tmp_path);
+}
+
+// Returns 1 if 'co' got JIT compiled in a previous run which used the same JIT_HOTNESS_FILE.
+// Only gets called on the first execution of a code object.
+#ifdef PYSTON_LITE
+int jit_hotness_is_hot_lite(PyCodeObject* co) {
+#else
+int jit_hotness_is_hot(PyCodeObject* co) {
+#endif
+    if (jit_hotness_num_keys == 0)
+        return 0;
+
+    PyObject *type, *value, *traceback;
+    PyErr_Fetch(&type, &value, &traceback);
+    uint64_t key = jit_hotness_key(co);
+    PyErr_Restore(type, value, traceback);
+
+    if (!bsearch(&key, jit_hotness_keys, jit_hotness_num_keys, sizeof(uint64_t), jit_hotness_cmp_keys))
+        return 0;
+    ++jit_stat_hotness_hinted;
+    return 1;
+}
+
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 8
 static PyObject* cmp_outcomePyCmp_BAD(PyObject *v, PyObject *w) {
   return cmp_outcome(NULL, PyCmp_BAD, v, w);
@@ -700,6 +928,71 @@ static const char* get_opcode_name(int opcode) {
 #define IS_32BIT_VAL(x) ((unsigned long)(x) <= UINT32_MAX)
 #define IS_32BIT_SIGNED_VAL(x) ((int32_t)(x) == (int64_t)(x))
 
+// returns the number of instructions the opcode can jump to (not counting the fallthrough to the
+// next instruction) and stores their indices in 'targets'.
+// Some opcodes also mark the next instruction because it can be reached by an indirect jump
+// (e.g. the return from a finally block or resuming a generator).
+static int get_jmp_targets(int opcode, int oparg, int inst_idx, int targets[2]) {
+    switch (opcode) {
+        case JUMP_ABSOLUTE:
+        case POP_JUMP_IF_FALSE:
+        case POP_JUMP_IF_TRUE:
+        case JUMP_IF_FALSE_OR_POP:
+        case JUMP_IF_TRUE_OR_POP:
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION >= 9
+        case JUMP_IF_NOT_EXC_MATCH:
+#endif
+            targets[0] = oparg/INST_IDX_TO_LASTI_FACTOR;
+            return 1;
+
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION == 7
+        case BREAK_LOOP:
+        case CONTINUE_LOOP:
+            targets[0] = inst_idx + 1;
+            targets[1] = oparg/INST_IDX_TO_LASTI_FACTOR;
+            return 2;
+#endif
+
+
+        case JUMP_FORWARD:
+        case FOR_ITER:
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION >= 8
+        case END_ASYNC_FOR:
+#endif
+            targets[0] = oparg/INST_IDX_TO_LASTI_FACTOR + inst_idx + 1;
+            return 1;
+
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION == 8
+        case CALL_FINALLY:
+            targets[0] = inst_idx + 1;
+            targets[1] = oparg/INST_IDX_TO_LASTI_FACTOR + inst_idx + 1;
+            return 2;
+#endif
+
+        // this opcodes use PyFrame_BlockSetup which is similar to a jump in case of exception
+        case SETUP_ASYNC_WITH:
+        case SETUP_FINALLY:
+        case SETUP_WITH:
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION == 7
+        case SETUP_LOOP:
+        case SETUP_EXCEPT:
+#endif
+            targets[0] = inst_idx + 1;
+            targets[1] = oparg/INST_IDX_TO_LASTI_FACTOR + inst_idx + 1;
+            return 2;
+
+        case YIELD_FROM:
+            targets[0] = inst_idx + 0;
+            targets[1] = inst_idx + 1;
+            return 2;
+
+        case YIELD_VALUE:
+            targets[0] = inst_idx + 1;
+            return 1;
+    }
+    return 0;
+}
+
 // looks which instruction can be reached by jumps
 // this is important for the deferred stack operations because
 // if a instruction can be reached by a jump we can't use this optimization.
@@ -724,121 +1017,302 @@ static char* calculate_jmp_targets(Jit* Dst) {
         oparg |= oldoparg;
         oldoparg = 0;
 
-        switch (opcode) {
-            case JUMP_ABSOLUTE:
-            case POP_JUMP_IF_FALSE:
-            case POP_JUMP_IF_TRUE:
-            case JUMP_IF_FALSE_OR_POP:
-            case JUMP_IF_TRUE_OR_POP:
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION >= 9
-            case JUMP_IF_NOT_EXC_MATCH:
-#endif
-                is_jmp_target[oparg/INST_IDX_TO_LASTI_FACTOR] = 1;
-                break;
-
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION == 7
-            case BREAK_LOOP:
-            case CONTINUE_LOOP:
-                is_jmp_target[inst_idx + 1] = 1;
-                is_jmp_target[oparg/INST_IDX_TO_LASTI_FACTOR] = 1;
-                break;
-#endif
-
-
-            case JUMP_FORWARD:
-            case FOR_ITER:
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION >= 8
-            case END_ASYNC_FOR:
-#endif
-                is_jmp_target[oparg/INST_IDX_TO_LASTI_FACTOR + inst_idx + 1] = 1;
-                break;
-
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION == 8
-            case CALL_FINALLY:
-                is_jmp_target[inst_idx + 1] = 1;
-                is_jmp_target[oparg/INST_IDX_TO_LASTI_FACTOR + inst_idx + 1] = 1;
-                break;
-#endif
-
-            // this opcodes use PyFrame_BlockSetup which is similar to a jump in case of exception
-            case SETUP_ASYNC_WITH:
-            case SETUP_FINALLY:
-            case SETUP_WITH:
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION == 7
-            case SETUP_LOOP:
-            case SETUP_EXCEPT:
-#endif
-                is_jmp_target[inst_idx + 1] = 1;
-                is_jmp_target[oparg/INST_IDX_TO_LASTI_FACTOR + inst_idx + 1] = 1;
-                break;
-
-            case YIELD_FROM:
-                is_jmp_target[inst_idx + 0] = 1;
-                is_jmp_target[inst_idx + 1] = 1;
-                break;
-
-            case YIELD_VALUE:
-                is_jmp_target[inst_idx + 1] = 1;
-                break;
-
-            case EXTENDED_ARG:
-                oldoparg = oparg << 8;
-                break;
+        if (opcode == EXTENDED_ARG) {
+            oldoparg = oparg << 8;
+            continue;
         }
+
+        int targets[2];
+        int num_targets = get_jmp_targets(opcode, oparg, inst_idx, targets);
+        for (int i=0; i<num_targets; ++i)
+            is_jmp_target[targets[i]] = 1;
     }
     return is_jmp_target;
 }
 
 #if ENABLE_DEFINED_TRACKING
-// returns if any of the functions arguments get deleted (checks for DELETE_FAST)
-static int check_func_args_never_deleted(Jit* Dst) {
-    const int num_args = Dst->co->co_argcount;
+// Calculates for every jump target which fast locals are guaranteed to be set (!= 0) when we reach it.
+// This lets the definedness tracking continue across basic blocks, so that e.g. a loop counter
+// which got assigned before the loop does not need a NULL check and a signal check inside the loop body.
+//
+// This is a forward dataflow analysis where the state at a jump target is the intersection of the states
+// of all its predecessors. We only track locals which never get deleted (no DELETE_FAST in the function)
+// because they can only ever go from unset to set. This means we don't have to model every edge precisely
+// (exceptions, return from a finally block, generator resumption, OSR entry): it's enough that every path
+// into a jump target passes through a predecessor we do model. To make sure of this we treat every
+// instruction as falling through to the next one in addition to its jump targets.
+//
+// Sets Dst->jmp_target_state_idx and Dst->defined_at_jmp_target, both need to be freed()
+static void calculate_defined_at_jmp_targets(Jit* Dst) {
+    const int nlocals = Dst->co->co_nlocals;
+    const int num_opcodes = Dst->num_opcodes;
+
+    char* never_deleted = (char*)malloc(nlocals);
+    memset(never_deleted, 1, nlocals);
+    int* state_idx = (int*)malloc(num_opcodes * sizeof(int));
+    int num_states = 0;
     int oldoparg = 0;
-    for (int inst_idx = 0; inst_idx < Dst->num_opcodes; ++inst_idx) {
+    for (int inst_idx = 0; inst_idx < num_opcodes; ++inst_idx) {
         _Py_CODEUNIT word = Dst->first_instr[inst_idx];
         int opcode = _Py_OPCODE(word);
-        int oparg = _Py_OPARG(word);
-        // this is used for the special EXTENDED_ARG opcode
-        oparg |= oldoparg;
+        int oparg = _Py_OPARG(word) | oldoparg;
+        oldoparg = opcode == EXTENDED_ARG ? oparg << 8 : 0;
+        if (opcode == DELETE_FAST)
+            never_deleted[oparg] = 0;
+        state_idx[inst_idx] = Dst->is_jmp_target[inst_idx] ? num_states++ : -1;
+    }
+
+    // start with 'everything is defined' and remove locals until nothing changes anymore
+    char* states = (char*)malloc(num_states * nlocals + 1);
+    memset(states, 1, num_states * nlocals);
+    char* cur = (char*)malloc(nlocals + 1);
+
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+
+        // function entry: only the arguments are set
+        memset(cur, 0, nlocals);
+        for (int i=0; i<Dst->co->co_argcount && i<nlocals; ++i)
+            cur[i] = never_deleted[i];
+
         oldoparg = 0;
+        for (int inst_idx = 0; inst_idx < num_opcodes; ++inst_idx) {
+            if (state_idx[inst_idx] != -1) {
+                // merge fallthrough (or function entry) into the state of this jump target
+                char* state = &states[state_idx[inst_idx] * nlocals];
+                for (int i=0; i<nlocals; ++i) {
+                    if (state[i] && !cur[i]) {
+                        state[i] = 0;
+                        changed = 1;
+                    }
+                }
+                memcpy(cur, state, nlocals);
+            }
 
-        switch (opcode) {
-            case DELETE_FAST:
-                if (oparg < num_args)
-                    return 0; // this is deleting a function arg!
-                break;
+            _Py_CODEUNIT word = Dst->first_instr[inst_idx];
+            int opcode = _Py_OPCODE(word);
+            int oparg = _Py_OPARG(word) | oldoparg;
+            oldoparg = 0;
 
-            case EXTENDED_ARG:
-                oldoparg = oparg << 8;
-                break;
+            switch (opcode) {
+                case EXTENDED_ARG:
+                    oldoparg = oparg << 8;
+                    break;
+
+                // after a LOAD_FAST the variable is set because else we would have thrown an exception
+                case LOAD_FAST:
+                case STORE_FAST:
+                    cur[oparg] = never_deleted[oparg];
+                    break;
+
+                case DELETE_FAST:
+                    cur[oparg] = 0;
+                    break;
+            }
+
+            int targets[2];
+            int num_targets = get_jmp_targets(opcode, oparg, inst_idx, targets);
+            for (int t=0; t<num_targets; ++t) {
+                if (targets[t] >= num_opcodes)
+                    continue;
+                char* state = &states[state_idx[targets[t]] * nlocals];
+                for (int i=0; i<nlocals; ++i) {
+                    if (state[i] && !cur[i]) {
+                        state[i] = 0;
+                        changed = 1;
+                    }
+                }
+            }
         }
     }
-    return 1;
+
+    free(cur);
+    free(never_deleted);
+    Dst->jmp_target_state_idx = state_idx;
+    Dst->defined_at_jmp_target = states;
 }
 #endif
 
 static int8_t* mem_chunk = NULL;
 static size_t mem_chunk_bytes_remaining = 0;
-static long mem_bytes_allocated = 0, mem_bytes_used = 0;
+static long mem_bytes_allocated = 0, mem_bytes_used = 0, mem_bytes_freed = 0;
 static long mem_bytes_used_max = 100*1000*1000; // will stop emitting code after that many bytes
 static int jit_num_funcs = 0, jit_num_failed = 0;
 static long total_compilation_time_in_us = 0;
 
 static int jit_stats_enabled = 0;
+static PyObject* jit_empty_tuple = NULL; // created in jit_start() because PyTuple_New() needs the GIL
 static unsigned long jit_stat_load_attr_hit, jit_stat_load_attr_miss, jit_stat_load_attr_inline, jit_stat_load_attr_total;
 static unsigned long jit_stat_store_attr_hit, jit_stat_store_attr_miss, jit_stat_store_attr_inline, jit_stat_store_attr_total;
 static unsigned long jit_stat_load_method_hit, jit_stat_load_method_miss, jit_stat_load_method_inline, jit_stat_load_method_total;
 static unsigned long jit_stat_load_global_hit, jit_stat_load_global_miss, jit_stat_load_global_inline, jit_stat_load_global_total;
 static unsigned long jit_stat_call_method_hit, jit_stat_call_method_miss, jit_stat_call_method_inline, jit_stat_call_method_total;
+static unsigned long jit_stat_call_function_hit, jit_stat_call_function_miss, jit_stat_call_function_inline, jit_stat_call_function_total;
 static unsigned long jit_stat_getitemlong, jit_stat_getitemlong_inlined, jit_stat_setitemlong_inlined;
 static unsigned long jit_stat_load_attr_poly, jit_stat_load_attr_poly_entries;
 static unsigned long jit_stat_load_method_poly, jit_stat_load_method_poly_entries;
 static unsigned long jit_stat_binary_op_inplace, jit_stat_binary_op_inplace_miss, jit_stat_binary_op_inplace_hit;
+static unsigned long jit_stat_binary_op_unboxed, jit_stat_binary_op_unboxed_miss, jit_stat_binary_op_unboxed_hit;
 static unsigned long jit_stat_concat_inplace, jit_stat_concat_inplace_miss, jit_stat_concat_inplace_hit;
+static unsigned long jit_stat_compare_op_typed, jit_stat_compare_op_typed_miss, jit_stat_compare_op_typed_hit;
+static unsigned long jit_stat_for_iter_inline, jit_stat_for_iter_miss, jit_stat_for_iter_hit;
+static unsigned long jit_stat_ic_recompiles;
+static unsigned long jit_stat_funcs_freed;
+static unsigned long jit_stat_deopts;
 
 #define ENABLE_DEFERRED_RES_PUSH 1
 #define ENABLE_AVOID_SIG_TRACE_CHECK 1
 
+// Every JIT compiled function gets a budget of inline cache misses (shared by all its IC sites).
+// When it is used up we throw away the machine code and recompile the function with the
+// updated opcache. The budget doubles on every recompilation and we stop after JIT_MAX_RECOMPILES.
+#define JIT_IC_MISS_BUDGET 1000
+#define JIT_MAX_RECOMPILES 3
+// max number of entries of a polymorphic LOAD_ATTR/LOAD_METHOD cache we emit inline,
+// the interpreter keeps them sorted by hits so the remaining ones are the least common ones
+#define JIT_MAX_POLY_INLINE_ENTRIES 8
+
+// Every emitted function is prefixed with this header, the entry point directly follows it.
+// It allows us to return the memory when the code object gets freed.
+typedef struct JitCodeHeader {
+    size_t size; // size of the whole allocation including this header
+    JitFuncData* func_data;
+} JitCodeHeader;
+
+// Memory of freed functions is kept in a list sorted by address so that neighbouring
+// blocks can be merged and the space reused for new functions.
+// The list is stored inside the free memory itself.
+typedef struct JitFreeBlock {
+    struct JitFreeBlock* next;
+    size_t size;
+} JitFreeBlock;
+static JitFreeBlock* jit_free_blocks = NULL;
+
+static void jit_mem_add_free_block(void* mem, size_t size) {
+    if (size < sizeof(JitFreeBlock))
+        return;
+
+    JitFreeBlock* prev = NULL;
+    JitFreeBlock** prev_next = &jit_free_blocks;
+    while (*prev_next && (char*)*prev_next < (char*)mem) {
+        prev = *prev_next;
+        prev_next = &prev->next;
+    }
+    JitFreeBlock* next = *prev_next;
+
+    JIT_MEM_RW();
+    JitFreeBlock* block = (JitFreeBlock*)mem;
+    block->size = size;
+    block->next = next;
+    if (next && (char*)block + block->size == (char*)next) {
+        block->size += next->size;
+        block->next = next->next;
+    }
+    if (prev && (char*)prev + prev->size == (char*)block) {
+        prev->size += block->size;
+        prev->next = block->next;
+    } else {
+        *prev_next = block;
+    }
+    JIT_MEM_RX();
+}
+
+// first fit search of the free list.
+// the size can get increased if the remaining space of the block would be too small to be useful.
+static void* jit_mem_alloc_from_free_list(size_t* size) {
+    for (JitFreeBlock** prev_next = &jit_free_blocks; *prev_next; prev_next = &(*prev_next)->next) {
+        JitFreeBlock* block = *prev_next;
+        if (block->size < *size)
+            continue;
+
+        JIT_MEM_RW();
+        if (block->size - *size >= 256) {
+            JitFreeBlock* rest = (JitFreeBlock*)((char*)block + *size);
+            rest->size = block->size - *size;
+            rest->next = block->next;
+            *prev_next = rest;
+        } else {
+            *size = block->size;
+            *prev_next = block->next;
+        }
+        JIT_MEM_RX();
+        return block;
+    }
+    return NULL;
+}
+
+static void jit_mem_free_code(void* code) {
+    JitCodeHeader* header = (JitCodeHeader*)code - 1;
+    size_t size = header->size;
+    free(header->func_data);
+
+    if (perf_map_file) {
+        for (int i=0; i<perf_map_num_funcs; ++i) {
+            if (perf_map_funcs[i].func_addr != code)
+                continue;
+            free(perf_map_funcs[i].func_name);
+            perf_map_funcs[i] = perf_map_funcs[perf_map_num_funcs-1];
+            --perf_map_num_funcs;
+            break;
+        }
+    }
+
+    mem_bytes_used -= size;
+    mem_bytes_freed += size;
+    ++jit_stat_funcs_freed;
+    jit_mem_add_free_block(header, size);
+}
+
+// Called when the code object owning the machine code gets freed.
+// At this point no frame can execute the code anymore because they keep a reference to the code object.
+#ifdef PYSTON_LITE
+void jit_free_code_lite(void* code) {
+#else
+void jit_free_code(void* code) {
+#endif
+    if (code == NULL || code == (void*)0x1 /* JIT_FUNC_FAILED */)
+        return;
+    jit_mem_free_code(code);
+}
+
+// Called when the machine code of a code object gets replaced (see jit_ic_budget_exhausted()).
+// Frames may still be executing it, so we only prepend it to the list of replaced code of the
+// code object and return the new list head. The list gets freed with jit_free_retired_code().
+#ifdef PYSTON_LITE
+void* jit_retire_code_lite(void* retired, void* code) {
+#else
+void* jit_retire_code(void* retired, void* code) {
+#endif
+    ((JitCodeHeader*)code - 1)->func_data->retired_next = retired;
+    return code;
+}
+
+// Frees a list created by jit_retire_code().
+// Must only get called once no frame is executing machine code of the code object anymore.
+#ifdef PYSTON_LITE
+void jit_free_retired_code_lite(void* retired) {
+#else
+void jit_free_retired_code(void* retired) {
+#endif
+    while (retired) {
+        void* next = ((JitCodeHeader*)retired - 1)->func_data->retired_next;
+        jit_mem_free_code(retired);
+        retired = next;
+    }
+}
+
+// returns how much of the JIT_MAX_MEM budget is in use (0-100)
+#ifdef PYSTON_LITE
+int jit_mem_usage_percent_lite() {
+#else
+int jit_mem_usage_percent() {
+#endif
+    if (mem_bytes_used_max <= 0 || mem_bytes_used >= mem_bytes_used_max)
+        return 100;
+    return (int)(mem_bytes_used * 100 / mem_bytes_used_max);
+}
+
 @ARM|.arch arm64
 @X86|.arch x64
 
@@ -1006,6 +1480,11 @@ static void switch_section(Jit* Dst, Section new_section) {
 @X86| jbe dst
 |.endmacro
 
+|.macro branch_gt_unsigned, dst
+@ARM| bhi dst
+@X86| ja dst
+|.endmacro
+
 // compares r_object_idx->ob_type with type
 // branches to false_branch on inequality else continues
 |.macro type_check, r_object_idx, type, false_branch
@@ -1828,8 +2307,7 @@ static int should_emit_eval_breaker_check(Jit* Dst, int next_inst_idx) {
 
 static void emit_eval_breaker_check(Jit* Dst) {
     // TODO: we directly embed the address of the interpreter struct maybe we should fetch it at runtime?
-    PyThreadState *tstate = PyThreadState_GET();
-    emit_mov_imm(Dst, arg1_idx, (unsigned long)&tstate->interp->ceval.eval_breaker);
+    emit_mov_imm(Dst, arg1_idx, (unsigned long)&Dst->interp->ceval.eval_breaker);
     _Static_assert(sizeof(((struct _ceval_state*)0)->eval_breaker) == 4, "");
     emit_cmp32_mem_imm(Dst, arg1_idx, 0 /* =offset*/, 0 /* =value */);
     | branch_eq >8
@@ -2423,6 +2901,14 @@ static void emit_convert_res32_to_pybool(Jit* Dst, int invert) {
 }
 
 
+#if !defined(PYSTON_LITE) && PY_MAJOR_VERSION == 3 && (PY_MINOR_VERSION == 8 || PY_MINOR_VERSION == 9)
+PyObject* call_function_jit_direct(PyThreadState *tstate, PyObject **stack, Py_ssize_t oparg);
+#define ENABLE_DIRECT_CALLS 1
+#else
+#define ENABLE_DIRECT_CALLS 0
+#endif
+
+// Returns the entry of the opcache snapshot for the instruction at 'inst_idx'.
 static _PyOpcache* get_opcache_entry(Jit* Dst, int inst_idx) {
     OpCache* opcache = Dst->opcache;
     _PyOpcache* co_opcache = NULL;
@@ -2431,26 +2917,284 @@ static _PyOpcache* get_opcache_entry(Jit* Dst, int inst_idx) {
         // have an opcache. Else it would excess one element after the opcache_map.
         return NULL;
     }
-    if (opcache->oc_opcache != NULL) {
-        unsigned char co_opt_offset = opcache->oc_opcache_map[inst_idx + 1];
+    if (Dst->opcache_snapshot != NULL) {
+        _PyOpcacheIdx co_opt_offset = opcache->oc_opcache_map[inst_idx + 1];
         if (co_opt_offset > 0) {
             JIT_ASSERT(co_opt_offset <= opcache->oc_opcache_size, "");
-            co_opcache = &opcache->oc_opcache[co_opt_offset - 1];
+            co_opcache = &Dst->opcache_snapshot[co_opt_offset - 1];
             JIT_ASSERT(co_opcache != NULL, "");
         }
     }
     return co_opcache;
 }
 
+// 'entry' has to be part of the opcache snapshot
+static JitOpcacheFacts* get_opcache_facts(Jit* Dst, _PyOpcache* entry) {
+    JIT_ASSERT(entry >= Dst->opcache_snapshot && entry < Dst->opcache_snapshot + Dst->opcache_snapshot_size, "");
+    return &Dst->opcache_facts[entry - Dst->opcache_snapshot];
+}
+
+static int is_polymorphic_loadattr(int opcode, _PyOpcache* entry) {
+    return (opcode == LOAD_ATTR || opcode == LOAD_METHOD) && entry->u.la.cache_type == LA_CACHE_POLYMORPHIC;
+}
+
+// Precalculates the properties of the objects the opcache 'entry' of an 'opcode' instruction points to.
+static void calculate_opcache_facts(Jit* Dst, int opcode, _PyOpcache* entry) {
+    JitOpcacheFacts* facts = get_opcache_facts(Dst, entry);
+    if (!entry->optimized)
+        return;
+
+    PyObject* obj = NULL;
+    if (opcode == LOAD_GLOBAL || opcode == LOAD_NAME) {
+        _PyOpcache_LoadGlobal *lg = &entry->u.lg;
+        if (lg->cache_type == LG_GLOBAL)
+            obj = lg->u.global_cache.ptr;
+        else if (lg->cache_type == LG_BUILTIN)
+            obj = lg->u.builtin_cache.ptr;
+
+#if ENABLE_DIRECT_CALLS
+        if (obj && Py_TYPE(obj) == &PyFunction_Type) {
+            PyCodeObject* co = (PyCodeObject*)PyFunction_GET_CODE(obj);
+            if (co->co_kwonlyargcount == 0 &&
+                (co->co_flags & ~(PyCF_MASK | CO_NESTED)) == (CO_OPTIMIZED | CO_NEWLOCALS | CO_NOFREE)) {
+                facts->direct_call_code = co;
+                facts->direct_call_argcount = co->co_argcount;
+            }
+        }
+#endif
+    } else if (opcode == LOAD_ATTR || opcode == LOAD_METHOD) {
+        _PyOpcache_LoadAttr *la = &entry->u.la;
+        if (la->cache_type == LA_CACHE_VALUE_CACHE_DICT)
+            obj = la->u.value_cache.obj;
+        else if (la->cache_type == LA_CACHE_VALUE_CACHE_SPLIT_DICT)
+#ifdef NO_DKVERSION
+            obj = (PyObject*)(la->u.value_cache_split.obj_and_nentries & ~0xfLL);
+#else
+            obj = la->u.value_cache_split.obj;
+#endif
+        else if (la->cache_type == LA_CACHE_BUILTIN)
+            obj = la->u.builtin_cache.obj;
+    } else if (opcode == FOR_ITER) {
+        // emit_special_for_iter() only handles static types, which can be inspected without the GIL
+        PyTypeObject* type = entry->u.t.type;
+        if (type && (PyType_HasFeature(type, Py_TPFLAGS_HEAPTYPE) || type->tp_iternext == NULL))
+            entry->u.t.type = NULL;
+    }
+    facts->obj_immortal = obj != NULL && IS_IMMORTAL(obj);
+}
+
+// With JIT_ASYNC the machine code gets emitted without holding the GIL (see jit_func_impl()),
+// meanwhile the interpreter keeps updating the opcache and may free the objects it points to.
+// That's why the emitter only looks at this copy of the opcache (including the entries of polymorphic
+// LOAD_ATTR caches) plus the properties of the cached objects it needs, which get calculated here.
+// Has to get called with the GIL held. Returns -1 if we ran out of memory.
+static int create_opcache_snapshot(Jit* Dst) {
+    OpCache* opcache = Dst->opcache;
+    if (opcache->oc_opcache == NULL)
+        return 0;
+
+    // the entries of polymorphic caches get stored behind the entries of the opcache
+    int num_entries = opcache->oc_opcache_size;
+    for (int inst_idx = 0; inst_idx + 1 < Dst->num_opcodes; ++inst_idx) {
+        _PyOpcacheIdx co_opt_offset = opcache->oc_opcache_map[inst_idx + 1];
+        int opcode = _Py_OPCODE(Dst->first_instr[inst_idx]);
+        if (co_opt_offset > 0 && is_polymorphic_loadattr(opcode, &opcache->oc_opcache[co_opt_offset - 1]))
+            num_entries += opcache->oc_opcache[co_opt_offset - 1].u.la.u.poly_cache.num_used;
+    }
+
+    Dst->opcache_snapshot = (_PyOpcache*)malloc(num_entries * sizeof(_PyOpcache));
+    Dst->opcache_facts = (JitOpcacheFacts*)calloc(num_entries, sizeof(JitOpcacheFacts));
+    if (!Dst->opcache_snapshot || !Dst->opcache_facts)
+        return -1;
+    memcpy(Dst->opcache_snapshot, opcache->oc_opcache, opcache->oc_opcache_size * sizeof(_PyOpcache));
+    Dst->opcache_snapshot_size = num_entries;
+
+    int num_used = opcache->oc_opcache_size;
+    for (int inst_idx = 0; inst_idx < Dst->num_opcodes; ++inst_idx) {
+        _PyOpcache* entry = get_opcache_entry(Dst, inst_idx);
+        if (entry == NULL)
+            continue;
+        int opcode = _Py_OPCODE(Dst->first_instr[inst_idx]);
+        if (is_polymorphic_loadattr(opcode, entry)) {
+            _PyOpcache_LoadAttr *la = &entry->u.la;
+            _PyOpcache* caches = &Dst->opcache_snapshot[num_used];
+            memcpy(caches, la->u.poly_cache.caches, la->u.poly_cache.num_used * sizeof(_PyOpcache));
+            la->u.poly_cache.caches = caches;
+            la->u.poly_cache.num_entries = la->u.poly_cache.num_used;
+            num_used += la->u.poly_cache.num_used;
+            for (int i=0; i<la->u.poly_cache.num_used; ++i)
+                calculate_opcache_facts(Dst, opcode, &caches[i]);
+        }
+        calculate_opcache_facts(Dst, opcode, entry);
+    }
+    JIT_ASSERT(num_used == num_entries, "");
+    return 0;
+}
+
+#if ENABLE_DIRECT_CALLS
+// Checks if the callable of the CALL_FUNCTION at inst_idx got pushed by a LOAD_GLOBAL with a valid cache entry
+// and the arguments got each pushed by a single simple instruction (e.g. 'func(a, 1)').
+// Returns the code object of the cached function if it only takes the passed positional arguments
+// and can therefore get called via call_function_jit_direct(), else NULL.
+static PyCodeObject* get_direct_call_target(Jit* Dst, int inst_idx, int oparg) {
+    int callable_idx = inst_idx - oparg - 1;
+    if (callable_idx < 0 || _Py_OPCODE(Dst->first_instr[callable_idx]) != LOAD_GLOBAL)
+        return NULL;
+
+    for (int i = callable_idx + 1; i <= inst_idx; ++i) {
+        if (Dst->is_jmp_target[i])
+            return NULL;
+        int opcode = _Py_OPCODE(Dst->first_instr[i]);
+        if (i < inst_idx && opcode != LOAD_FAST && opcode != LOAD_CONST && opcode != LOAD_GLOBAL && opcode != LOAD_DEREF)
+            return NULL;
+    }
+
+    _PyOpcache* co_opcache = get_opcache_entry(Dst, callable_idx);
+    if (co_opcache == NULL || !co_opcache->optimized || co_opcache->num_failed)
+        return NULL;
+
+    // the function and code object got inspected by calculate_opcache_facts()
+    JitOpcacheFacts* facts = get_opcache_facts(Dst, co_opcache);
+    if (facts->direct_call_code == NULL || facts->direct_call_argcount != oparg)
+        return NULL;
+    return facts->direct_call_code;
+}
+#endif
+
+// Decrefs the top 'num_decrefs' values of the python value stack without popping them.
+// Preserves 'res'.
+static void emit_decref_stack_values(Jit* Dst, int num_decrefs) {
+    // Inlining the decrefs into the jitted code seems to help in some cases and hurt in others.
+    // For now use the heuristic that we'll inline a small
+    // number of decrefs into the jitted code.
+    // This could use more research.
+    int do_inline_decrefs = num_decrefs < 3;
+
+    if (!do_inline_decrefs) {
+        | mov tmp_preserved_reg, res
+        | mov arg1, vsp
+        if (num_decrefs == 3) {
+            emit_call_ext_func(Dst, decref_array3);
+        } else if (num_decrefs == 4) {
+            emit_call_ext_func(Dst, decref_array4);
+        } else {
+            emit_mov_imm(Dst, arg2_idx, num_decrefs);
+            emit_call_ext_func(Dst, decref_array);
+        }
+        | mov res, tmp_preserved_reg
+    } else {
+        for (int i = 0; i < num_decrefs; i++) {
+            emit_load64_mem(Dst, arg1_idx, vsp_idx, -(i + 1) * 8);
+            emit_decref(Dst, arg1_idx, 1 /* preserve res */);
+        }
+    }
+}
+
+#define ENABLE_CALL_CACHE USE_CALL_CACHE
+
+#if ENABLE_CALL_CACHE
+// Emits a guarded direct call for a CALL_FUNCTION or CALL_METHOD site whose call-site cache
+// got filled by the interpreter. Jumps to label 1 if one of the guards fails.
+// Returns 0 if code got emitted.
+static int emit_call_cache(Jit* Dst, int inst_idx, int opcode, int oparg) {
+    _PyOpcache* co_opcache = get_opcache_entry(Dst, inst_idx);
+    if (co_opcache == NULL || !co_opcache->optimized || co_opcache->num_failed)
+        return -1;
+
+    _PyOpcache_Call* cc = &co_opcache->u.call;
+    int num_args = cc->nargs; // number of arguments to the function, including a potential "self"
+    int num_vs_args = oparg + (opcode == CALL_METHOD ? 2 : 1); // number of python values the call removes from the stack
+
+    if (num_args != oparg && !(opcode == CALL_METHOD && num_args == oparg + 1))
+        return -1;
+
+    if (cc->cache_type == CALL_CACHE_PY_FUNC) {
+        if (!ENABLE_DIRECT_CALLS)
+            return -1;
+    } else if (cc->cache_type != CALL_CACHE_CFUNC) {
+        return -1;
+    }
+
+    if (opcode == CALL_METHOD) {
+        // LOAD_METHOD stores NULL below the callable if it did not find a method,
+        // we guard on the same stack layout the interpreter has seen.
+        emit_cmp64_mem_imm(Dst, vsp_idx, -8 * (oparg + 2), 0);
+        if (num_args == oparg) {
+            | branch_ne >1
+        } else {
+            | branch_eq >1
+        }
+    }
+
+    emit_load64_mem(Dst, arg1_idx, vsp_idx, -8 * (num_args + 1)); // callable
+    if (cc->cache_type == CALL_CACHE_PY_FUNC) {
+#if ENABLE_DIRECT_CALLS
+        // call_function_jit_direct() verifies the signature and consumes the references
+        | type_check arg1_idx, &PyFunction_Type, >1
+        emit_cmp64_mem_imm(Dst, arg1_idx, offsetof(PyFunctionObject, func_code), (uint64_t)cc->u.code);
+        | branch_ne >1
+
+        | mov arg1, tstate
+        | mov arg2, vsp
+        emit_mov_imm(Dst, arg3_idx, num_args);
+        emit_call_ext_func(Dst, call_function_jit_direct);
+#endif
+    } else {
+        // We load ml_meth at runtime instead of embedding it because the PyMethodDef is only
+        // guaranteed to be alive while a function object references it.
+        | type_check arg1_idx, &PyCFunction_Type, >1
+        emit_load64_mem(Dst, arg5_idx, arg1_idx, offsetof(PyCFunctionObject, m_ml));
+        emit_cmp64_imm(Dst, arg5_idx, (unsigned long)cc->u.ml);
+        | branch_ne >1
+        // the PyMethodDef may have been freed and its address reused for a different method
+        JIT_ASSERT(sizeof(((PyMethodDef*)0)->ml_flags) == 4, "");
+        emit_cmp32_mem_imm(Dst, arg5_idx, offsetof(PyMethodDef, ml_flags), cc->ml_flags);
+        | branch_ne >1
+
+        JIT_ASSERT(sizeof(((PyThreadState*)0)->use_tracing) == 4, "");
+        emit_cmp32_mem_imm(Dst, tstate_idx, offsetof(PyThreadState, use_tracing), 0);
+        | branch_ne >1
+
+        emit_load64_mem(Dst, arg1_idx, arg1_idx, offsetof(PyCFunctionObject, m_self));
+        if (cc->ml_flags == METH_NOARGS) {
+            emit_mov_imm(Dst, arg2_idx, 0);
+        } else if (cc->ml_flags == METH_O) {
+            emit_load64_mem(Dst, arg2_idx, vsp_idx, -8 * num_args);
+        } else {
+            emit_add_or_sub_imm(Dst, arg2_idx, vsp_idx, -8 * num_args);
+            emit_mov_imm(Dst, arg3_idx, num_args);
+            if (cc->ml_flags == (METH_FASTCALL | METH_KEYWORDS))
+                emit_mov_imm(Dst, arg4_idx, 0); // kwnames
+        }
+        emit_indirect_call(Dst, arg5_idx, offsetof(PyMethodDef, ml_meth), 0 /*don't ignore ret value*/);
+        emit_decref_stack_values(Dst, num_args + 1);
+    }
+    emit_adjust_vs(Dst, -num_vs_args);
+
+    if (opcode == CALL_METHOD) {
+        ++jit_stat_call_method_inline;
+        if (jit_stats_enabled)
+            emit_inc_qword_ptr(Dst, &jit_stat_call_method_hit, 1 /*=can use tmp_reg*/);
+    } else {
+        ++jit_stat_call_function_inline;
+        if (jit_stats_enabled)
+            emit_inc_qword_ptr(Dst, &jit_stat_call_function_hit, 1 /*=can use tmp_reg*/);
+    }
+    emit_if_res_0_error(Dst);
+    return 0;
+}
+#endif
+
 // returns 0 if generation succeeded
 static int emit_special_binary_subscr(Jit* Dst, int inst_idx, PyObject* const_val, RefStatus ref_status[2]) {
     if (!const_val || !PyLong_CheckExact(const_val)) {
         return -1;
     }
 
-    Py_ssize_t n = PyLong_AsSsize_t(const_val);
-    if (n == -1 && PyErr_Occurred()) {
-        PyErr_Clear();
+    // does not raise so it's fine without holding the GIL
+    int overflow;
+    Py_ssize_t n = PyLong_AsLongAndOverflow(const_val, &overflow);
+    if (overflow) {
         return -1;
     }
 
@@ -2507,9 +3251,10 @@ static int emit_special_store_subscr(Jit* Dst, int inst_idx, int opcode, int opa
         return -1;
     }
 
-    Py_ssize_t n = PyLong_AsSsize_t(const_val);
-    if (n == -1 && PyErr_Occurred()) {
-        PyErr_Clear();
+    // does not raise so it's fine without holding the GIL
+    int overflow;
+    Py_ssize_t n = PyLong_AsLongAndOverflow(const_val, &overflow);
+    if (overflow) {
         return -1;
     }
     if (n < 0 || ref_status[0] == OWNED /* this is the index/const_val object */) {
@@ -2549,34 +3294,242 @@ static int emit_special_store_subscr(Jit* Dst, int inst_idx, int opcode, int opa
 }
 
 // returns 0 if generation succeeded
-static int emit_special_compare_op(Jit* Dst, int oparg, RefStatus ref_status[2]) {
-#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 8
-    if (oparg != PyCmp_IS && oparg != PyCmp_IS_NOT) {
+static int emit_special_compare_op(Jit* Dst, int oparg, RefStatus ref_status[2]) {
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 8
+    if (oparg != PyCmp_IS && oparg != PyCmp_IS_NOT) {
+        return -1;
+    }
+    int is_cmp = oparg == PyCmp_IS;
+#else
+    // for 3.9 we only call this function from IS_OP which means this but be a IS or IS_NOT comparison.
+    // oparg==0 -> "is", oparg != 0 -> "is not"
+    int is_cmp = oparg == 0;
+#endif
+    emit_mov_imm2(Dst, res_idx, Py_True, tmp_idx, Py_False);
+    | cmp arg1, arg2
+    if (is_cmp) {
+@ARM    | csel res, res, tmp, eq
+@X86    | cmovne res, tmp
+    } else {
+@ARM    | csel res, res, tmp, ne
+@X86    | cmove res, tmp
+    }
+    // don't need to incref Py_True/Py_False because they are immortals
+    if (ref_status[0] == OWNED && ref_status[1] == OWNED)
+        emit_decref2(Dst, arg2_idx, arg1_idx, 1 /*= preserve res */);
+    else if (ref_status[0] == OWNED)
+        emit_decref(Dst, arg2_idx, 1 /*= preserve res */);
+    else if (ref_status[1] == OWNED)
+        emit_decref(Dst, arg1_idx, 1 /*= preserve res */);
+    deferred_vs_push(Dst, REGISTER, res_idx);
+    return 0;
+}
+
+// Inlines a COMPARE_OP if the opcache profiling only saw int, float or str operands of the same type.
+// Ints only get compared inline if they fit into a single digit, for floats we only handle the ordering
+// comparisons because == and != would need extra handling of unordered results.
+// Expects the left operand in arg1 and the right one in arg2.
+// returns 0 if generation succeeded
+static int emit_special_compare_op_typed(Jit* Dst, int inst_idx, int oparg, RefStatus ref_status[2]) {
+    if (oparg > Py_GE) {
+        return -1;
+    }
+    _PyOpcache* opcache = get_opcache_entry(Dst, inst_idx);
+    if (!opcache || !opcache->optimized) {
+        return -1;
+    }
+    PyTypeObject* type = opcache->u.t.type;
+    if (type != &PyLong_Type && type != &PyFloat_Type && type != &PyUnicode_Type) {
+        return -1;
+    }
+    if (type == &PyFloat_Type && (oparg == Py_EQ || oparg == Py_NE)) {
+        return -1;
+    }
+
+    ++jit_stat_compare_op_typed;
+
+    | type_check arg1_idx, type, >1
+    | type_check arg2_idx, type, >1
+
+    if (type == &PyUnicode_Type) {
+        if (oparg == Py_EQ || oparg == Py_NE) {
+            emit_call_decref_args2(Dst, _PyUnicode_EQ, arg2_idx, arg1_idx, ref_status);
+            emit_convert_res32_to_pybool(Dst, oparg == Py_NE /*=invert*/);
+        } else {
+            emit_mov_imm(Dst, arg3_idx, oparg);
+            emit_call_decref_args2(Dst, PyUnicode_RichCompare, arg2_idx, arg1_idx, ref_status);
+            emit_if_res_0_error(Dst);
+        }
+    } else {
+        if (type == &PyFloat_Type) {
+            const int offset_fval = offsetof(PyFloatObject, ob_fval);
+@ARM        | ldr d0, [arg1, #offset_fval]
+@ARM        | ldr d1, [arg2, #offset_fval]
+@X86        | movsd xmm0, qword [arg1+offset_fval]
+@X86        | movsd xmm1, qword [arg2+offset_fval]
+            emit_mov_imm2(Dst, res_idx, Py_True, tmp_idx, Py_False);
+            // select Py_False if the condition is not met,
+            // unordered results (NaN) have to compare false
+@ARM        | fcmp d0, d1
+            if (oparg == Py_LT) {
+@ARM            | csel res, res, tmp, mi
+@X86            | ucomisd xmm1, xmm0
+@X86            | cmovbe res, tmp
+            } else if (oparg == Py_LE) {
+@ARM            | csel res, res, tmp, ls
+@X86            | ucomisd xmm1, xmm0
+@X86            | cmovb res, tmp
+            } else if (oparg == Py_GT) {
+@ARM            | csel res, res, tmp, gt
+@X86            | ucomisd xmm0, xmm1
+@X86            | cmovbe res, tmp
+            } else {
+@ARM            | csel res, res, tmp, ge
+@X86            | ucomisd xmm0, xmm1
+@X86            | cmovb res, tmp
+            }
+        } else {
+            // only handle ints with ob_size of -1, 0 or 1: value = ob_size * ob_digit[0]
+            _Static_assert(sizeof(digit) == 4 && PyLong_SHIFT <= 31,  "load32 needs to be modified");
+            const int offset_size = offsetof(PyVarObject, ob_size);
+            const int offset_digit = offsetof(PyLongObject, ob_digit);
+            int regs[] = { arg1_idx, arg2_idx };
+            int regs_val[] = { arg3_idx, arg4_idx };
+            for (int i=0; i<2; ++i) {
+                emit_load64_mem(Dst, regs_val[i], regs[i], offset_size);
+                emit_add_or_sub_imm(Dst, arg5_idx, regs_val[i], 1);
+                emit_cmp64_imm(Dst, arg5_idx, 2);
+                | branch_gt_unsigned >1
+                // zero has no digits, its value is already in the register
+                emit_cmp64_imm(Dst, regs_val[i], 0);
+                | branch_eq >3
+                emit_load32_mem(Dst, arg5_idx, regs[i], offset_digit);
+@ARM            | mul Rx(regs_val[i]), Rx(regs_val[i]), Rx(arg5_idx)
+@X86            | imul Rq(regs_val[i]), Rq(arg5_idx)
+                |3:
+            }
+            emit_mov_imm2(Dst, res_idx, Py_True, tmp_idx, Py_False);
+            | cmp arg3, arg4
+            // select Py_False if the condition is not met
+            if (oparg == Py_LT) {
+@ARM            | csel res, res, tmp, lt
+@X86            | cmovge res, tmp
+            } else if (oparg == Py_LE) {
+@ARM            | csel res, res, tmp, le
+@X86            | cmovg res, tmp
+            } else if (oparg == Py_EQ) {
+@ARM            | csel res, res, tmp, eq
+@X86            | cmovne res, tmp
+            } else if (oparg == Py_NE) {
+@ARM            | csel res, res, tmp, ne
+@X86            | cmove res, tmp
+            } else if (oparg == Py_GT) {
+@ARM            | csel res, res, tmp, gt
+@X86            | cmovle res, tmp
+            } else {
+@ARM            | csel res, res, tmp, ge
+@X86            | cmovl res, tmp
+            }
+        }
+        // don't need to incref Py_True/Py_False because they are immortals
+        if (ref_status[0] == OWNED && ref_status[1] == OWNED)
+            emit_decref2(Dst, arg2_idx, arg1_idx, 1 /*= preserve res */);
+        else if (ref_status[0] == OWNED)
+            emit_decref(Dst, arg2_idx, 1 /*= preserve res */);
+        else if (ref_status[1] == OWNED)
+            emit_decref(Dst, arg1_idx, 1 /*= preserve res */);
+    }
+    if (jit_stats_enabled) {
+        emit_inc_qword_ptr(Dst, &jit_stat_compare_op_typed_hit, 0 /*=can't use tmp_reg*/);
+    }
+
+    // slowpath
+    {
+        switch_section(Dst, SECTION_COLD);
+        |1:
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION <= 8
+        void* func = get_aot_func_addr(Dst, COMPARE_OP, oparg, 0 /*= no op cache */);
+#else
+        void* func = PyObject_RichCompare;
+        emit_mov_imm(Dst, arg3_idx, oparg);
+#endif
+        emit_call_decref_args2(Dst, func, arg2_idx, arg1_idx, ref_status);
+        emit_if_res_0_error(Dst);
+        if (jit_stats_enabled) {
+            emit_inc_qword_ptr(Dst, &jit_stat_compare_op_typed_miss, 0 /*=can't use tmp_reg*/);
+        }
+        | branch >2
+        switch_section(Dst, SECTION_CODE);
+    }
+    |2:
+
+    deferred_vs_push(Dst, REGISTER, res_idx);
+    return 0;
+}
+
+// Emits the fast path of a FOR_ITER for the iterator type the opcache profiling saw:
+// list and range iterators get iterated inline, other builtin iterators get a direct call
+// of their tp_iternext instead of the indirect one.
+// Expects the iterator in arg1 and leaves the next item (or NULL) in res.
+// Jumps to label 3 if the iterator has a different type or the inline
+// iteration needs the generic tp_iternext (e.g. because the list got exhausted).
+// returns 0 if generation succeeded
+static int emit_special_for_iter(Jit* Dst, int inst_idx) {
+    _PyOpcache* opcache = get_opcache_entry(Dst, inst_idx);
+    if (!opcache || !opcache->optimized) {
         return -1;
     }
-    int is_cmp = oparg == PyCmp_IS;
-#else
-    // for 3.9 we only call this function from IS_OP which means this but be a IS or IS_NOT comparison.
-    // oparg==0 -> "is", oparg != 0 -> "is not"
-    int is_cmp = oparg == 0;
-#endif
-    emit_mov_imm2(Dst, res_idx, Py_True, tmp_idx, Py_False);
-    | cmp arg1, arg2
-    if (is_cmp) {
-@ARM    | csel res, res, tmp, eq
-@X86    | cmovne res, tmp
+    // calculate_opcache_facts() cleared the type if it's not a static type with a tp_iternext
+    PyTypeObject* type = opcache->u.t.type;
+    if (type == NULL) {
+        return -1;
+    }
+
+    ++jit_stat_for_iter_inline;
+
+    | type_check arg1_idx, type, >3
+    if (type == &PyListIter_Type) {
+        // if (it->it_seq == NULL || it->it_index >= Py_SIZE(it->it_seq)) goto generic
+        emit_load64_mem(Dst, arg2_idx, arg1_idx, offsetof(_PyListIterObject, it_seq));
+        emit_cmp64_imm(Dst, arg2_idx, 0);
+        | branch_eq >3
+        emit_load64_mem(Dst, arg3_idx, arg1_idx, offsetof(_PyListIterObject, it_index));
+        emit_load64_mem(Dst, arg4_idx, arg2_idx, offsetof(PyVarObject, ob_size));
+        | cmp arg3, arg4
+        | branch_ge >3
+
+        // res = it->it_seq->ob_item[it->it_index++]
+        emit_load64_mem(Dst, arg4_idx, arg2_idx, offsetof(PyListObject, ob_item));
+@ARM    | ldr res, [arg4, arg3, lsl #3]
+@X86    | mov res, [arg4 + arg3*8]
+        emit_add_or_sub_imm(Dst, arg3_idx, arg3_idx, 1);
+        emit_store64_mem(Dst, arg3_idx, arg1_idx, offsetof(_PyListIterObject, it_index));
+        emit_incref(Dst, res_idx);
+    } else if (type == &PyRangeIter_Type) {
+        // if (r->index >= r->len) goto generic
+        emit_load64_mem(Dst, arg2_idx, arg1_idx, offsetof(_PyRangeIterObject, index));
+        emit_load64_mem(Dst, arg3_idx, arg1_idx, offsetof(_PyRangeIterObject, len));
+        | cmp arg2, arg3
+        | branch_ge >3
+
+        // res = PyLong_FromLong(r->start + r->index++ * r->step)
+        emit_add_or_sub_imm(Dst, arg3_idx, arg2_idx, 1);
+        emit_store64_mem(Dst, arg3_idx, arg1_idx, offsetof(_PyRangeIterObject, index));
+        emit_load64_mem(Dst, arg3_idx, arg1_idx, offsetof(_PyRangeIterObject, step));
+@ARM    | mul arg2, arg2, arg3
+@X86    | imul arg2, arg3
+        emit_load64_mem(Dst, arg3_idx, arg1_idx, offsetof(_PyRangeIterObject, start));
+@ARM    | add arg1, arg2, arg3
+@X86    | add arg2, arg3
+@X86    | mov arg1, arg2
+        emit_call_ext_func(Dst, PyLong_FromLong);
+        emit_if_res_0_error(Dst);
     } else {
-@ARM    | csel res, res, tmp, ne
-@X86    | cmove res, tmp
+        emit_call_ext_func(Dst, type->tp_iternext);
+    }
+    if (jit_stats_enabled) {
+        emit_inc_qword_ptr(Dst, &jit_stat_for_iter_hit, 0 /*=can't use tmp_reg*/);
     }
-    // don't need to incref Py_True/Py_False because they are immortals
-    if (ref_status[0] == OWNED && ref_status[1] == OWNED)
-        emit_decref2(Dst, arg2_idx, arg1_idx, 1 /*= preserve res */);
-    else if (ref_status[0] == OWNED)
-        emit_decref(Dst, arg2_idx, 1 /*= preserve res */);
-    else if (ref_status[1] == OWNED)
-        emit_decref(Dst, arg1_idx, 1 /*= preserve res */);
-    deferred_vs_push(Dst, REGISTER, res_idx);
     return 0;
 }
 
@@ -2603,6 +3556,10 @@ static int emit_inline_cache_loadattr_supported(_PyOpcache *co_opcache, _PyOpcac
     if (!co_opcache->optimized)
         return 0;
 
+    // megamorphic sites call the helper which looks up the process-wide cache
+    if (la->cache_type == LA_CACHE_MEGAMORPHIC)
+        return 0;
+
     int version_zero = emit_inline_cache_loadattr_is_version_zero(la);
     if (la->cache_type != LA_CACHE_BUILTIN && la->cache_type != LA_CACHE_DATA_DESCR && la->cache_type != LA_CACHE_SLOT_CACHE) {
         // fail the cache if dictoffset<0 rather than do the lengthier dict_ptr computation
@@ -2805,7 +3762,9 @@ static void emit_inline_cache_loadattr_entry(Jit* Dst, int opcode, int oparg, _P
             | branch_ne >1
         }
 
-        if (!IS_IMMORTAL(obj))
+        // 'la' is the first member of its (snapshot) opcache entry
+        _Static_assert(offsetof(_PyOpcache, u) == 0, "cast needs to be modified");
+        if (!get_opcache_facts(Dst, (_PyOpcache*)la)->obj_immortal)
             emit_incref(Dst, res_idx);
     }
     else if (la->cache_type == LA_CACHE_IDX_SPLIT_DICT) {
@@ -2958,6 +3917,134 @@ static int emit_special_binary_op_inplace(Jit* Dst, int inst_idx, int opcode, in
     return 0;
 }
 
+// Speculatively emits the arithmetic inline for the operand type the opcache profiling saw
+// (float or int which fits into a single digit) and only boxes the result.
+// This is used when we can't modify one of the operands inplace.
+// If the type guards fail we fall back to the generic implementation.
+// returns 0 if generation succeeded
+static int emit_special_binary_op_unboxed(Jit* Dst, int inst_idx, int opcode, int oparg, RefStatus ref_status_left, RefStatus ref_status_right, PyObject* const_right_val) {
+    switch (opcode) {
+        case BINARY_ADD:
+        case BINARY_SUBTRACT:
+        case BINARY_MULTIPLY:
+
+        case INPLACE_ADD:
+        case INPLACE_SUBTRACT:
+        case INPLACE_MULTIPLY:
+            break;
+
+        default:
+            return -1;
+    }
+    _PyOpcache* opcache = get_opcache_entry(Dst, inst_idx);
+    if (!opcache || !opcache->optimized) {
+        return -1;
+    }
+    PyTypeObject* type = opcache->u.t_refcnt.type;
+    if (type != &PyFloat_Type && type != &PyLong_Type) {
+        return -1;
+    }
+
+    ++jit_stat_binary_op_unboxed;
+
+    RefStatus ref_status[] = { ref_status_right, ref_status_left };
+
+    | type_check arg1_idx, type, >1
+    if (!const_right_val || Py_TYPE(const_right_val) != type) {
+        | type_check arg2_idx, type, >1
+    }
+
+    if (type == &PyFloat_Type) {
+        const int offset_fval = offsetof(PyFloatObject, ob_fval);
+@ARM    | ldr d0, [arg1, #offset_fval]
+@ARM    | ldr d1, [arg2, #offset_fval]
+@X86    | movsd xmm0, qword [arg1+offset_fval]
+        if (opcode == BINARY_ADD || opcode == INPLACE_ADD) {
+@ARM        | fadd d0, d0, d1
+@X86        | addsd xmm0, qword [arg2+offset_fval]
+        } else if (opcode == BINARY_SUBTRACT || opcode == INPLACE_SUBTRACT) {
+@ARM        | fsub d0, d0, d1
+@X86        | subsd xmm0, qword [arg2+offset_fval]
+        } else if (opcode == BINARY_MULTIPLY || opcode == INPLACE_MULTIPLY) {
+@ARM        | fmul d0, d0, d1
+@X86        | mulsd xmm0, qword [arg2+offset_fval]
+        } else {
+            JIT_ASSERT(0, "");
+        }
+        // the result is passed in the first floating point register and
+        // emit_call_decref_args does not touch it.
+        emit_call_decref_args2(Dst, PyFloat_FromDouble, arg2_idx, arg1_idx, ref_status);
+    } else {
+        // only handle ints with ob_size of -1, 0 or 1: value = ob_size * ob_digit[0]
+        // the result of the operation always fits into 64bit.
+        _Static_assert(sizeof(digit) == 4 && PyLong_SHIFT <= 31,  "load32 needs to be modified");
+        const int offset_size = offsetof(PyVarObject, ob_size);
+        const int offset_digit = offsetof(PyLongObject, ob_digit);
+        int regs[] = { arg1_idx, arg2_idx };
+        int regs_val[] = { arg3_idx, arg4_idx };
+        for (int i=0; i<2; ++i) {
+            emit_load64_mem(Dst, regs_val[i], regs[i], offset_size);
+            emit_add_or_sub_imm(Dst, arg5_idx, regs_val[i], 1);
+            emit_cmp64_imm(Dst, arg5_idx, 2);
+            | branch_gt_unsigned >1
+            // zero has no digits, its value is already in the register
+            emit_cmp64_imm(Dst, regs_val[i], 0);
+            | branch_eq >3
+            emit_load32_mem(Dst, arg5_idx, regs[i], offset_digit);
+@ARM        | mul Rx(regs_val[i]), Rx(regs_val[i]), Rx(arg5_idx)
+@X86        | imul Rq(regs_val[i]), Rq(arg5_idx)
+            |3:
+        }
+        if (opcode == BINARY_ADD || opcode == INPLACE_ADD) {
+@ARM        | add res, arg3, arg4
+@X86        | add arg3, arg4
+        } else if (opcode == BINARY_SUBTRACT || opcode == INPLACE_SUBTRACT) {
+@ARM        | sub res, arg3, arg4
+@X86        | sub arg3, arg4
+        } else if (opcode == BINARY_MULTIPLY || opcode == INPLACE_MULTIPLY) {
+@ARM        | mul res, arg3, arg4
+@X86        | imul arg3, arg4
+        } else {
+            JIT_ASSERT(0, "");
+        }
+@X86    emit_mov64_reg(Dst, res_idx, arg3_idx);
+
+        // the operands are not needed anymore: decref them first while preserving 'res'
+        // which means we don't have to find a callee saved location for them.
+        if (ref_status_left == OWNED && ref_status_right == OWNED) {
+            emit_decref2(Dst, arg1_idx, arg2_idx, 1 /* preserve res */);
+        } else if (ref_status_left == OWNED) {
+            emit_decref(Dst, arg1_idx, 1 /* preserve res */);
+        } else if (ref_status_right == OWNED) {
+            emit_decref(Dst, arg2_idx, 1 /* preserve res */);
+        }
+        emit_mov64_reg(Dst, arg1_idx, res_idx);
+        emit_call_ext_func(Dst, PyLong_FromLong);
+    }
+    emit_if_res_0_error(Dst);
+    if (jit_stats_enabled) {
+        emit_inc_qword_ptr(Dst, &jit_stat_binary_op_unboxed_hit, 0 /*=can't use tmp_reg*/);
+    }
+
+    // slowpath
+    {
+        switch_section(Dst, SECTION_COLD);
+        |1:
+        void* func = get_aot_func_addr(Dst, opcode, oparg, 0 /*= no op cache */);
+        emit_call_decref_args2(Dst, func, arg2_idx, arg1_idx, ref_status);
+        emit_if_res_0_error(Dst);
+        if (jit_stats_enabled) {
+            emit_inc_qword_ptr(Dst, &jit_stat_binary_op_unboxed_miss, 0 /*=can't use tmp_reg*/);
+        }
+        | branch >2
+        switch_section(Dst, SECTION_CODE);
+    }
+    |2:
+
+    deferred_vs_push(Dst, REGISTER, res_idx);
+    return 0;
+}
+
 // Same signature as PyUnicode_Append
 // except that it only handles the case where pleft refcnt = 1
 static void list_append(PyObject **pleft, PyObject *right) {
@@ -3081,6 +4168,31 @@ static int emit_special_concat_inplace(Jit* Dst, int inst_idx, int opcode, int o
 }
 
 // returns 0 if IC generation succeeded
+void jit_ic_budget_exhausted(PyFrameObject* f);
+
+// emitted in the slow path of an inline cache after the helper call
+// decrements the miss budget of the function and if it reaches zero
+// marks the function for recompilation (the machine code does not get freed
+// so this frame will just continue running the old code).
+// preserves res
+static void emit_ic_miss_count(Jit* Dst) {
+    if (!Dst->ic_miss_budget)
+        return;
+
+    emit_mov_imm(Dst, tmp_idx, (unsigned long)Dst->ic_miss_budget);
+@ARM| ldr tmp2, [tmp]
+@ARM| subs tmp2, tmp2, #1    // must use instruction which sets the flags!
+@ARM| str tmp2, [tmp]
+@X86| add qword [tmp], -1
+    // the budget only hits zero once, afterwards it's negative and we don't call the helper again
+    | branch_nz >7
+    | mov tmp_preserved_reg, res
+    | mov arg1, f
+    emit_call_ext_func(Dst, jit_ic_budget_exhausted);
+    | mov res, tmp_preserved_reg
+    |7:
+}
+
 static int emit_inline_cache(Jit* Dst, int opcode, int oparg, _PyOpcache* co_opcache) {
     if (co_opcache == NULL || !jit_use_ics)
         return 1;
@@ -3130,7 +4242,7 @@ static int emit_inline_cache(Jit* Dst, int opcode, int oparg, _PyOpcache* co_opc
                 | branch_ne >1
 
                 emit_mov_imm(Dst, res_idx, (uint64_t)lg->u.global_cache.ptr);
-                if (!IS_IMMORTAL(lg->u.global_cache.ptr))
+                if (!get_opcache_facts(Dst, co_opcache)->obj_immortal)
                     emit_incref(Dst, res_idx);
 
             } else if (lg->cache_type == LG_BUILTIN) {
@@ -3142,7 +4254,7 @@ static int emit_inline_cache(Jit* Dst, int opcode, int oparg, _PyOpcache* co_opc
                 | branch_ne >1
 
                 emit_mov_imm(Dst, res_idx, (uint64_t)lg->u.builtin_cache.ptr);
-                if (!IS_IMMORTAL(lg->u.builtin_cache.ptr))
+                if (!get_opcache_facts(Dst, co_opcache)->obj_immortal)
                     emit_incref(Dst, res_idx);
 
             } else if (lg->cache_type == LG_GLOBAL_OFFSET) {
@@ -3167,6 +4279,29 @@ static int emit_inline_cache(Jit* Dst, int opcode, int oparg, _PyOpcache* co_opc
                 emit_load64_mem(Dst, res_idx, arg3_idx, offsetof(PyDictKeyEntry, me_value));
                 emit_incref(Dst, res_idx);
 
+#ifndef NO_DKVERSION
+            } else if (lg->cache_type == LG_GLOBAL_KEYS_VERSION || lg->cache_type == LG_BUILTIN_KEYS_VERSION) {
+                // if (globals->ma_keys->dk_version_tag != globals_keys_ver) goto slow_path;
+                emit_load64_mem(Dst, res_idx, arg3_idx, offsetof(PyDictObject, ma_keys));
+                emit_cmp64_mem_imm(Dst, res_idx, offsetof(PyDictKeysObject, dk_version_tag), (uint64_t)lg->u.keys_version_cache.globals_keys_ver);
+                | branch_ne >1
+
+                if (lg->cache_type == LG_BUILTIN_KEYS_VERSION) {
+                    // if (builtins->ma_keys->dk_version_tag != builtins_keys_ver) goto slow_path;
+                    emit_load64_mem(Dst, arg3_idx, f_idx, offsetof(PyFrameObject, f_builtins));
+                    emit_load64_mem(Dst, res_idx, arg3_idx, offsetof(PyDictObject, ma_keys));
+                    emit_cmp64_mem_imm(Dst, res_idx, offsetof(PyDictKeysObject, dk_version_tag), (uint64_t)lg->u.keys_version_cache.builtins_keys_ver);
+                    | branch_ne >1
+                }
+
+                // res = *(PyObject**)((char*)keys + offset);
+                emit_load64_mem(Dst, res_idx, res_idx, lg->u.keys_version_cache.offset);
+                // split dicts don't store the values in the entries
+                emit_cmp64_imm(Dst, res_idx, 0);
+                | branch_eq >1
+                emit_incref(Dst, res_idx);
+#endif
+
             } else {
                 abort();
             }
@@ -3188,6 +4323,7 @@ static int emit_inline_cache(Jit* Dst, int opcode, int oparg, _PyOpcache* co_opc
             // we always use LOAD_GLOBAL here even for LOAD_NAME
             emit_call_ext_func(Dst, get_aot_func_addr(Dst, LOAD_GLOBAL, oparg, co_opcache != 0 /*= use op cache */));
             emit_if_res_0_error(Dst);
+            emit_ic_miss_count(Dst);
             | branch <4 // jump to the common code which pushes the result
             // Switch back to the normal section
             switch_section(Dst, SECTION_CODE);
@@ -3250,7 +4386,8 @@ static int emit_inline_cache(Jit* Dst, int opcode, int oparg, _PyOpcache* co_opc
                     ++jit_stat_load_method_poly;
                 }
                 int first = 1;
-                for (int i=0, num=la->u.poly_cache.num_used; i<num; ++i) {
+                int num_emitted = 0;
+                for (int i=0, num=la->u.poly_cache.num_used; i<num && num_emitted<JIT_MAX_POLY_INLINE_ENTRIES; ++i) {
                     _PyOpcache *co_opcache_entry = &la->u.poly_cache.caches[i];
                     _PyOpcache_LoadAttr *la_entry = &co_opcache_entry->u.la;
                     if (co_opcache_entry->num_failed != 0) {
@@ -3284,6 +4421,7 @@ static int emit_inline_cache(Jit* Dst, int opcode, int oparg, _PyOpcache* co_opc
                     }
                     emit_inline_cache_loadattr_entry(Dst, opcode, oparg, la_entry, &emit_load_attr_res_0_helper);
                     first = 0;
+                    ++num_emitted;
                 }
                 if (first == 1) {
                     // make sure that we emit at least one entry else we would generate invalid code
@@ -3336,6 +4474,7 @@ static int emit_inline_cache(Jit* Dst, int opcode, int oparg, _PyOpcache* co_opc
                 }
                 emit_call_ext_func(Dst, get_aot_func_addr(Dst, opcode, oparg, co_opcache != 0 /*= use op cache */));
                 emit_if_res_0_error(Dst);
+                emit_ic_miss_count(Dst);
                 | branch <5 // jump to the common code which pushes the result
 
                 if (emit_load_attr_res_0_helper) { // we only emit this code if it's used
@@ -3464,6 +4603,7 @@ static int emit_inline_cache(Jit* Dst, int opcode, int oparg, _PyOpcache* co_opc
 
                 emit_call_ext_func(Dst, get_aot_func_addr(Dst, opcode, oparg, co_opcache != 0 /*= use op cache */));
                 emit_if_res_0_error(Dst);
+                emit_ic_miss_count(Dst);
                 | branch <5 // jump to the common code which pushes the result
                 switch_section(Dst, SECTION_CODE);
             }
@@ -3525,6 +4665,26 @@ static void emit_instr_start(Jit* Dst, int inst_idx, int opcode, int oparg) {
                 return;
             break;
 
+        // this opcodes can't raise or call into python code so nobody can observe f_lasti.
+        // The destination of the jump will do the signal check.
+        case JUMP_FORWARD:
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION >= 8
+        case POP_BLOCK:
+#endif
+#if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION == 8
+        case BEGIN_FINALLY:
+#endif
+            // only avoid check if we already generated one for the current line.
+            if (Dst->emitted_trace_check_for_line)
+                return;
+            break;
+
+        case JUMP_ABSOLUTE:
+            // backward jumps need the signal check else a loop could not get interrupted
+            if (oparg > inst_idx * INST_IDX_TO_LASTI_FACTOR && Dst->emitted_trace_check_for_line)
+                return;
+            break;
+
 #endif // ENABLE_AVOID_SIG_TRACE_CHECK
     }
 
@@ -3672,19 +4832,17 @@ static void emit_instr_start(Jit* Dst, int inst_idx, int opcode, int oparg) {
 #if JIT_DEBUG
 __attribute__((optimize("-O0"))) // enable to make "source tools/dis_jit_gdb.py" work
 #endif
-#ifdef PYSTON_LITE
-void* jit_func_lite(PyCodeObject* co, PyThreadState* tstate) {
-#else
-void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
-#endif
+// Has to get called with the GIL held.
+// If 'release_gil' is set the GIL gets released while emitting the machine code (used by JIT_ASYNC),
+// all the state the emitter looks at gets copied before.
+static void* jit_func_impl(PyCodeObject* co, PyThreadState* tstate, int release_gil) {
     if (mem_bytes_used_max <= mem_bytes_used) // stop emitting code we used up all memory
         return NULL;
 
     int success = 0;
 
     struct timespec compilation_start;
-    if (jit_stats_enabled)
-        clock_gettime(CLOCK_MONOTONIC, &compilation_start);
+    clock_gettime(CLOCK_MONOTONIC, &compilation_start);
 
     // setup jit context, will get accessed from all dynasm functions via the name 'Dst'
     Jit jit;
@@ -3695,11 +4853,37 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
     jit.current_section = -1;
 
     jit.opcache = _PyCode_GetOpcache(co);
+    jit.interp = tstate->interp;
+
+    jit.func_data = (JitFuncData*)calloc(1, sizeof(JitFuncData));
+    if (!jit.func_data)
+        return NULL;
+    if (jit_use_ics && jit.opcache->oc_jit_num_recompiles < JIT_MAX_RECOMPILES) {
+        jit.func_data->ic_miss_budget = (long)JIT_IC_MISS_BUDGET << jit.opcache->oc_jit_num_recompiles;
+        jit.func_data->ic_miss_budget_initial = jit.func_data->ic_miss_budget;
+        jit.func_data->ic_miss_budget_enabled = 1;
+        jit.ic_miss_budget = &jit.func_data->ic_miss_budget;
+    }
+    if (jit.opcache->oc_jit_num_recompiles)
+        ++jit_stat_ic_recompiles;
 
     jit.num_opcodes = PyBytes_Size(co->co_code)/sizeof(_Py_CODEUNIT);
     jit.first_instr = (_Py_CODEUNIT *)PyBytes_AS_STRING(co->co_code);
 
     Jit* Dst = &jit;
+    if (create_opcache_snapshot(Dst) < 0) {
+        free(jit.opcache_snapshot);
+        free(jit.opcache_facts);
+        free(jit.func_data);
+        return NULL;
+    }
+
+    // From here until dasm_link() we only look at the code object and the opcache snapshot:
+    // the bytecode, the opcache map, co_consts and co_names are immutable and the caller keeps the code object alive.
+    // The constants are only inspected by deferred_vs_push() etc. via IS_IMMORTAL() which can't change.
+    // The statistic counters we increment may lose some updates if another thread compiles at the same time.
+    PyThreadState* released_tstate = release_gil ? PyEval_SaveThread() : NULL;
+
     dasm_init(Dst, DASM_MAXSECTION);
     void* labels[lbl__MAX];
     dasm_setupglobal(Dst, labels, lbl__MAX);
@@ -3717,7 +4901,7 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
 
 #if ENABLE_DEFINED_TRACKING
     jit.known_defined = (char*)malloc(co->co_nlocals);
-    const int funcs_args_are_always_defined = check_func_args_never_deleted(Dst);
+    calculate_defined_at_jmp_targets(Dst);
 #endif
 
     // did we emit the * label already?
@@ -3751,12 +4935,10 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
 
 #if ENABLE_DEFINED_TRACKING
         // if we can jump to this opcode or it's the first in the function
-        // we reset the definedness info.
+        // we reset the definedness info to what is known for all paths reaching it.
         if ((inst_idx == 0 || Dst->is_jmp_target[inst_idx])) {
-            memset(Dst->known_defined, 0, co->co_nlocals);
-            for (int i=0; funcs_args_are_always_defined && i<co->co_argcount; ++i) {
-                Dst->known_defined[i] = 1; // function arg is defined
-            }
+            int state_idx = Dst->jmp_target_state_idx[inst_idx];
+            memcpy(Dst->known_defined, &Dst->defined_at_jmp_target[state_idx * co->co_nlocals], co->co_nlocals);
         }
 #endif
 
@@ -4042,12 +5224,18 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
             if (opcode == COMPARE_OP && emit_special_compare_op(Dst, oparg, ref_status) == 0) {
                 break; // we are finished
             }
+            if (opcode == COMPARE_OP && emit_special_compare_op_typed(Dst, inst_idx, oparg, ref_status) == 0) {
+                break; // we are finished
+            }
             if (emit_special_binary_op_inplace(Dst, inst_idx, opcode, oparg, ref_status[1], ref_status[0], load_store_left_idx, const_val) == 0) {
                 break; // we are finished
             }
             if (emit_special_concat_inplace(Dst, inst_idx, opcode, oparg, ref_status[1], ref_status[0], load_store_left_idx, const_val) == 0) {
                 break; // we are finished
             }
+            if (emit_special_binary_op_unboxed(Dst, inst_idx, opcode, oparg, ref_status[1], ref_status[0], const_val) == 0) {
+                break; // we are finished
+            }
             // generic path
             |1:
             void* func = get_aot_func_addr(Dst, opcode, oparg, 0 /*= no op cache */);
@@ -4129,6 +5317,7 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
                         PyMethodDescrObject* method = (PyMethodDescrObject*)hint->attr;
                         void* funcptr = method->d_method->ml_meth;
 
+                        // hint->type is a static type (LA_CACHE_BUILTIN) so its mro can't change while we don't hold the GIL
                         if (funcptr && _PyObject_RealIsSubclass((PyObject*)hint->type, (PyObject *)PyDescr_TYPE(method))) {
                             wrote_inline_cache = 1;
                             // Strategy:
@@ -4216,31 +5405,7 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
                             int num_decrefs = num_vs_args;
                             if (IS_IMMORTAL(hint->attr))
                                 num_decrefs--;
-
-                            // Inlining the decrefs into the jitted code seems to help in some cases and hurt in others.
-                            // For now use the heuristic that we'll inline a small
-                            // number of decrefs into the jitted code.
-                            // This could use more research.
-                            int do_inline_decrefs = num_decrefs < 3;
-
-                            if (!do_inline_decrefs) {
-                                | mov tmp_preserved_reg, res
-                                | mov arg1, vsp
-                                if (num_decrefs == 3) {
-                                    emit_call_ext_func(Dst, decref_array3);
-                                } else if (num_decrefs == 4) {
-                                    emit_call_ext_func(Dst, decref_array4);
-                                } else {
-                                    emit_mov_imm(Dst, arg2_idx, num_decrefs);
-                                    emit_call_ext_func(Dst, decref_array);
-                                }
-                                | mov res, tmp_preserved_reg
-                            } else {
-                                for (int i = 0; i < num_decrefs; i++) {
-                                    emit_load64_mem(Dst, arg1_idx, vsp_idx, -(i + 1) * 8);
-                                    emit_decref(Dst, arg1_idx, 1 /* preserve res */);
-                                }
-                            }
+                            emit_decref_stack_values(Dst, num_decrefs);
                             emit_adjust_vs(Dst, -num_vs_args);
                             if (jit_stats_enabled) {
                                 emit_inc_qword_ptr(Dst, &jit_stat_call_method_hit, 1 /*=can use tmp_reg*/);
@@ -4255,12 +5420,47 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
                     free(hint);
             }
 
+            if (opcode == CALL_FUNCTION)
+                ++jit_stat_call_function_total;
+
+#if ENABLE_CALL_CACHE
+            if (!wrote_inline_cache && opcode != CALL_FUNCTION_KW && jit_use_ics)
+                wrote_inline_cache = emit_call_cache(Dst, inst_idx, opcode, oparg) == 0;
+#endif
+
+#if ENABLE_DIRECT_CALLS
+            if (opcode == CALL_FUNCTION && !wrote_inline_cache) {
+                PyCodeObject* callee_co = jit_use_ics ? get_direct_call_target(Dst, inst_idx, oparg) : NULL;
+                if (callee_co) {
+                    // Guard that the callable is still a function with the same code object
+                    // and call the helper which can directly enter the JIT compiled callee.
+                    wrote_inline_cache = 1;
+                    ++jit_stat_call_function_inline;
+
+                    emit_load64_mem(Dst, arg1_idx, vsp_idx, -8 * (oparg + 1));
+                    | type_check arg1_idx, &PyFunction_Type, >1
+                    emit_cmp64_mem_imm(Dst, arg1_idx, offsetof(PyFunctionObject, func_code), (uint64_t)callee_co);
+                    | branch_ne >1
+
+                    | mov arg1, tstate
+                    | mov arg2, vsp
+                    emit_mov_imm(Dst, arg3_idx, oparg);
+                    emit_call_ext_func(Dst, call_function_jit_direct);
+                    emit_adjust_vs(Dst, -(oparg + 1));
+                    if (jit_stats_enabled) {
+                        emit_inc_qword_ptr(Dst, &jit_stat_call_function_hit, 1 /*=can use tmp_reg*/);
+                    }
+                    emit_if_res_0_error(Dst);
+                }
+            }
+#endif
+
             if (wrote_inline_cache)
                 switch_section(Dst, SECTION_COLD);
 
             |1:
             if (wrote_inline_cache && jit_stats_enabled) {
-                emit_inc_qword_ptr(Dst, &jit_stat_call_method_miss, 1 /*=can use tmp_reg*/);
+                emit_inc_qword_ptr(Dst, opcode == CALL_METHOD ? &jit_stat_call_method_miss : &jit_stat_call_function_miss, 1 /*=can use tmp_reg*/);
             }
             | mov arg1, tstate
 
@@ -4309,10 +5509,24 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
 #endif
             break;
 
-        case FOR_ITER:
+        case FOR_ITER: {
             deferred_vs_peek_top_and_apply(Dst, arg1_idx);
+            int wrote_for_iter_cache = emit_special_for_iter(Dst, inst_idx) == 0;
+            if (wrote_for_iter_cache) {
+                | branch >4
+                switch_section(Dst, SECTION_COLD);
+                |3:
+                if (jit_stats_enabled) {
+                    emit_inc_qword_ptr(Dst, &jit_stat_for_iter_miss, 1 /*=can use tmp_reg*/);
+                }
+            }
             emit_load64_mem(Dst, tmp_idx, arg1_idx, offsetof(PyObject, ob_type));
             emit_indirect_call(Dst, tmp_idx, offsetof(PyTypeObject, tp_iternext), 0 /*don't ignore ret value*/);
+            if (wrote_for_iter_cache) {
+                | branch >4
+                switch_section(Dst, SECTION_CODE);
+                |4:
+            }
 
             emit_cmp64_imm(Dst, res_idx, 0);
             | branch_eq >1
@@ -4326,6 +5540,7 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
 
             deferred_vs_push(Dst, REGISTER, res_idx);
             break;
+        }
 
         case UNARY_POSITIVE:
         case UNARY_NEGATIVE:
@@ -4566,9 +5781,7 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
             // empty tuple optimization
             if (oparg == 0) {
                 // todo: handle during bytecode generation
-                PyObject* empty_tuple = PyTuple_New(0);
-                deferred_vs_push(Dst, CONST, (unsigned long)empty_tuple);
-                Py_DECREF(empty_tuple);
+                deferred_vs_push(Dst, CONST, (unsigned long)jit_empty_tuple);
                 break;
             }
              __attribute__ ((fallthrough));
@@ -4800,6 +6013,8 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
             }
             deferred_vs_convert_reg_to_stack(Dst);
             if (opcode == COMPARE_OP) {
+                if (emit_special_compare_op_typed(Dst, inst_idx, oparg, ref_status) == 0)
+                    break; // we are finished, emit_special_compare_op_typed already pushed the result
                 emit_mov_imm(Dst, arg3_idx, oparg);
                 emit_call_decref_args2(Dst, PyObject_RichCompare, arg2_idx, arg1_idx, ref_status);
                 emit_if_res_0_error(Dst);
@@ -5535,14 +6750,30 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
         goto failed;
     }
 
+    // memory allocation etc. needs the GIL again
+    if (released_tstate) {
+        PyEval_RestoreThread(released_tstate);
+        released_tstate = NULL;
+    }
+
     // Align code regions to cache line boundaries.
     // I don't know concretely that this is important but seems like
     // something maybe you're supposed to do?
     size = (size + 15) / 16 * 16;
 
+    _Static_assert(sizeof(JitCodeHeader) % 16 == 0, "header must keep the code aligned");
+    size_t alloc_size = sizeof(JitCodeHeader) + size;
+
+    // Reuse memory of freed functions if possible
+    JitCodeHeader* header = jit_mem_alloc_from_free_list(&alloc_size);
+
     // Allocate jitted code regions in 256KB chunks:
-    if (size > mem_chunk_bytes_remaining) {
-        mem_chunk_bytes_remaining = size > (1<<18) ? size : (1<<18);
+    if (!header && alloc_size > mem_chunk_bytes_remaining) {
+        // remember the unused end of the current chunk so it can be reused once we got a new chunk
+        int8_t* old_chunk = mem_chunk;
+        size_t old_chunk_bytes_remaining = mem_chunk_bytes_remaining;
+
+        mem_chunk_bytes_remaining = alloc_size > (1<<18) ? alloc_size : (1<<18);
 
 #ifdef __amd64__
         int map_flags = 0;
@@ -5591,26 +6822,41 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
             if (new_chunk != MAP_FAILED)
                 munmap(new_chunk, mem_chunk_bytes_remaining);
             mem_chunk_bytes_remaining = 0;
+            jit_mem_add_free_block(old_chunk, old_chunk_bytes_remaining);
             goto failed;
         }
         mem_chunk = new_chunk;
         mem_bytes_allocated += (mem_chunk_bytes_remaining + 4095) / 4096 * 4096;
+        jit_mem_add_free_block(old_chunk, old_chunk_bytes_remaining);
     }
 
-    void* mem = mem_chunk;
-    mem_chunk += size;
-    mem_chunk_bytes_remaining -= size;
-    mem_bytes_used += size;
+    if (!header) {
+        header = (JitCodeHeader*)mem_chunk;
+        mem_chunk += alloc_size;
+        mem_chunk_bytes_remaining -= alloc_size;
+    }
+    mem_bytes_used += alloc_size;
+
+    // the entry point is at the start of the first section and gets passed to jit_free_code()
+    void* mem = header + 1;
 
     JIT_MEM_RW();
 
+    header->size = alloc_size;
+    header->func_data = Dst->func_data;
+    Dst->func_data->code_size = alloc_size;
+
     int dasm_encode_err = dasm_encode(Dst, mem);
     if (dasm_encode_err) {
 #if JIT_DEBUG
         JIT_ASSERT(0, "dynasm_encode() returned error %x", dasm_encode_err);
 #endif
+        JIT_MEM_RX();
+        mem_bytes_used -= alloc_size;
+        jit_mem_add_free_block(header, alloc_size);
         goto failed;
     }
+    JIT_ASSERT(labels[lbl_entry] == mem, "entry must be at the start of the code");
 
     // fill in the table of bytecode index -> IP offset from opcode_offset_begin
     for (int inst_idx=0; inst_idx < Dst->num_opcodes; ++inst_idx) {
@@ -5707,16 +6953,30 @@ void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
 
     __builtin___clear_cache((char*)mem, &((char*)mem)[size]);
 
+    if (jit_hotness_path)
+        jit_hotness_add(co);
+
     ++jit_num_funcs;
     success = 1;
 
 cleanup:
     dasm_free(Dst);
+    if (!success)
+        free(Dst->func_data);
+    free(Dst->opcache_snapshot);
+    Dst->opcache_snapshot = NULL;
+    free(Dst->opcache_facts);
+    Dst->opcache_facts = NULL;
+    Dst->ic_miss_budget = NULL;
     free(Dst->is_jmp_target);
     Dst->is_jmp_target = NULL;
 #if ENABLE_DEFINED_TRACKING
     free(Dst->known_defined);
     Dst->known_defined = NULL;
+    free(Dst->jmp_target_state_idx);
+    Dst->jmp_target_state_idx = NULL;
+    free(Dst->defined_at_jmp_target);
+    Dst->defined_at_jmp_target = NULL;
 #endif
 
     // For reasonable bytecode we won't have any hints
@@ -5731,16 +6991,21 @@ cleanup:
         hint = new_hint;
     }
 
-    if (jit_stats_enabled) {
-        struct timespec compilation_end;
-        clock_gettime(CLOCK_MONOTONIC, &compilation_end);
-        total_compilation_time_in_us += 1000000 * (compilation_end.tv_sec - compilation_start.tv_sec) + (compilation_end.tv_nsec - compilation_start.tv_nsec) / 1000;
-    }
+    struct timespec compilation_end;
+    clock_gettime(CLOCK_MONOTONIC, &compilation_end);
+    long compilation_time_in_us = 1000000 * (compilation_end.tv_sec - compilation_start.tv_sec) + (compilation_end.tv_nsec - compilation_start.tv_nsec) / 1000;
+    total_compilation_time_in_us += compilation_time_in_us;
+    if (success)
+        Dst->func_data->compile_time_in_us = compilation_time_in_us;
 
     return success ? labels[lbl_entry] : NULL;
 
 
 failed:
+    if (released_tstate) {
+        PyEval_RestoreThread(released_tstate);
+        released_tstate = NULL;
+    }
     if (jit_stats_enabled) {
         fprintf(stderr, "Could not JIT compile %s:%d %s\n",
                 PyUnicode_AsUTF8(co->co_filename), co->co_firstlineno, PyUnicode_AsUTF8(co->co_name));
@@ -5751,10 +7016,29 @@ failed:
     goto cleanup;
 }
 
+#ifdef PYSTON_LITE
+void* jit_func_lite(PyCodeObject* co, PyThreadState* tstate) {
+#else
+void* jit_func(PyCodeObject* co, PyThreadState* tstate) {
+#endif
+    return jit_func_impl(co, tstate, 0 /* = release_gil */);
+}
+
+// Same as jit_func() but releases the GIL while emitting the machine code.
+// Used by the JIT_ASYNC compiler thread so that it does not block the interpreter.
+#ifdef PYSTON_LITE
+void* jit_func_release_gil_lite(PyCodeObject* co, PyThreadState* tstate) {
+#else
+void* jit_func_release_gil(PyCodeObject* co, PyThreadState* tstate) {
+#endif
+    return jit_func_impl(co, tstate, 1 /* = release_gil */);
+}
+
 static void show_jit_stats() {
     fprintf(stderr, "jit: successfully compiled %d functions, failed to compile %d functions\n", jit_num_funcs, jit_num_failed);
     fprintf(stderr, "jit: took %ld ms to compile all functions\n", total_compilation_time_in_us/1000);
     fprintf(stderr, "jit: %ld bytes used (%.1f%% of allocated)\n", mem_bytes_used, 100.0 * mem_bytes_used / mem_bytes_allocated);
+    fprintf(stderr, "jit: freed %lu functions, reclaimed %ld bytes\n", jit_stat_funcs_freed, mem_bytes_freed);
 
 #define PRINT_STAT(name, opcode) fprintf(stderr, "jit: inlined %lu (of total %lu) %s caches: %lu hits %lu misses (=%lu%%)\n", \
 jit_stat_##name##_inline, jit_stat_##name##_total, #opcode, jit_stat_##name##_hit, jit_stat_##name##_miss, \
@@ -5763,15 +7047,170 @@ jit_stat_##name##_inline, jit_stat_##name##_total, #opcode, jit_stat_##name##_hi
     PRINT_STAT(load_method, LOAD_METHOD);
     PRINT_STAT(load_global, LOAD_GLOBAL);
     PRINT_STAT(call_method, CALL_METHOD);
+    PRINT_STAT(call_function, CALL_FUNCTION);
     PRINT_STAT(store_attr, STORE_ATTR);
 
     fprintf(stderr, "jit: num GetItemLong: %lu inlined: %lu\n", jit_stat_getitemlong, jit_stat_getitemlong_inlined);
     fprintf(stderr, "jit: num SetItemLong: %lu inlined: %lu\n", jit_stat_setitemlong_inlined, jit_stat_setitemlong_inlined);
     fprintf(stderr, "jit: num inplace binary op: %lu hits: %lu misses: %lu\n", jit_stat_binary_op_inplace, jit_stat_binary_op_inplace_hit, jit_stat_binary_op_inplace_miss);
+    fprintf(stderr, "jit: num unboxed binary op: %lu hits: %lu misses: %lu\n", jit_stat_binary_op_unboxed, jit_stat_binary_op_unboxed_hit, jit_stat_binary_op_unboxed_miss);
     fprintf(stderr, "jit: num inplace concat: %lu hits: %lu misses: %lu\n", jit_stat_concat_inplace, jit_stat_concat_inplace_hit, jit_stat_concat_inplace_miss);
+    fprintf(stderr, "jit: num typed compare op: %lu hits: %lu misses: %lu\n", jit_stat_compare_op_typed, jit_stat_compare_op_typed_hit, jit_stat_compare_op_typed_miss);
+    fprintf(stderr, "jit: num specialized for iter: %lu hits: %lu misses: %lu\n", jit_stat_for_iter_inline, jit_stat_for_iter_hit, jit_stat_for_iter_miss);
 
     fprintf(stderr, "jit: num polymorphic LOAD_ATTR sites: %lu with %lu entries\n", jit_stat_load_attr_poly, jit_stat_load_attr_poly_entries);
     fprintf(stderr, "jit: num polymorphic LOAD_METHOD sites: %lu with %lu entries\n", jit_stat_load_method_poly, jit_stat_load_method_poly_entries);
+    fprintf(stderr, "jit: num recompilations because of IC misses: %lu\n", jit_stat_ic_recompiles);
+    fprintf(stderr, "jit: num deopts: %lu\n", jit_stat_deopts);
+
+    if (jit_hotness_path)
+        fprintf(stderr, "jit: hotness file contained %ld functions, %lu got compiled early\n", jit_hotness_num_keys, jit_stat_hotness_hinted);
+}
+
+// Called by the interpreter when the machine code 'code' bailed out to the interpreter.
+#ifdef PYSTON_LITE
+void jit_count_deopt_lite(void* code) {
+#else
+void jit_count_deopt(void* code) {
+#endif
+    JitCodeHeader* header = (JitCodeHeader*)code - 1;
+    ++header->func_data->num_deopts;
+    ++jit_stat_deopts;
+}
+
+static int add_stat(PyObject* dict, const char* name, PyObject* value) {
+    if (value == NULL)
+        return -1;
+    int ret = PyDict_SetItemString(dict, name, value);
+    Py_DECREF(value);
+    return ret;
+}
+
+// Returns a dict with the process wide JIT counters.
+// The IC hit and miss counters only get updated by code compiled while JIT_SHOW_STATS is set.
+#ifdef PYSTON_LITE
+PyObject* jit_get_stats_lite() {
+#else
+PyObject* jit_get_stats() {
+#endif
+    PyObject* d = PyDict_New();
+    if (d == NULL)
+        return NULL;
+
+#define ADD_STAT(name, value) if (add_stat(d, name, PyLong_FromUnsignedLong(value)) < 0) goto error
+#define ADD_IC_STAT(name) \
+    ADD_STAT(#name "_inline", jit_stat_##name##_inline); \
+    ADD_STAT(#name "_total", jit_stat_##name##_total); \
+    ADD_STAT(#name "_hit", jit_stat_##name##_hit); \
+    ADD_STAT(#name "_miss", jit_stat_##name##_miss)
+    if (add_stat(d, "stats_enabled", PyBool_FromLong(jit_stats_enabled)) < 0)
+        goto error;
+    ADD_STAT("num_funcs", jit_num_funcs);
+    ADD_STAT("num_failed", jit_num_failed);
+    ADD_STAT("compile_time_us", total_compilation_time_in_us);
+    ADD_STAT("mem_bytes_allocated", mem_bytes_allocated);
+    ADD_STAT("mem_bytes_used", mem_bytes_used);
+    ADD_STAT("mem_bytes_used_max", mem_bytes_used_max);
+    ADD_STAT("mem_bytes_freed", mem_bytes_freed);
+    ADD_STAT("funcs_freed", jit_stat_funcs_freed);
+    ADD_IC_STAT(load_attr);
+    ADD_IC_STAT(load_method);
+    ADD_IC_STAT(load_global);
+    ADD_IC_STAT(call_method);
+    ADD_IC_STAT(call_function);
+    ADD_IC_STAT(store_attr);
+    ADD_STAT("getitemlong", jit_stat_getitemlong);
+    ADD_STAT("getitemlong_inlined", jit_stat_getitemlong_inlined);
+    ADD_STAT("setitemlong_inlined", jit_stat_setitemlong_inlined);
+    ADD_STAT("binary_op_inplace", jit_stat_binary_op_inplace);
+    ADD_STAT("binary_op_inplace_hit", jit_stat_binary_op_inplace_hit);
+    ADD_STAT("binary_op_inplace_miss", jit_stat_binary_op_inplace_miss);
+    ADD_STAT("binary_op_unboxed", jit_stat_binary_op_unboxed);
+    ADD_STAT("binary_op_unboxed_hit", jit_stat_binary_op_unboxed_hit);
+    ADD_STAT("binary_op_unboxed_miss", jit_stat_binary_op_unboxed_miss);
+    ADD_STAT("concat_inplace", jit_stat_concat_inplace);
+    ADD_STAT("concat_inplace_hit", jit_stat_concat_inplace_hit);
+    ADD_STAT("concat_inplace_miss", jit_stat_concat_inplace_miss);
+    ADD_STAT("compare_op_typed", jit_stat_compare_op_typed);
+    ADD_STAT("compare_op_typed_hit", jit_stat_compare_op_typed_hit);
+    ADD_STAT("compare_op_typed_miss", jit_stat_compare_op_typed_miss);
+    ADD_STAT("for_iter_inline", jit_stat_for_iter_inline);
+    ADD_STAT("for_iter_hit", jit_stat_for_iter_hit);
+    ADD_STAT("for_iter_miss", jit_stat_for_iter_miss);
+    ADD_STAT("load_attr_poly", jit_stat_load_attr_poly);
+    ADD_STAT("load_attr_poly_entries", jit_stat_load_attr_poly_entries);
+    ADD_STAT("load_method_poly", jit_stat_load_method_poly);
+    ADD_STAT("load_method_poly_entries", jit_stat_load_method_poly_entries);
+    ADD_STAT("ic_recompiles", jit_stat_ic_recompiles);
+    ADD_STAT("deopts", jit_stat_deopts);
+    ADD_STAT("hotness_hinted", jit_stat_hotness_hinted);
+#undef ADD_IC_STAT
+#undef ADD_STAT
+    return d;
+
+error:
+    Py_DECREF(d);
+    return NULL;
+}
+
+// Resets all counters returned by jit_get_stats() but not the values
+// which describe the current state like the memory usage.
+#ifdef PYSTON_LITE
+void jit_reset_stats_lite() {
+#else
+void jit_reset_stats() {
+#endif
+    jit_num_funcs = jit_num_failed = 0;
+    total_compilation_time_in_us = 0;
+    mem_bytes_freed = 0;
+#define RESET_IC_STAT(name) \
+    jit_stat_##name##_inline = jit_stat_##name##_total = jit_stat_##name##_hit = jit_stat_##name##_miss = 0
+    RESET_IC_STAT(load_attr);
+    RESET_IC_STAT(load_method);
+    RESET_IC_STAT(load_global);
+    RESET_IC_STAT(call_method);
+    RESET_IC_STAT(call_function);
+    RESET_IC_STAT(store_attr);
+#undef RESET_IC_STAT
+    jit_stat_getitemlong = jit_stat_getitemlong_inlined = jit_stat_setitemlong_inlined = 0;
+    jit_stat_binary_op_inplace = jit_stat_binary_op_inplace_hit = jit_stat_binary_op_inplace_miss = 0;
+    jit_stat_binary_op_unboxed = jit_stat_binary_op_unboxed_hit = jit_stat_binary_op_unboxed_miss = 0;
+    jit_stat_concat_inplace = jit_stat_concat_inplace_hit = jit_stat_concat_inplace_miss = 0;
+    jit_stat_compare_op_typed = jit_stat_compare_op_typed_hit = jit_stat_compare_op_typed_miss = 0;
+    jit_stat_for_iter_inline = jit_stat_for_iter_hit = jit_stat_for_iter_miss = 0;
+    jit_stat_load_attr_poly = jit_stat_load_attr_poly_entries = 0;
+    jit_stat_load_method_poly = jit_stat_load_method_poly_entries = 0;
+    jit_stat_ic_recompiles = jit_stat_funcs_freed = jit_stat_deopts = 0;
+    jit_stat_hotness_hinted = 0;
+}
+
+// Returns a dict with the statistics of a single compiled function.
+// The deopt and IC miss counters get reset with 'reset' but not the IC miss budget itself.
+#ifdef PYSTON_LITE
+PyObject* jit_get_code_stats_lite(void* code, int reset) {
+#else
+PyObject* jit_get_code_stats(void* code, int reset) {
+#endif
+    JitFuncData* data = ((JitCodeHeader*)code - 1)->func_data;
+    PyObject* d = PyDict_New();
+    if (d == NULL)
+        return NULL;
+
+    // the budget goes negative after it got exhausted, so this keeps counting
+    long ic_misses = data->ic_miss_budget_initial - data->ic_miss_budget;
+    if (add_stat(d, "compile_time_us", PyLong_FromLong(data->compile_time_in_us)) < 0
+        || add_stat(d, "code_size", PyLong_FromLong(data->code_size)) < 0
+        || add_stat(d, "ic_misses", PyLong_FromLong(ic_misses)) < 0
+        || add_stat(d, "ic_miss_budget", data->ic_miss_budget_enabled ? PyLong_FromLong(data->ic_miss_budget) : (Py_INCREF(Py_None), Py_None)) < 0
+        || add_stat(d, "deopts", PyLong_FromUnsignedLong(data->num_deopts)) < 0) {
+        Py_DECREF(d);
+        return NULL;
+    }
+    if (reset) {
+        data->ic_miss_budget_initial = data->ic_miss_budget;
+        data->num_deopts = 0;
+    }
+    return d;
 }
 
 #ifdef PYSTON_LITE
@@ -5808,10 +7247,18 @@ void jit_start() {
     if (val)
         jit_use_aot = atoi(val);
 
+    jit_empty_tuple = PyTuple_New(0); // keep the reference forever
+
     val = getenv("JIT_USE_ICS");
     if (val)
         jit_use_ics = atoi(val);
 
+    val = getenv("JIT_HOTNESS_FILE");
+    if (val && val[0]) {
+        jit_hotness_path = strdup(val);
+        jit_hotness_load();
+    }
+
 #ifdef PYSTON_LITE
     // This is to get the value of lookdict_split, which is a static function:
 #if PY_MAJOR_VERSION == 3 && PY_MINOR_VERSION == 7
@@ -5840,6 +7287,15 @@ void jit_start() {
 #endif
 }
 
+// Returns if JIT_SHOW_STATS (or the legacy SHOW_JIT_STATS) is set.
+#ifdef PYSTON_LITE
+int jit_stats_are_enabled_lite() {
+#else
+int jit_stats_are_enabled() {
+#endif
+    return jit_stats_enabled;
+}
+
 #ifdef PYSTON_LITE
 void jit_finish_lite() {
 #else
@@ -5877,6 +7333,14 @@ void jit_finish() {
 
     if (perf_map_opcode_map)
         fclose(perf_map_opcode_map);
+
+    if (jit_hotness_path) {
+        jit_hotness_write();
+        free(jit_hotness_keys);
+        free(jit_hotness_new_keys);
+        free(jit_hotness_path);
+        jit_hotness_path = NULL;
+    }
 }
 
 #if JIT_DEBUG
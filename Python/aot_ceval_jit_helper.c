@@ -174,6 +174,10 @@ int loadAttrCache(PyObject* owner, PyObject* name, _PyOpcache *co_opcache, PyObj
 int setupLoadAttrCache(PyObject* owner, PyObject* name, _PyOpcache *co_opcache, PyObject* res, int is_load_method, int inside_interpreter);
 
 PyObject* _PyDict_GetItemByOffset(PyDictObject *mp, PyObject *key, Py_ssize_t dk_size, int64_t offset);
+#ifndef NO_DKVERSION
+uint64_t _PyDict_GetDictKeyVersionFromKeys(PyObject *op);
+PyObject* _PyDict_GetItemByKeysVersion(PyDictObject *mp, uint64_t keys_ver, int64_t offset);
+#endif
 
 JIT_HELPER1(PRINT_EXPR, value) {
     _Py_IDENTIFIER(displayhook);
@@ -897,6 +901,13 @@ JIT_HELPER_WITH_NAME_OPCACHE_AOT(LOAD_GLOBAL) {
                 ptr = lg->u.builtin_cache.ptr;
         } else if (lg->cache_type == LG_GLOBAL_OFFSET) {
             ptr = _PyDict_GetItemByOffset((PyDictObject*)f->f_globals, name, lg->u.global_offset_cache.dk_size, lg->u.global_offset_cache.offset);
+#ifndef NO_DKVERSION
+        } else if (lg->cache_type == LG_GLOBAL_KEYS_VERSION) {
+            ptr = _PyDict_GetItemByKeysVersion((PyDictObject*)f->f_globals, lg->u.keys_version_cache.globals_keys_ver, lg->u.keys_version_cache.offset);
+        } else if (lg->cache_type == LG_BUILTIN_KEYS_VERSION) {
+            if (_PyDict_GetDictKeyVersionFromKeys((PyObject*)((PyDictObject*)f->f_globals)->ma_keys) == lg->u.keys_version_cache.globals_keys_ver)
+                ptr = _PyDict_GetItemByKeysVersion((PyDictObject*)f->f_builtins, lg->u.keys_version_cache.builtins_keys_ver, lg->u.keys_version_cache.offset);
+#endif
         } else {
             abort();
         }
@@ -1391,7 +1402,8 @@ JIT_HELPER_WITH_NAME_OPCACHE_AOT1(LOAD_ATTR_CACHED, owner) {
         goto la_common;
     }
 
-    if (++co_opcache->num_failed >= 5) {
+    // megamorphic sites miss until the process-wide cache contains the type, don't give up on them
+    if (co_opcache->u.la.cache_type != LA_CACHE_MEGAMORPHIC && ++co_opcache->num_failed >= 5) {
         // don't use the cache anymore
         SET_JIT_AOT_FUNC(JIT_HELPER_LOAD_ATTR);
     }
@@ -2044,7 +2056,8 @@ JIT_HELPER_WITH_NAME_OPCACHE_AOT(LOAD_METHOD_CACHED) {
     meth = NULL;
 
 
-    if (++co_opcache->num_failed >= 5) {
+    // megamorphic sites miss until the process-wide cache contains the type, don't give up on them
+    if (co_opcache->u.la.cache_type != LA_CACHE_MEGAMORPHIC && ++co_opcache->num_failed >= 5) {
         // don't use the cache anymore
         SET_JIT_AOT_FUNC(JIT_HELPER_LOAD_METHOD);
     }
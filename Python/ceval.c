@@ -1072,7 +1072,7 @@ _PyEval_EvalFrameDefault(PyFrameObject *f, int throwflag)
     do { \
         co_opcache = NULL; \
         if (co->co_opcache != NULL) { \
-            unsigned char co_opt_offset = \
+            _PyOpcacheIdx co_opt_offset = \
                 co->co_opcache_map[next_instr - first_instr]; \
             if (co_opt_offset > 0) { \
                 assert(co_opt_offset <= co->co_opcache_size); \
@@ -1198,7 +1198,7 @@ _PyEval_EvalFrameDefault(PyFrameObject *f, int throwflag)
             }
 #if OPCACHE_STATS
             opcache_code_objects_extra_mem +=
-                PyBytes_Size(co->co_code) / sizeof(_Py_CODEUNIT) +
+                PyBytes_Size(co->co_code) / sizeof(_Py_CODEUNIT) * sizeof(_PyOpcacheIdx) +
                 sizeof(_PyOpcache) * co->co_opcache_size;
             opcache_code_objects++;
 #endif
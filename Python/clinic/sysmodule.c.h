@@ -1003,6 +1003,37 @@ sys__debugmallocstats(PyObject *module, PyObject *Py_UNUSED(ignored))
     return sys__debugmallocstats_impl(module);
 }
 
+PyDoc_STRVAR(sys__malloc_trim__doc__,
+"_malloc_trim($module, /)\n"
+"--\n"
+"\n"
+"Give the memory of unused pymalloc pools back to the operating system.\n"
+"\n"
+"Only the pools inside arenas which still hold objects are affected, empty\n"
+"arenas are always freed.  Return the number of bytes released.");
+
+#define SYS__MALLOC_TRIM_METHODDEF    \
+    {"_malloc_trim", (PyCFunction)sys__malloc_trim, METH_NOARGS, sys__malloc_trim__doc__},
+
+static Py_ssize_t
+sys__malloc_trim_impl(PyObject *module);
+
+static PyObject *
+sys__malloc_trim(PyObject *module, PyObject *Py_UNUSED(ignored))
+{
+    PyObject *return_value = NULL;
+    Py_ssize_t _return_value;
+
+    _return_value = sys__malloc_trim_impl(module);
+    if ((_return_value == -1) && PyErr_Occurred()) {
+        goto exit;
+    }
+    return_value = PyLong_FromSsize_t(_return_value);
+
+exit:
+    return return_value;
+}
+
 PyDoc_STRVAR(sys__clear_type_cache__doc__,
 "_clear_type_cache($module, /)\n"
 "--\n"
@@ -1096,4 +1127,4 @@ sys_getandroidapilevel(PyObject *module, PyObject *Py_UNUSED(ignored))
 #ifndef SYS_GETANDROIDAPILEVEL_METHODDEF
     #define SYS_GETANDROIDAPILEVEL_METHODDEF
 #endif /* !defined(SYS_GETANDROIDAPILEVEL_METHODDEF) */
-/*[clinic end generated code: output=d9c463bd000de5a5 input=a9049054013a1b77]*/
+/*[clinic end generated code: output=fff983bca9a5ba8d input=a9049054013a1b77]*/
@@ -603,7 +603,7 @@ pycore_init_types(void)
 
 
 #ifdef ENABLE_AOT
-void PyInit_aot_ceval();
+PyObject* PyInit_aot_ceval();
 void aot_exit();
 #endif
 
@@ -951,7 +951,14 @@ pyinit_main(_PyRuntimeState *runtime, PyInterpreterState *interp)
     }
 
 #ifdef ENABLE_AOT
-    PyInit_aot_ceval();
+    {
+        // makes the JIT statistics available via 'import pyston'
+        PyObject* aot_ceval_module = PyInit_aot_ceval();
+        if (aot_ceval_module == NULL || _PyImport_SetModuleString("pyston", aot_ceval_module) < 0) {
+            return _PyStatus_ERR("can't initialize the pyston module");
+        }
+        Py_DECREF(aot_ceval_module);
+    }
 #endif
 
     PyStatus status = init_importlib_external(interp);
@@ -1895,6 +1895,26 @@ sys__debugmallocstats_impl(PyObject *module)
     Py_RETURN_NONE;
 }
 
+/*[clinic input]
+sys._malloc_trim -> Py_ssize_t
+
+Give the memory of unused pymalloc pools back to the operating system.
+
+Only the pools inside arenas which still hold objects are affected, empty
+arenas are always freed.  Return the number of bytes released.
+[clinic start generated code]*/
+
+static Py_ssize_t
+sys__malloc_trim_impl(PyObject *module)
+/*[clinic end generated code: output=6b479588ec581431 input=8b3548b2ad2e199b]*/
+{
+#ifdef WITH_PYMALLOC
+    return (Py_ssize_t)_PyObject_TrimArenas();
+#else
+    return 0;
+#endif
+}
+
 #ifdef Py_TRACE_REFS
 /* Defined in objects.c because it uses static globals if that file */
 extern PyObject *_Py_GetObjects(PyObject *, PyObject *);
@@ -2004,6 +2024,7 @@ static PyMethodDef sys_methods[] = {
     SYS_GETTRACE_METHODDEF
     SYS_CALL_TRACING_METHODDEF
     SYS__DEBUGMALLOCSTATS_METHODDEF
+    SYS__MALLOC_TRIM_METHODDEF
     SYS_SET_COROUTINE_ORIGIN_TRACKING_DEPTH_METHODDEF
     SYS_GET_COROUTINE_ORIGIN_TRACKING_DEPTH_METHODDEF
     {"set_asyncgen_hooks", (PyCFunction)(void(*)(void))sys_set_asyncgen_hooks,
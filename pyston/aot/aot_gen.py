@@ -2,10 +2,14 @@
 
 import copy
 import ctypes
+import hashlib
 import itertools
 import multiprocessing.pool
 import os
+import re
+import shutil
 import sys
+import time
 
 cmps = ["PyCmp_LT", "PyCmp_LE", "PyCmp_EQ", "PyCmp_NE",
         "PyCmp_GT", "PyCmp_GE", "PyCmp_IN", "PyCmp_NOT_IN",
@@ -556,7 +560,82 @@ class ExampleClass{i}:
         pass
     """, globals())
 
-def loadCases():
+# Maps the opcodes recorded in an AOT type profile to the function we generate traces for
+profile_opcode_funcs = {
+    "BINARY_MULTIPLY": "PyNumber_Multiply",
+    "BINARY_TRUE_DIVIDE": "PyNumber_TrueDivide",
+    "BINARY_FLOOR_DIVIDE": "PyNumber_FloorDivide",
+    "BINARY_MODULO": "PyNumber_Remainder",
+    "BINARY_ADD": "PyNumber_Add",
+    "BINARY_SUBTRACT": "PyNumber_Subtract",
+    "BINARY_SUBSCR": "PyObject_GetItem",
+    "INPLACE_MULTIPLY": "PyNumber_InPlaceMultiply",
+    "INPLACE_TRUE_DIVIDE": "PyNumber_InPlaceTrueDivide",
+    "INPLACE_FLOOR_DIVIDE": "PyNumber_InPlaceFloorDivide",
+    "INPLACE_MODULO": "PyNumber_InPlaceRemainder",
+    "INPLACE_ADD": "PyNumber_InPlaceAdd",
+    "INPLACE_SUBTRACT": "PyNumber_InPlaceSubtract",
+}
+
+# Maps the tp_name of a profiled type to our type name.
+# We can only specialize on types which have an exported PyTypeObject because the guards
+# compare against the address of it. Types of extension modules like decimal.Decimal
+# or datetime.datetime get loaded at different addresses in every process.
+profile_type_names = {
+    "int": "Long",
+    "float": "Float",
+    "str": "Unicode",
+    "list": "List",
+    "tuple": "Tuple",
+    "range": "Range",
+    "dict": "Dict",
+    "set": "Set",
+    "bool": "Bool",
+    "slice": "Slice",
+    "NoneType": "None",
+    "bytes": "Bytes",
+    "bytearray": "ByteArray",
+    "complex": "Complex",
+    "frozenset": "FrozenSet",
+}
+
+def loadTypeProfile(filename, min_count):
+    """
+    Reads a profile written by running pyston with AOT_TYPE_PROFILE=<filename>.
+
+    Every line has the format "<count> <opcode> <left tp_name> <right tp_name>",
+    the counts of duplicated lines get added up because every process appends to the file.
+    Returns {func_name: {(left, right): count}} for all type combinations we can specialize on
+    which got executed at least min_count times.
+    """
+    counts = {}
+    with open(filename) as f:
+        for line in f:
+            if not line.strip() or line.startswith("#"):
+                continue
+            count, opcode, left, right = line.split()
+            key = (opcode, left, right)
+            counts[key] = counts.get(key, 0) + int(count)
+
+    profile = {}
+    skipped_types = {}
+    for (opcode, left, right), count in counts.items():
+        if count < min_count or opcode not in profile_opcode_funcs:
+            continue
+        unknown = [t for t in (left, right) if t not in profile_type_names]
+        for t in unknown:
+            skipped_types[t] = skipped_types.get(t, 0) + count
+        if unknown:
+            continue
+        func = profile_opcode_funcs[opcode]
+        key = (profile_type_names[left], profile_type_names[right])
+        profile.setdefault(func, {})[key] = count
+
+    for t, count in sorted(skipped_types.items(), key=lambda x: -x[1]):
+        print(f"profile: can't specialize on type '{t}' ({count} samples)")
+    return profile
+
+def loadCases(profile={}):
     funcs1 = ["PyNumber_Positive",
               "PyNumber_Negative",
               "PyNumber_Invert",
@@ -622,6 +701,42 @@ def loadCases():
         return f"Py{s}_Type"
     type_classes = {k:ObjectClass(k, TypeGuard("&" + getCTypeName(k)), v) for (k, v) in types.items()}
 
+    # additional types we only generate traces for if they show up in the type profile
+    profile_types = {"Bytes": (b'bytes', b'', b' alaslas' * 20, b'a'),
+                     "ByteArray": (bytearray(b'bytes'), bytearray(),),
+                     "Complex": (1+2j, -0.5j,),
+                     "FrozenSet": (frozenset({"a", "b"}), frozenset(),),
+                     }
+    profile_type_classes = dict(type_classes)
+    profile_type_classes.update({k:ObjectClass(k, TypeGuard("&" + getCTypeName(k)), v) for (k, v) in profile_types.items()})
+
+    def addProfiledSignatures(func, signatures):
+        """
+        Adds signatures for the hot type combinations of the profile which are not covered yet
+        and moves the hottest signatures to the front so that the generated *Profile function
+        checks their guards first.
+        The guards of all signatures passed in here are exclusive so the order does not matter for correctness.
+        """
+        counts = profile.get(func)
+        if not counts:
+            return signatures
+
+        signatures = list(signatures)
+        covered = set(tuple(cls.name for cls in s.argument_classes[:2]) for s in signatures)
+        for (left, right) in counts:
+            # an empty name means the signature is not specialized on that argument
+            if (left, right) in covered or (left, "") in covered:
+                continue
+            print(f"profile: adding {func}{left}{right}")
+            signatures.append(Signature([profile_type_classes[left], profile_type_classes[right]]))
+
+        def getCount(signature):
+            left, right = (cls.name for cls in signature.argument_classes[:2])
+            return sum(c for ((l, r), c) in counts.items() if l == left and (r == right or not right))
+        # stable sort: keeps the order of the signatures which are not in the profile
+        signatures.sort(key=lambda s: -getCount(s))
+        return signatures
+
     # look at types.py
     callables = {"CFunction": [(globals, ()), # zero args
                                (len, (([1, 2, 3], )), ((1, 2), ), ("test string", )), # one arg
@@ -811,7 +926,7 @@ def loadCases():
         signatures = makeSignatures(*classes)
 
         for func in funcs:
-            cases.append(NormalHandler(FunctionCases(func, signatures)))
+            cases.append(NormalHandler(FunctionCases(func, addProfiledSignatures(func, signatures))))
 
     # We currently don't do any specialization on the key argument for GetItem / SetItem / DelItem / IN / NOT_IN
     # so collapse all those traces into a single one
@@ -821,6 +936,7 @@ def loadCases():
         getitem_signatures += makeSignatures([type_classes[name]], [type_classes["Long"], type_classes["Slice"]])
     getitem_signatures += makeSignatures([type_classes["Dict"]], [placeholder_class])
     # getitem_signatures = [s for s in getitem_signatures if s.argument_classes[0].name != "Range"]
+    getitem_signatures = addProfiledSignatures("PyObject_GetItem", getitem_signatures)
     cases.append(NormalHandler(FunctionCases("PyObject_GetItem", getitem_signatures)))
 
     getitemlong_signatures = []
@@ -845,7 +961,7 @@ def loadCases():
 
     return cases
 
-cases = loadCases()
+cases = []
 
 def loadLibs():
     # TODO we should probably export a python module instead
@@ -878,6 +994,11 @@ def loadLibs():
     addAlwaysTrace = nitrous_so.addAlwaysTrace
     addAlwaysTrace.argtypes = [ctypes.c_char_p]
 
+    global getFunctionHash
+    getFunctionHash = nitrous_so.getFunctionHash
+    getFunctionHash.argtypes = [ctypes.c_char_p]
+    getFunctionHash.restype = ctypes.c_ulong
+
     global createJitTarget
     createJitTarget = nitrous_so.createJitTarget
     createJitTarget.argtypes = [ctypes.c_void_p, ctypes.c_long, ctypes.c_long]
@@ -926,11 +1047,104 @@ def loadLibs():
     call_helper = call_helper_wrapper
 
 
+class TraceCache(object):
+    """
+    Content addressed cache of the traced bitcode (aot_module.<name>.bc) of every signature,
+    so that a rebuild only has to retrace the signatures whose inputs changed.
+
+    A trace depends on the signature (its guards, examples and tracing settings),
+    on the tracer and on the bitcode of every function nitrous inlined into the trace.
+    Which functions got inlined is only known after tracing (nitrous writes them to
+    aot_module.<name>.deps) so we store two files per signature:
+      <signature key>.deps  the functions of the last trace of the signature
+      <trace key>.bc        the trace, the key includes the hashes of all functions in the .deps file
+    Functions which got called instead of inlined are only covered by name,
+    'make clean' or --trace-cache= forces a full retrace.
+    """
+    def __init__(self, directory, pic):
+        self.directory = directory
+        os.makedirs(directory, exist_ok=True)
+
+        h = hashlib.sha256()
+        h.update(f"pic={pic}".encode())
+        for path in [__file__] + [self._findLibrary(lib) for lib in ("libinterp.so", "libpystol.so")]:
+            with open(path, "rb") as f:
+                h.update(f.read())
+        self.base_key = h.hexdigest()
+        self.function_hashes = {}
+
+    @staticmethod
+    def _findLibrary(name):
+        for directory in os.environ.get("LD_LIBRARY_PATH", "").split(":"):
+            path = os.path.join(directory, name)
+            if directory and os.path.exists(path):
+                return path
+        raise Exception(f"could not find {name} in LD_LIBRARY_PATH")
+
+    @staticmethod
+    def _stableRepr(obj):
+        # object addresses change from run to run
+        return re.sub(r" at 0x[0-9a-f]+", "", repr(obj))
+
+    def getSignatureKey(self, handler, signature, name, examples):
+        h = hashlib.sha256(self.base_key.encode())
+        for part in (type(handler).__name__, name,
+                     sorted(handler.do_not_trace + signature.do_not_trace),
+                     sorted(handler.always_trace + signature.always_trace),
+                     examples):
+            h.update(self._stableRepr(part).encode())
+            h.update(b"\0")
+        return h.hexdigest()
+
+    def _getTraceKey(self, signature_key, deps):
+        h = hashlib.sha256(signature_key.encode())
+        for function_name in deps:
+            if function_name not in self.function_hashes:
+                self.function_hashes[function_name] = getFunctionHash(function_name.encode())
+            h.update(f"{function_name} {self.function_hashes[function_name]}\n".encode())
+        return h.hexdigest()
+
+    def _path(self, key, ext):
+        return os.path.join(self.directory, key + ext)
+
+    def _atomicCopy(self, src, dst):
+        tmp = f"{dst}.tmp{os.getpid()}"
+        shutil.copyfile(src, tmp)
+        os.replace(tmp, dst)
+
+    def lookup(self, signature_key, name):
+        """
+        Copies the cached trace to aot_module.<name>.bc, returns False if there is no valid one
+        """
+        try:
+            with open(self._path(signature_key, ".deps")) as f:
+                deps = f.read().split()
+        except FileNotFoundError:
+            return False
+        bc_path = self._path(self._getTraceKey(signature_key, deps), ".bc")
+        if not os.path.exists(bc_path):
+            return False
+        shutil.copyfile(bc_path, f"aot_module.{name}.bc")
+        return True
+
+    def store(self, signature_key, name):
+        bc_path = f"aot_module.{name}.bc"
+        deps_path = f"aot_module.{name}.deps"
+        if not os.path.exists(bc_path) or not os.path.exists(deps_path):
+            return
+        with open(deps_path) as f:
+            deps = f.read().split()
+        self._atomicCopy(bc_path, self._path(self._getTraceKey(signature_key, deps), ".bc"))
+        self._atomicCopy(deps_path, self._path(signature_key, ".deps"))
+
+trace_cache = None
+
 def specialize_func(handler, header_f, profile_f, async_tracing, only=None):
     unspecialized_name = handler.case.unspecialized_name
     print(f"Generating special versions of {unspecialized_name}")
 
     num_skipped = 0
+    num_cached = 0
 
     traced = []
 
@@ -954,34 +1168,47 @@ def specialize_func(handler, header_f, profile_f, async_tracing, only=None):
 
         should_jit = len(train_success) > 0
         if should_jit:
-            # create new jit target because we want to make sure we did not train on any error
-            # TODO: could skip this if no errors happened
-            target = handler.createJitTarget(target_addr, len(train_success))
-            async_tracing.append((name, signature, handler, target, copy.deepcopy(train_success)))
+            cache_key = None
+            if trace_cache:
+                cache_key = trace_cache.getSignatureKey(handler, signature, name, train_success)
+            if cache_key and trace_cache.lookup(cache_key, name):
+                num_cached += 1
+            else:
+                # create new jit target because we want to make sure we did not train on any error
+                # TODO: could skip this if no errors happened
+                target = handler.createJitTarget(target_addr, len(train_success))
+                async_tracing.append((name, signature, handler, target, copy.deepcopy(train_success), cache_key))
             traced.append((signature, name))
         else:
             num_skipped += 1
             #print(f"  {spec_name} errors. skipping...")
 
-    print(f'  going to generate {len(traced)} special versions')
+    print(f'  going to generate {len(traced)} special versions ({num_cached} cached)')
     if only is None:
         handler.write_profile_func(traced, header_f, profile_f)
-    return (len(traced), num_skipped)
+    return (len(traced), num_skipped, num_cached)
 
 
 def do_trace(work):
-    (name, signature, handler, target, train_success) = work
+    (name, signature, handler, target, train_success, cache_key) = work
     if VERBOSITY >= 1:
         print("tracing", name)
 
+    start = time.perf_counter()
     for args in copy.deepcopy(train_success):
         if VERBOSITY >= 1:
             print("tracing", name, "with args:", args)
         handler.trace(target, args, signature)
+    duration = time.perf_counter() - start
+
+    if cache_key:
+        trace_cache.store(cache_key, name)
+    return (name, duration)
 
-def trace_all_funcs(only=None):
+def trace_all_funcs(only=None, trace_times_file=None):
     total_num_gen = 0
     total_num_skipped = 0
+    total_num_cached = 0
 
     if only:
         header_f = profile_f = None
@@ -1004,19 +1231,29 @@ def trace_all_funcs(only=None):
     # list of work items we will later on trace
     async_tracing = []
     for case in cases:
-        num_gen, num_skipped = specialize_func(case, header_f, profile_f, async_tracing, only=only)
+        num_gen, num_skipped, num_cached = specialize_func(case, header_f, profile_f, async_tracing, only=only)
         total_num_gen += num_gen
         total_num_skipped += num_skipped
+        total_num_cached += num_cached
 
     if VERBOSITY:
-        list(map(do_trace, async_tracing))
+        trace_times = list(map(do_trace, async_tracing))
     else:
         print("Starting multiprocess tracing...")
         with multiprocessing.pool.Pool() as tracing_pool:
-            tracing_pool.map(do_trace, async_tracing, chunksize=1)
+            trace_times = tracing_pool.map(do_trace, async_tracing, chunksize=1)
 
     print(
-        f'generated in total {total_num_gen} special versions skipped {total_num_skipped}')
+        f'generated in total {total_num_gen} special versions skipped {total_num_skipped} reused {total_num_cached} cached traces')
+
+    if trace_times_file:
+        trace_times.sort(key=lambda x: -x[1])
+        with open(trace_times_file, "w") as f:
+            for name, duration in trace_times:
+                print(f"{duration:.3f}s {name}", file=f)
+        print(f"{sum(t for (_, t) in trace_times):.1f}s spent tracing {len(trace_times)} functions, slowest:")
+        for name, duration in trace_times[:10]:
+            print(f"  {duration:.3f}s {name}")
 
     if header_f:
         print("#endif", file=header_f)
@@ -1104,10 +1341,21 @@ if __name__ == "__main__":
     parser.add_argument("--only", action="store", default=None)
     parser.add_argument("-o", action="store", default=None)
     parser.add_argument("--pic", action="store_true", default=False)
+    # AOT type profile written by running pyston with AOT_TYPE_PROFILE=<file>
+    parser.add_argument("--profile", action="store", default=None)
+    parser.add_argument("--profile-min-count", action="store", type=int, default=1000)
+    # directory of the trace cache, pass an empty string to retrace everything
+    parser.add_argument("--trace-cache", action="store", default="aot_trace_cache")
+    # writes how long tracing every function took to this file
+    parser.add_argument("--trace-times", action="store", default=None)
 
     args = parser.parse_args()
     assert args.action in ("pretrace", "trace", "all")
 
+    # Note: pretrace and trace have to be passed the same profile so that they generate the same functions
+    profile = loadTypeProfile(args.profile, args.profile_min_count) if args.profile else {}
+    cases = loadCases(profile)
+
     if args.action in ("pretrace", "all"):
         assert args.o
         create_pre_traced_funcs(args.o)
@@ -1122,5 +1370,8 @@ if __name__ == "__main__":
         loadBitcode(b'all.bc')
         pystolGlobalPythonSetup()
 
+        if args.trace_cache and not args.only:
+            trace_cache = TraceCache(args.trace_cache, args.pic)
+
         # start tracing
-        trace_all_funcs(only=args.only)
+        trace_all_funcs(only=args.only, trace_times_file=args.trace_times)
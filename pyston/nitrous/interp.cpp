@@ -1,3 +1,4 @@
+#include <cctype>
 #include <ctime>
 #include <dlfcn.h>
 #include <memory>
@@ -7,16 +8,19 @@
 
 #include <ffi.h>
 
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/AsmParser/Parser.h"
 #include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/GetElementPtrTypeIterator.h"
+#include "llvm/IR/InstIterator.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/MDBuilder.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MD5.h"
 #include "llvm/Support/SourceMgr.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/Cloning.h"
@@ -196,6 +200,66 @@ public:
         }
         return nullptr;
     }
+
+    // Returns a hash of the IR of the function and of the initializers of all global
+    // variables it (transitively) references, or 0 if we don't have bitcode for it.
+    // Attribute group and metadata numbers get left out because they are numbered per
+    // module and change whenever any other function changes.
+    unsigned long hashFunction(string name) {
+        Function* func = findFunction(name);
+        if (!func)
+            return 0;
+
+        string ir;
+        raw_string_ostream os(ir);
+        os << func->getAttributes().getAsString(AttributeList::FunctionIndex) << '\n';
+        os << *func;
+
+        SmallPtrSet<GlobalVariable*, 16> visited;
+        SmallVector<Constant*, 16> worklist;
+        for (auto& inst : instructions(func)) {
+            for (auto& op : inst.operands()) {
+                if (auto* c = dyn_cast<Constant>(op.get()))
+                    worklist.push_back(c);
+            }
+        }
+        while (!worklist.empty()) {
+            Constant* c = worklist.pop_back_val();
+            if (auto* gv = dyn_cast<GlobalVariable>(c)) {
+                if (!visited.insert(gv).second)
+                    continue;
+                cantFail(gv->materialize());
+                os << *gv << '\n';
+                if (gv->hasInitializer())
+                    worklist.push_back(gv->getInitializer());
+                continue;
+            }
+            // functions only matter by name, the ones we trace into have their own hash
+            if (isa<GlobalValue>(c))
+                continue;
+            for (auto& op : c->operands()) {
+                if (auto* op_c = dyn_cast<Constant>(op.get()))
+                    worklist.push_back(op_c);
+            }
+        }
+        os.flush();
+
+        string normalized;
+        normalized.reserve(ir.size());
+        for (size_t i = 0; i < ir.size(); ++i) {
+            normalized.push_back(ir[i]);
+            if (ir[i] == '#' || ir[i] == '!') {
+                while (i + 1 < ir.size() && isdigit(ir[i + 1]))
+                    ++i;
+            }
+        }
+
+        MD5 hash;
+        hash.update(normalized);
+        MD5::MD5Result result;
+        hash.final(result);
+        return result.low();
+    }
 } bitcode_registry;
 
 const Function* functionForAddress(intptr_t address) {
@@ -1211,6 +1275,10 @@ long _runJitTarget(JitTarget* target, ...) {
     return r.first;
 }
 
+unsigned long getFunctionHash(const char* function_name) {
+    return nitrous::bitcode_registry.hashFunction(function_name);
+}
+
 void optimizeBitcode(const char* function_name) {
     auto func = nitrous::bitcode_registry.findFunction(function_name);
     RELEASE_ASSERT(func, "");
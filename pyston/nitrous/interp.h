@@ -20,6 +20,9 @@ DEF void addAlwaysTrace(const char* function_name);
 
 DEF void loadBitcode(const char* llvm_filename);
 
+// Returns a hash of the loaded bitcode of the function or 0 if there is none
+DEF unsigned long getFunctionHash(const char* function_name);
+
 typedef struct _JitTarget {
     void* target_function;
     int num_args;
@@ -351,6 +351,7 @@ LLVMJit::LLVMJit(const Function* orig_function, orc::ThreadSafeContext* llvm_con
     // Our traced functions emit function pointer comparison with themself.
     // We want the function ptr to get compared to the traced function not the original untraced one.
     cloneFunctionIntoAndRemap(func, orig_function, true /* references to the function get remapped to the new one */);
+    traced_functions.insert(orig_function->getName().str());
 }
 
 LLVMJit::InlineInfo LLVMJit::inlineFunction(CallInst* call,
@@ -359,6 +360,7 @@ LLVMJit::InlineInfo LLVMJit::inlineFunction(CallInst* call,
                                      Function::ExternalLinkage,
                                      "__nitrous_inline_tmp_" + function->getName(), module.get());
     cloneFunctionIntoAndRemap(new_func, function, false /* references to the function will keep referencing the orig function */);
+    traced_functions.insert(function->getName().str());
 
     //outs() << "before inlining:\n";
     //outs() << *module << '\n';
@@ -1141,6 +1143,14 @@ void* LLVMJit::finish(LLVMEvaluator& eval) {
     llvm::WriteBitcodeToFile(*mod, OS);
     OS.flush();
 
+    // Write out which functions the trace got created from.
+    // aot_gen.py uses it to decide if a cached trace has to get recreated after the bitcode changed.
+    std::string deps_file_name = ("aot_module." + func->getName() + ".deps").str();
+    llvm::raw_fd_ostream deps_OS(deps_file_name, EC, llvm::sys::fs::OF_None);
+    for (auto&& name : traced_functions)
+        deps_OS << name << '\n';
+    deps_OS.flush();
+
     struct timespec start, end;
     if (nitrous_verbosity >= NITROUS_VERBOSITY_STATS)
         clock_gettime(CLOCK_REALTIME, &start);
@@ -3,6 +3,8 @@
 
 #include <list>
 #include <memory>
+#include <set>
+#include <string>
 #include <vector>
 
 // When enabled will create a single abort basic block where all abort paths will jump to.
@@ -93,6 +95,9 @@ private:
 
     std::vector<std::unique_ptr<char[]>> allocations;
 
+    // names of the original function and of all functions we inlined into it
+    std::set<std::string> traced_functions;
+
     static int num_functions;
     static std::string getUniqueFunctionName(std::string nameprefix);
 
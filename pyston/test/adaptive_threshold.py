@@ -0,0 +1,35 @@
+# Tests that large functions (which need more calls before they get JIT compiled)
+# and small ones compute the same results with and without JIT_ADAPTIVE_THRESHOLD
+import os
+import subprocess
+import sys
+
+code = """
+src = "def big(x):\\n"
+for i in range(300):
+    src += "    x = x + %d\\n" % i
+src += "    return x\\n"
+exec(src)
+
+def small(x):
+    return x * 2
+
+def loop(n):
+    t = 0
+    for i in range(n):
+        t += small(i)
+    return t
+
+for i in range(5000):
+    assert big(i) == i + sum(range(300))
+    assert small(i) == i * 2
+assert loop(100000) == 2 * sum(range(100000))
+"""
+
+if __name__ == "__main__":
+    for adaptive in ("0", "1"):
+        env = dict(os.environ, JIT_ADAPTIVE_THRESHOLD=adaptive)
+        subprocess.check_call([sys.executable, "-c", code], env=env)
+    # a nearly full JIT memory budget raises the thresholds further
+    env = dict(os.environ, JIT_MAX_MEM="20000")
+    subprocess.check_call([sys.executable, "-c", code], env=env)
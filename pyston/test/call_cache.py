@@ -0,0 +1,105 @@
+# Tests the call-site caches of CALL_FUNCTION, CALL_FUNCTION_KW and CALL_METHOD,
+# including switching the callee after the cache got filled
+import sys
+
+def add(a, b):
+    return a + b
+
+def sub(a, b):
+    return a - b
+
+def kw(a, b=2, *, c=3):
+    return a + b + c
+
+class C:
+    def __init__(self, x):
+        self.x = x
+
+    def m(self, y):
+        return self.x + y
+
+def call2(f, a, b):
+    return f(a, b)
+
+def call1(f, a):
+    return f(a)
+
+def call0(f):
+    return f()
+
+def call_kw(f, a):
+    return f(a, c=a)
+
+def call_meth(o, a):
+    return o.m(a)
+
+def call_len(l):
+    return len(l)
+
+for i in range(3000):
+    assert call2(add, i, 1) == i + 1
+    assert call1(len, "x" * (i % 5)) == i % 5
+    assert call_len([1] * (i % 7)) == i % 7
+    assert call2(isinstance, i, int)
+    assert call1(C, i).x == i
+    assert call0(list) == []
+    assert call_kw(kw, i) == i + 2 + i
+    assert call_meth(C(i), 2) == i + 2
+
+# change the callee at every site
+assert call2(sub, 5, 1) == 4
+assert call2(max, 5, 7) == 7
+assert call2(divmod, 7, 2) == (3, 1)
+assert call1(abs, -3) == 3
+assert call1(str, 3) == "3"
+assert call0(dict) == {}
+assert call0(lambda: 42) == 42
+assert call_kw(lambda a, c: a * c, 3) == 9
+
+class D:
+    def m(self, y):
+        return y * 2
+assert call_meth(D(), 4) == 8
+
+class E:
+    pass
+e = E()
+e.m = lambda y: y - 1
+assert call_meth(e, 4) == 3
+
+def raises(a, b):
+    raise ValueError(a)
+try:
+    call2(raises, 1, 2)
+    assert False
+except ValueError:
+    pass
+try:
+    call1(len, 5)
+    assert False
+except TypeError:
+    pass
+
+# a wrong number of arguments must still raise
+try:
+    call1(add, 1)
+    assert False
+except TypeError:
+    pass
+try:
+    call0(len)
+    assert False
+except TypeError:
+    pass
+
+# calls must still be visible to a profile function
+calls = []
+def profile(frame, event, arg):
+    if event in ("call", "c_call"):
+        calls.append(arg.__name__ if event == "c_call" else frame.f_code.co_name)
+sys.setprofile(profile)
+call2(add, 1, 2)
+call1(len, "abc")
+sys.setprofile(None)
+assert "add" in calls, calls
+assert "len" in calls, calls
@@ -0,0 +1,82 @@
+# Tests the type specialized COMPARE_OP and FOR_ITER opcache paths,
+# including when the profiled types change
+import math
+
+def cmp(a, b):
+    return (a < b, a <= b, a == b, a != b, a > b, a >= b)
+
+def expected(a, b):
+    return (a.__lt__(b), a.__le__(b), a.__eq__(b), a.__ne__(b), a.__gt__(b), a.__ge__(b))
+
+ints = [0, 1, -1, 5, -5, 2**30 - 1, -(2**30 - 1), 2**30, -2**30, 2**62, -2**100]
+floats = [0.0, -0.0, 1.5, -1.5, 1e300, float("inf"), float("-inf"), math.nan]
+strs = ["", "a", "b", "ab", "ሴ", "a" * 100]
+
+for i in range(2000):
+    assert cmp(i, 1000) == (i < 1000, i <= 1000, i == 1000, i != 1000, i > 1000, i >= 1000)
+
+for i in range(10):
+    for values in (ints, floats, strs):
+        for a in values:
+            for b in values:
+                assert cmp(a, b) == expected(a, b), (a, b, cmp(a, b))
+
+# the guards must fail for mixed and other types
+assert cmp(1, 1.5) == (True, True, False, True, False, False)
+assert cmp(True, 1) == (False, True, True, False, False, True)
+assert cmp((1, 2), (1, 3)) == (True, True, False, True, False, False)
+try:
+    cmp("a", 1)
+    assert False
+except TypeError:
+    pass
+
+def total(it):
+    t = 0
+    for x in it:
+        t += x
+    return t
+
+for i in range(2000):
+    assert total(range(i % 10)) == sum(range(i % 10))
+
+for i in range(100):
+    l = list(range(i))
+    assert total(l) == sum(l)
+    assert total(range(-i, i * 3, 3)) == sum(range(-i, i * 3, 3))
+    assert total(range(10, -i, -7)) == sum(range(10, -i, -7))
+
+assert total(range(2**62, 2**62 + 3)) == 3 * 2**62 + 3
+assert total(range(2**64, 2**64 + 3)) == 3 * 2**64 + 3
+assert total((1, 2, 3)) == 6
+assert total({1: 0, 2: 0}) == 3
+assert total(x for x in range(4)) == 6
+assert total(iter([1, 2])) == 3
+
+# a list which gets modified while we iterate over it
+def grow(l):
+    n = 0
+    for x in l:
+        if len(l) < 10:
+            l.append(x)
+        n += 1
+    return n
+for i in range(100):
+    assert grow([1, 2]) == 10
+
+def shrink(l):
+    n = 0
+    for x in l:
+        l.pop()
+        n += 1
+    return n
+for i in range(100):
+    assert shrink(list(range(10))) == 5
+
+def items(d):
+    r = []
+    for k, v in d.items():
+        r.append(k + v)
+    return r
+for i in range(1000):
+    assert items({1: 2, 3: 4}) == [3, 7]
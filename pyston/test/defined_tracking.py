@@ -0,0 +1,28 @@
+# the JIT tracks which fast locals are known to be set across basic blocks,
+# make sure locals which are only set on some paths still raise UnboundLocalError
+def f(n):
+    if n:
+        x = n
+    t = 0
+    for i in range(10):
+        try:
+            t += x
+        except UnboundLocalError:
+            t -= 1
+    return t
+
+def g(n):
+    x = 1
+    for i in range(n):
+        if i == 5:
+            del x
+        try:
+            x
+        except UnboundLocalError:
+            return i
+    return -1
+
+for i in range(5000):
+    assert f(i % 3) == (10 * (i % 3) if i % 3 else -10)
+    assert g(10) == 5
+    assert g(3) == -1
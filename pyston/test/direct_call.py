@@ -0,0 +1,52 @@
+# tests calls of python functions which the JIT can do directly
+import sys
+
+def add(a, b):
+    return a + b
+
+def caller_name():
+    return sys._getframe(1).f_code.co_name
+
+def fail(x):
+    raise ValueError(x)
+
+def rec(n):
+    if n == 0:
+        return 0
+    return rec(n - 1) + 1
+
+def f(x):
+    t = add(x, 1)
+    assert caller_name() == "f"
+    try:
+        fail(x)
+    except ValueError as e:
+        assert e.args == (x,)
+    return t + rec(10)
+
+for i in range(20000):
+    assert f(i) == i + 11
+
+# recursion limit still works
+try:
+    rec(100000)
+    assert False
+except RecursionError:
+    pass
+
+# replacing the code object must be noticed
+add.__code__ = (lambda a, b: a * b).__code__
+assert f(5) == 5 + 10
+def add(a, b, c=1):
+    return a - b
+assert f(5) == 4 + 10
+
+# tracing must still see the calls
+calls = []
+def tracer(frame, event, arg):
+    if event == "call":
+        calls.append(frame.f_code.co_name)
+sys.settrace(tracer)
+f(1)
+sys.settrace(None)
+assert "add" in calls and "rec" in calls, calls
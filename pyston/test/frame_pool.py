@@ -0,0 +1,44 @@
+# Tests that frames reused from a code object's pool of zombie frames start
+# out clean, for recursion deeper than the pool and for generators
+import sys
+
+def rec(n, acc):
+    local = None
+    if n > 0:
+        assert local is None
+        local = [n]
+        return rec(n - 1, acc + local[0])
+    assert sys._getframe().f_locals == {"n": 0, "acc": acc, "local": None}
+    return acc
+
+for depth in (1, 3, 8, 9, 20, 500):
+    for i in range(3):
+        assert rec(depth, 0) == depth * (depth + 1) // 2
+
+def gen(n):
+    x = n
+    for i in range(n):
+        yield x + i
+
+def cells(n):
+    y = n
+    def inner():
+        return y
+    return inner() + (cells(n - 1) if n else 0)
+
+for i in range(100):
+    gens = [gen(i % 5) for j in range(12)]
+    for g in gens:
+        assert list(g) == [i % 5 + k for k in range(i % 5)]
+    assert cells(12) == 78
+
+# frames which outlive their call don't get reused
+def keep(n):
+    if n:
+        return [sys._getframe()] + keep(n - 1)
+    return []
+kept = keep(30)
+assert len(set(map(id, kept))) == 30
+assert all(f.f_code is keep.__code__ for f in kept)
+del kept
+assert len(keep(30)) == 30
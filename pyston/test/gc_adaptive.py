@@ -0,0 +1,39 @@
+# Tests that gc.set_adaptive() raises the thresholds of young generations
+# whose collections find nothing and lowers them again for ones that do
+import gc
+
+assert gc.get_adaptive() == (False, 0.05)
+try:
+    gc.set_adaptive(True, 0.0)
+    assert False
+except ValueError:
+    pass
+
+gc.collect()
+gc.set_adaptive(True)
+assert gc.get_adaptive() == (True, 0.05)
+
+keep = []
+for i in range(200):
+    keep.append([[j] for j in range(1000)])
+st = gc.get_stats()[0]
+assert st["threshold"] > 700, st
+assert st["threshold_increases"] > 0, st
+assert gc.get_threshold() == (700, 10, 10)
+del keep
+
+# collections which find garbage take much of the time here, don't let that
+# count against them
+gc.set_adaptive(True, 1.0)
+def garbage():
+    for i in range(200000):
+        l = [i]
+        l.append(l)
+garbage()
+st = gc.get_stats()[0]
+assert st["threshold_decreases"] > 0, st
+assert st["threshold"] == 700, st
+
+gc.set_adaptive(False)
+assert gc.get_adaptive()[0] is False
+assert gc.get_stats()[0]["threshold"] == 700
@@ -0,0 +1,47 @@
+# checks that gc.set_incremental() collects garbage cycles in the oldest
+# generation without collecting it as a whole
+import gc
+import weakref
+
+class Node:
+    pass
+
+def make_cycles(n):
+    nodes = []
+    for i in range(n):
+        a = Node()
+        b = Node()
+        a.other = b
+        b.other = a
+        nodes.append(a)
+    return nodes
+
+gc.set_incremental(5000)
+assert gc.get_incremental() == 5000
+try:
+    gc.set_incremental(-1)
+    assert False
+except ValueError:
+    pass
+
+heap = [[i] for i in range(100000)]
+gc.collect()
+
+garbage = make_cycles(2000)
+refs = [weakref.ref(a) for a in garbage]
+gc.collect(1)  # moves them into the oldest generation
+gc.collect(1)
+del garbage
+
+# only objects which stay alive trigger automatic collections
+full_collections = gc.get_stats()[2]["collections"]
+for i in range(3000):
+    buf = [[j] for j in range(1000)]
+    if i % 4 == 0:
+        heap.extend(buf[:10])
+assert gc.get_stats()[2]["collections"] == full_collections
+dead = sum(1 for r in refs if r() is None)
+assert dead == len(refs), dead
+
+gc.set_incremental(0)
+assert gc.get_incremental() == 0
@@ -0,0 +1,67 @@
+# Tests that full collections with gc.set_parallel() find the same garbage
+# as single-threaded ones, including after a fork
+import gc
+import os
+import weakref
+
+class Node:
+    def __init__(self, next=None):
+        self.next = next
+
+def make_heap():
+    heap = [{"i": i, "l": [i, (i, str(i))]} for i in range(100000)]
+    # a long chain only reachable from its head, which the mark stacks
+    # have to follow
+    head = None
+    for i in range(100000):
+        head = Node(head)
+    heap.append(head)
+    return heap
+
+def make_garbage():
+    refs = []
+    for i in range(20000):
+        a = Node()
+        a.next = [a, {"b": Node(a)}]
+        refs.append(weakref.ref(a))
+    # a cycle which keeps a long chain alive
+    head = Node()
+    n = head
+    for i in range(10000):
+        n = Node(n)
+    head.next = [n, head]
+    refs.append(weakref.ref(head))
+    return refs
+
+def check():
+    refs = make_garbage()
+    assert all(r() is not None for r in refs)
+    found = gc.collect()
+    assert all(r() is None for r in refs)
+    return found
+
+gc.disable()
+heap = make_heap()
+gc.collect()
+expected = check()
+assert expected > 20000 * 4, expected
+
+try:
+    gc.set_parallel(-1)
+    assert False
+except ValueError:
+    pass
+gc.set_parallel(4)
+assert gc.get_parallel() == 4
+for i in range(3):
+    assert check() == expected
+assert heap[-1].next.next is not None
+assert heap[5000]["l"][1] == (5000, "5000")
+
+pid = os.fork()
+if pid == 0:
+    os._exit(0 if check() == expected else 1)
+assert os.waitpid(pid, 0)[1] == 0
+
+gc.set_parallel(0)
+assert check() == expected
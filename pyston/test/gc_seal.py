@@ -0,0 +1,48 @@
+# Tests gc.seal(), which immortalizes and untracks everything before a fork
+import gc
+import os
+import sys
+import weakref
+
+class C:
+    def f(self):
+        return [1, 2]
+
+def g(x):
+    return (x, "y")
+
+data = {"c": C(), "l": [g, (1, "x")]}
+wr = weakref.ref(data["c"])
+
+n = gc.seal()
+assert n > 100, n
+assert gc.get_objects() == []
+assert gc.get_count() == (0, 0, 0)
+for o in (data, data["l"], C, g):
+    assert not gc.is_tracked(o), o
+assert sys.getrefcount(g.__code__) > 2**40
+assert sys.getrefcount(g.__code__.co_consts) > 2**40
+
+# sealed objects are never freed
+del data["c"]
+gc.collect()
+assert wr() is not None
+
+# new objects are tracked and collected as usual, even when sealed objects
+# refer to them
+data["new"] = [[]]
+assert gc.is_tracked(data["new"])
+gc.disable()
+for i in range(1000):
+    l = [i]
+    l.append(l)
+del l
+assert gc.collect() == 1000
+gc.enable()
+assert data["new"] == [[]]
+assert C().f() == [1, 2] and g(1) == (1, "y")
+
+pid = os.fork()
+if pid == 0:
+    os._exit(0 if g(2) == (2, "y") and data["l"][0] is g else 1)
+assert os.waitpid(pid, 0)[1] == 0
@@ -0,0 +1,93 @@
+# Tests the keys version based LOAD_GLOBAL caches which are used when
+# the globals dict keeps getting modified
+counter = 0
+G = 1
+
+def f():
+    global counter
+    counter += 1
+    return G + len("ab")
+
+for i in range(2000):
+    assert f() == 3
+assert counter == 2000
+
+# modify the cached global
+G = 10
+assert f() == 12
+
+# shadow a builtin with a global and remove it again
+def len(x):
+    return 42
+assert f() == 52
+del len
+assert f() == 12
+
+# add and delete unrelated globals
+for i in range(100):
+    globals()["tmp%d" % i] = i
+    assert f() == 12
+for i in range(100):
+    del globals()["tmp%d" % i]
+    assert f() == 12
+
+# delete the cached global
+del G
+try:
+    f()
+    assert False
+except NameError:
+    pass
+G = 5
+assert f() == 7
+
+# popitem reuses the entry of the removed key
+def g():
+    return A
+
+ns = {"__builtins__": __builtins__}
+exec("A = 1", ns)
+exec_g = type(g)(g.__code__, ns)
+for i in range(1000):
+    ns["i"] = i
+    assert exec_g() == 1
+ns.pop("i")
+ns.pop("A")
+ns["B"] = 2
+try:
+    exec_g()
+    assert False
+except NameError:
+    pass
+ns["A"] = 3
+assert exec_g() == 3
+
+# the same code object running with different globals dicts
+import builtins
+def h():
+    return abs(-1), A
+ns1 = {"A": 1, "__builtins__": builtins}
+ns2 = {"A": 2, "abs": lambda x: 99, "__builtins__": builtins}
+h1 = type(h)(h.__code__, ns1)
+h2 = type(h)(h.__code__, ns2)
+for i in range(1000):
+    ns1["x"] = i
+    ns2["x"] = i
+    assert h1() == (1, 1)
+    assert h2() == (99, 2)
+
+# globals which are an instance (split) dict
+class C:
+    pass
+c1 = C()
+c1.__dict__.update(A=4, x=0, __builtins__=builtins)
+c2 = C()
+c2.__dict__.update(A=5, x=0, __builtins__=builtins)
+h3 = type(h)(h.__code__, c1.__dict__)
+h4 = type(h)(h.__code__, c2.__dict__)
+for i in range(1000):
+    c1.x = i
+    assert h3() == (1, 4)
+    assert h4() == (1, 5)
+c2.abs = lambda x: 7
+assert h4() == (7, 5)
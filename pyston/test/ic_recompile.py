@@ -0,0 +1,24 @@
+# checks that functions whose inline caches keep missing still produce
+# the right results when they get recompiled
+def f(o):
+    return o.x + g
+
+g = 1
+class A(object):
+    x = 1
+
+for i in range(20000):
+    assert f(A()) == 2
+
+classes = []
+for i in range(20):
+    classes.append(type("C%d" % i, (object,), {"x": i}))
+
+for i in range(20000):
+    g = i
+    c = classes[i % len(classes)]
+    assert f(c()) == c.x + i
+
+    o = A()
+    o.x = i
+    assert f(o) == 2 * i
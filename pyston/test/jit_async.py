@@ -0,0 +1,88 @@
+# Tests the JIT_ASYNC background compilation mode
+import os
+import subprocess
+import sys
+
+code = """
+import os
+import threading
+
+def f(x):
+    return x + 1
+
+def loop(n):
+    # gets compiled while the loop runs and is entered via OSR
+    t = 0
+    for i in range(n):
+        t += i
+    return t
+
+def work():
+    for i in range(20000):
+        assert f(i) == i + 1
+    assert loop(1000000) == sum(range(1000000))
+
+threads = [threading.Thread(target=work) for i in range(4)]
+for t in threads:
+    t.start()
+work()
+for t in threads:
+    t.join()
+
+# the compiler thread does not survive a fork
+pid = os.fork()
+if pid == 0:
+    def g(x):
+        return x * 2
+    for i in range(20000):
+        assert g(i) == i * 2
+    os._exit(0)
+_, status = os.waitpid(pid, 0)
+assert status == 0, status
+"""
+
+# a fork while the compiler thread is in the middle of compiling a function must not keep
+# the child from compiling that function
+fork_code = """
+import os
+import pyston
+import time
+
+def wait_for_jit(f):
+    for i in range(10000):
+        f(1)
+        if pyston.jit_code_stats(f) is not None:
+            return
+        time.sleep(0.001)
+    assert False, "not compiled"
+
+src = "def f(x):\\n" + "".join("    x = x + %d\\n" % i for i in range(2000)) + "    return x\\n"
+for n in range(20):
+    ns = {}
+    exec(src, ns)
+    f = ns["f"]
+    for i in range(200):
+        f(i)
+    # give the compiler thread the chance to pick it up
+    time.sleep(0.0002 * n)
+    pid = os.fork()
+    if pid == 0:
+        wait_for_jit(f)
+        os._exit(0)
+    _, status = os.waitpid(pid, 0)
+    assert status == 0, status
+    wait_for_jit(f)
+"""
+
+if __name__ == "__main__":
+    env = dict(os.environ, JIT_ASYNC="1")
+    subprocess.check_call([sys.executable, "-c", code], env=env)
+
+    try:
+        import pyston
+    except ImportError:
+        pyston = None
+    if pyston and hasattr(pyston, "jit_stats"):
+        # pin JIT_MIN_RUNS because the tests also get run with the JIT disabled this way
+        env["JIT_MIN_RUNS"] = "100"
+        subprocess.check_call([sys.executable, "-c", fork_code], env=env)
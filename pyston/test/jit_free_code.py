@@ -0,0 +1,34 @@
+# checks that the machine code of freed code objects gets reused:
+# with a small JIT_MAX_MEM limit the JIT would otherwise stop compiling new functions
+import os
+import subprocess
+import sys
+
+code = """
+import gc
+for i in range(2000):
+    ns = {}
+    exec('''
+def f(n):
+    t = 0
+    for i in range(n):
+        t += i * %d
+    return t
+''' % i, ns)
+    for j in range(20):
+        assert ns["f"](200) == 19900 * i
+    del ns
+    if i % 100 == 0:
+        gc.collect()
+"""
+
+if __name__ == "__main__":
+    # pin JIT_MIN_RUNS because the tests also get run with the JIT disabled this way
+    env = dict(os.environ, JIT_MAX_MEM="1000000", JIT_SHOW_STATS="1", JIT_MIN_RUNS="100")
+    p = subprocess.run([sys.executable, "-c", code], env=env, stderr=subprocess.PIPE, check=True)
+    stats = p.stderr.decode()
+    if "jit: successfully compiled" in stats:
+        compiled = int(stats.split("jit: successfully compiled ")[1].split()[0])
+        freed = int(stats.split("jit: freed ")[1].split()[0])
+        assert compiled >= 2000, stats
+        assert freed >= 1900, stats
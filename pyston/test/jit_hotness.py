@@ -0,0 +1,31 @@
+# Tests the JIT_HOTNESS_FILE hotness hint file
+import os
+import subprocess
+import sys
+import tempfile
+
+code = """
+def f(x):
+    return x + 1
+
+for i in range(1000):
+    f(i)
+"""
+
+if __name__ == "__main__":
+    with tempfile.TemporaryDirectory() as d:
+        fn = os.path.join(d, "jit_hotness")
+        env = dict(os.environ, JIT_HOTNESS_FILE=fn)
+        for i in range(3):
+            subprocess.check_call([sys.executable, "-c", code], env=env)
+
+            with open(fn) as f:
+                lines = f.read().splitlines()
+            assert lines[0].startswith("pyston-jit-hotness-v1 "), lines
+            # hinted functions must not add duplicated entries
+            assert len(lines) == len(set(lines)), lines
+
+        # a corrupt hotness file gets ignored and overwritten
+        with open(fn, "w") as f:
+            f.write("garbage")
+        subprocess.check_call([sys.executable, "-c", code], env=env)
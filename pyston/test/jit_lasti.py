@@ -0,0 +1,95 @@
+# Tests that the traceback line numbers are correct after opcodes
+# for which the JIT does not emit the f_lasti store (JUMP_FORWARD, forward JUMP_ABSOLUTE,
+# POP_BLOCK and BEGIN_FINALLY).
+# Every line which should show up in the traceback is marked with '# raises'.
+import dis
+import inspect
+import os
+import subprocess
+import sys
+import traceback
+
+def jump_forward(c):
+    if c:
+        x = 1
+    else:
+        x = 2
+    return x / 0 # raises
+
+def jump_forward_same_line(c):
+    return (1 if c else 2) / 0 # raises
+
+def jump_absolute_forward(l):
+    while l:
+        if l: break
+        l = 0
+    return l / 0 # raises
+
+def jump_absolute_forward_same_line(l):
+    while l:
+        if l: break; l = 0
+    return l / 0 # raises
+
+def pop_block():
+    try:
+        x = 1
+    except KeyError:
+        pass
+    return x / 0 # raises
+
+def pop_block_same_line():
+    try: x = 1
+    except KeyError: pass
+    return x / 0 # raises
+
+def begin_finally(o):
+    try:
+        x = 1
+    finally:
+        o.missing # raises
+
+def begin_finally_same_line(o):
+    try: x = 1
+    finally: o.missing # raises
+
+tests = [
+    (jump_forward, 1, "JUMP_FORWARD"),
+    (jump_forward, 0, "JUMP_FORWARD"),
+    (jump_forward_same_line, 1, "JUMP_FORWARD"),
+    (jump_absolute_forward, 1, "JUMP_ABSOLUTE"),
+    (jump_absolute_forward_same_line, 1, "JUMP_ABSOLUTE"),
+    (pop_block, None, "POP_BLOCK"),
+    (pop_block_same_line, None, "POP_BLOCK"),
+    (begin_finally, object(), "BEGIN_FINALLY" if sys.version_info[:2] == (3, 8) else "POP_BLOCK"),
+    (begin_finally_same_line, object(), "BEGIN_FINALLY" if sys.version_info[:2] == (3, 8) else "POP_BLOCK"),
+]
+
+def expected_line(func):
+    lines, first = inspect.getsourcelines(func)
+    for i, line in enumerate(lines):
+        if "# raises" in line:
+            return first + i
+    assert 0, func
+
+def run_tests():
+    for func, arg, opname in tests:
+        assert opname in [i.opname for i in dis.get_instructions(func)], (func, opname)
+        for i in range(50):
+            try:
+                if arg is None:
+                    func()
+                else:
+                    func(arg)
+                assert 0, "should have raised"
+            except (ZeroDivisionError, AttributeError) as e:
+                lineno = traceback.extract_tb(e.__traceback__)[-1].lineno
+                assert lineno == expected_line(func), (func.__name__, i, lineno, expected_line(func))
+
+if __name__ == "__main__":
+    if len(sys.argv) > 1 and sys.argv[1] == "child":
+        run_tests()
+    else:
+        # interpreter only and JIT compiling every function on the first call
+        for min_runs in ("9999999999", "0"):
+            env = dict(os.environ, JIT_MIN_RUNS=min_runs)
+            subprocess.check_call([sys.executable, __file__, "child"], env=env)
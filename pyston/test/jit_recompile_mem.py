@@ -0,0 +1,44 @@
+# checks that the machine code which got replaced because its inline caches kept missing
+# gets freed once no frame executes it anymore
+import os
+import subprocess
+import sys
+
+code = """
+import pyston
+
+classes = [type("C%d" % i, (object,), {"x": i}) for i in range(20)]
+
+def run(f):
+    for i in range(20000):
+        c = classes[i % len(classes)]
+        assert f(c) == c.x
+
+mem_before = pyston.jit_stats()["mem_bytes_used"]
+funcs = []
+for i in range(100):
+    ns = {}
+    exec('''
+def f(o):
+    return o.x
+''', ns)
+    run(ns["f"])
+    funcs.append(ns["f"])
+
+stats = pyston.jit_stats()
+assert stats["ic_recompiles"] > 0, stats
+
+# only the latest version of every function may still be allocated
+code_size = sum(pyston.jit_code_stats(f)["code_size"] for f in funcs if pyston.jit_code_stats(f))
+mem_used = stats["mem_bytes_used"] - mem_before
+assert mem_used < 2 * code_size, (mem_used, code_size)
+"""
+
+if __name__ == "__main__":
+    try:
+        import pyston
+    except ImportError:
+        pyston = None
+    if pyston and hasattr(pyston, "jit_stats"):
+        env = dict(os.environ, JIT_MIN_RUNS="100")
+        subprocess.check_call([sys.executable, "-c", code], env=env)
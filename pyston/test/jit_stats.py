@@ -0,0 +1,71 @@
+# Tests the JIT statistics API of the pyston module
+import os
+import subprocess
+import sys
+
+code = """
+import pyston
+
+class C:
+    def __init__(self):
+        self.a = 1
+
+def f(o):
+    return o.a
+
+def g():
+    pass
+
+c = C()
+for i in range(10000):
+    f(c)
+
+stats = pyston.jit_stats()
+assert stats["num_funcs"] >= 1, stats
+assert stats["mem_bytes_used"] > 0, stats
+assert stats["load_attr_total"] >= 1, stats
+
+code_stats = pyston.jit_code_stats(f)
+assert code_stats["code_size"] > 0, code_stats
+assert code_stats["compile_time_us"] >= 0, code_stats
+assert code_stats["ic_misses"] == 0, code_stats
+assert pyston.jit_code_stats(f.__code__) == code_stats
+
+# misses of the attribute cache get counted per function
+class D:
+    pass
+for i in range(50):
+    d = D()
+    d.__dict__["x%d" % i] = i
+    d.a = 2
+    f(d)
+assert pyston.jit_code_stats(f)["ic_misses"] > 0
+assert pyston.jit_code_stats(f, reset=True)["ic_misses"] > 0
+assert pyston.jit_code_stats(f)["ic_misses"] == 0
+assert pyston.jit_code_stats(f)["ic_miss_budget"] is not None
+
+# never called functions are not JIT compiled
+assert pyston.jit_code_stats(g) is None
+
+pyston.jit_reset_stats()
+stats = pyston.jit_stats()
+assert stats["num_funcs"] == 0, stats
+assert stats["load_attr_total"] == 0, stats
+assert stats["mem_bytes_used"] > 0, stats
+
+try:
+    pyston.jit_code_stats(1)
+    assert False
+except TypeError:
+    pass
+"""
+
+if __name__ == "__main__":
+    try:
+        import pyston
+    except ImportError:
+        pyston = None
+    if pyston and hasattr(pyston, "jit_stats"):
+        # pin JIT_MIN_RUNS because the tests also get run with the JIT disabled this way
+        env = dict(os.environ, JIT_MIN_RUNS="100")
+        subprocess.check_call([sys.executable, "-c", code], env=env)
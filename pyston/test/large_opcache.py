@@ -0,0 +1,61 @@
+# Functions with more than 255 cacheable sites (the old opcache limit)
+# must keep computing the same results once their opcache got created
+import os
+import subprocess
+import sys
+
+class C:
+    a = 1
+
+n = 600
+src = "def f(o, l):\n    t = 0\n"
+for i in range(n):
+    # one LOAD_ATTR, BINARY_SUBSCR and INPLACE_ADD site per line
+    src += "    t += o.a + l[%d]\n" % (i % 3)
+src += "    return t\n"
+exec(src)
+
+def g(o, l):
+    return f(o, l)
+
+for i in range(3000):
+    assert g(C, [1, 2, 3]) == n + sum((1, 2, 3)[i % 3] for i in range(n))
+
+# make the caches of the last sites miss
+class D:
+    a = 2
+assert g(D, [0, 0, 0]) == 2 * n
+
+# the JIT only emits an inline cache (which counts its misses) for sites with an opcache entry,
+# so a miss of the last site shows that sites past index 255 get cached
+code = """
+import pyston
+
+class C:
+    a = 1
+class E:
+    b = 2
+class F:
+    b = 3
+
+src = "def h(c, o):\\n    t = 0\\n"
+src += "    t += c.a\\n" * 400
+src += "    return t + o.b\\n"
+exec(src)
+
+for i in range(1000):
+    assert h(C, E) == 402
+assert pyston.jit_code_stats(h)["ic_misses"] == 0
+assert h(C, F) == 403
+assert pyston.jit_code_stats(h)["ic_misses"] > 0, pyston.jit_code_stats(h)
+"""
+
+if __name__ == "__main__":
+    try:
+        import pyston
+    except ImportError:
+        pyston = None
+    if pyston and hasattr(pyston, "jit_stats"):
+        # pin JIT_MIN_RUNS because the tests also get run with the JIT disabled this way
+        env = dict(os.environ, JIT_MIN_RUNS="100")
+        subprocess.check_call([sys.executable, "-c", code], env=env)
@@ -0,0 +1,33 @@
+# checks that the pymalloc nursery mode (PYTHONMALLOCNURSERY) works and
+# that sys._debugmallocstats() reports its stats
+import os
+import subprocess
+import sys
+
+code = """
+import sys
+keep = []
+for i in range(200000):
+    t = (i, str(i), [i], {i: 1.5 * i})
+    if i % 50 == 0:
+        keep.append(t)
+for i, t in enumerate(keep):
+    assert t == (i * 50, str(i * 50), [i * 50], {i * 50: 1.5 * i * 50})
+del keep
+sys._debugmallocstats()
+"""
+
+def stats(nursery):
+    env = dict(os.environ, PYTHONMALLOCNURSERY=nursery)
+    env.pop("PYTHONMALLOC", None)
+    p = subprocess.run([sys.executable, "-c", code], env=env, stderr=subprocess.PIPE, check=True)
+    return p.stderr.decode()
+
+if __name__ == "__main__":
+    s = stats("1")
+    if "Small block threshold" in s:  # pymalloc is used
+        assert "# sparse pools" in s, s
+        assert "# nursery pools retired" in s, s
+        resets = int(s.split("# nursery pool resets")[1].split("=")[1].split()[0].replace(",", ""))
+        assert resets > 0, s
+        assert "# nursery pools" not in stats(""), s
@@ -0,0 +1,36 @@
+# checks that sys._malloc_trim() and PYTHONMALLOCTRIM give the memory of free
+# pymalloc pools back, and that those pools can get reused afterwards
+import os
+import subprocess
+import sys
+
+code = """
+import sys
+keep = []
+big = []
+for i in range(100000):
+    t = (i, str(i))
+    big.append(t)
+    if i % 200 == 0:
+        keep.append(t)
+del big, t
+print(sys._malloc_trim())
+for i, t in enumerate(keep):
+    assert t == (i * 200, str(i * 200))
+more = [(i, str(i)) for i in range(100000)]
+for i, t in enumerate(more):
+    assert t == (i, str(i))
+"""
+
+def run(trim):
+    env = dict(os.environ, PYTHONMALLOCTRIM=trim)
+    env.pop("PYTHONMALLOC", None)
+    p = subprocess.run([sys.executable, "-c", code], env=env, stdout=subprocess.PIPE, check=True)
+    return int(p.stdout)
+
+if __name__ == "__main__":
+    released = run("")
+    if sys.platform == "linux":
+        assert released > 1000000, released
+        # the free pools got trimmed while they were freed
+        assert run("1") < released, released
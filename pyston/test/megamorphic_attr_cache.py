@@ -0,0 +1,49 @@
+# Tests that LOAD_ATTR/LOAD_METHOD sites which cycle through more types than fit into
+# a polymorphic cache keep hitting the process-wide megamorphic cache
+import os
+import subprocess
+import sys
+
+code = """
+class CollidingKey:
+    # Gets stored in the instance dicts and has the same hash as the attribute names
+    # so every lookup which misses the cache has to compare against it.
+    num_compares = 0
+    def __init__(self, name):
+        self.name = name
+    def __hash__(self):
+        return hash(self.name)
+    def __eq__(self, other):
+        CollidingKey.num_compares += 1
+        return False
+
+types = [type("T%d" % i, (), {"y": i, "m": lambda self, i=i: -i}) for i in range(25)]
+instances = [t() for t in types]
+for o in instances:
+    o.__dict__[CollidingKey("y")] = None
+    o.__dict__[CollidingKey("m")] = None
+
+def get_y(o):
+    return o.y
+
+def call_m(o):
+    return o.m()
+
+def run():
+    for n in range(100):
+        for i, o in enumerate(instances):
+            assert get_y(o) == i
+            assert call_m(o) == -i
+
+run()
+assert CollidingKey.num_compares > 0
+CollidingKey.num_compares = 0
+run()
+assert CollidingKey.num_compares == 0, CollidingKey.num_compares
+"""
+
+if __name__ == "__main__":
+    # pin JIT_MIN_RUNS because this tests the interpreter caches:
+    # the cached JIT helpers stop using the cache after a few misses, before the site turns megamorphic
+    env = dict(os.environ, JIT_MIN_RUNS="9999999999")
+    subprocess.check_call([sys.executable, "-c", code], env=env)
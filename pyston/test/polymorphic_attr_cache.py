@@ -0,0 +1,94 @@
+# Tests polymorphic LOAD_ATTR/LOAD_METHOD sites which see more types than
+# fit into the initial polymorphic cache, with a skewed type distribution
+classes = []
+for i in range(20):
+    def m(self, i=i):
+        return i
+    classes.append(type("C%d" % i, (), {"m": m, "x": i}))
+
+objs = [cls() for cls in classes]
+for i, o in enumerate(objs):
+    if i % 2:
+        o.x = -i
+
+def get_x(o):
+    return o.x
+
+def call_m(o):
+    return o.m()
+
+def expected_x(i):
+    return -i if i % 2 else i
+
+for n in range(3000):
+    # the last class is the most common one
+    i = 19 if n % 3 else n % 20
+    assert get_x(objs[i]) == expected_x(i)
+    assert call_m(objs[i]) == i
+
+# modifying a class must invalidate its entry
+classes[19].m = lambda self: "new"
+classes[18].x = "class attr"
+for n in range(100):
+    assert call_m(objs[19]) == "new"
+    assert get_x(objs[18]) == "class attr"
+    assert get_x(objs[17]) == -17
+
+del objs[19].x
+assert get_x(objs[19]) == 19
+
+# sites which see more types than fit into a polymorphic cache use the process-wide cache
+many = [type("M%d" % i, (), {"m": lambda self, i=i: i * 2, "y": i}) for i in range(100)]
+many_objs = [cls() for cls in many]
+for i, o in enumerate(many_objs):
+    o.x = i
+
+for n in range(30):
+    for i, o in enumerate(many_objs):
+        assert get_x(o) == i
+        assert call_m(o) == i * 2
+
+many_objs[7].x = "changed"
+many[8].m = lambda self: "changed"
+many[9].x = "class attr"
+del many_objs[9].x
+for n in range(10):
+    assert get_x(many_objs[7]) == "changed"
+    assert call_m(many_objs[8]) == "changed"
+    assert get_x(many_objs[9]) == "class attr"
+    assert get_x(many_objs[10]) == 10
+
+# a type which misses because its instance dict keeps changing must update its own entry
+# instead of adding more entries for the same type
+changing = [type("D%d" % i, (), {"z": -i}) for i in range(3)]
+changing_objs = [cls() for cls in changing]
+def get_z(o):
+    return o.z
+for n in range(1000):
+    o = changing_objs[n % 3]
+    if n % 3 == 0:
+        o.__dict__["unrelated%d" % (n % 7)] = n # changes the dict version
+    assert get_z(o) == -(n % 3)
+
+# a getter which re-enters its own polymorphic site and makes it grow and then switch to
+# the megamorphic cache must not make the outer lookup touch the freed entries
+reenter = [False]
+class Reentrant:
+    @property
+    def p(self):
+        if reenter[0]:
+            reenter[0] = False
+            for o in reenter_objs:
+                assert get_p(o) == o.__class__.__name__
+        return "reentrant"
+reenter_objs = [type("R%d" % i, (), {"p": "R%d" % i})() for i in range(40)]
+def get_p(o):
+    return o.p
+for n in range(200):
+    assert get_p(Reentrant()) == "reentrant"
+    assert get_p(reenter_objs[n % 2]) == "R%d" % (n % 2)
+for n in range(5):
+    reenter_objs = [type("S%d_%d" % (n, i), (), {"p": "S%d_%d" % (n, i)})() for i in range(40)]
+    reenter[0] = True
+    assert get_p(Reentrant()) == "reentrant"
+    assert not reenter[0]
@@ -0,0 +1,25 @@
+# check that the speculative unboxed int and float arithmetic
+# generates same results, including when the type guards fail
+def f(a, b):
+    return (a + b, a - b, a * b)
+
+values = [0, 1, -1, 7, -7, 2**30 - 1, -(2**30 - 1), 2**30, -2**30, 2**62, 2**100, -2**100, True]
+expected = {}
+for a in values:
+    for b in values:
+        expected[(a, b)] = (int(a) + int(b), int(a) - int(b), int(a) * int(b))
+
+for i in range(2000):
+    assert f(i, 3) == (i + 3, i - 3, i * 3)
+    assert f(1.5, -0.25 * i) == (1.5 + -0.25 * i, 1.5 - -0.25 * i, 1.5 * (-0.25 * i))
+
+for i in range(10):
+    for a in values:
+        for b in values:
+            assert f(a, b) == expected[(a, b)], (a, b, f(a, b))
+    assert f(1.5, 2) == (3.5, -0.5, 3.0)
+    try:
+        f("a", 2)
+        assert False
+    except TypeError:
+        pass